@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+	// Throws std::runtime_error if the file cannot be opened or mapped.
+	explicit MappedFile(const std::filesystem::path& file);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&&);
+	~MappedFile();
+
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile& operator=(MappedFile&&);
+
+	std::span<const std::byte> data() const;
+	// Hint that a range was read and will not be needed soon. Its pages stop counting towards the memory of the process,
+	// and are read from the file again if they are accessed later.
+	void evict(size_t offset, size_t size) const;
+
+private:
+	void moveInto(MappedFile&&);
+	void unmap();
+
+private:
+	const std::byte* m_pData { nullptr };
+	size_t m_size { 0 };
+};
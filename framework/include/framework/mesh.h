@@ -7,6 +7,8 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/vec3.hpp>
 DISABLE_WARNINGS_POP()
 #include <filesystem>
+#include <functional>
+#include <limits>
 #include <optional>
 #include <span>
 #include <vector>
@@ -31,6 +33,17 @@ struct Material {
 	//   material.kdTexture->getTexel(...);
 	// }
 	std::shared_ptr<Image> kdTexture;
+	std::filesystem::path kdTexturePath; // File that kdTexture was loaded from
+};
+
+struct AxisAlignedBox {
+	glm::vec3 lower { std::numeric_limits<float>::max() };
+	glm::vec3 upper { std::numeric_limits<float>::lowest() };
+};
+
+struct BoundingSphere {
+	glm::vec3 center { 0.0f };
+	float radius { 0.0f };
 };
 
 struct Mesh {
@@ -40,10 +53,31 @@ struct Mesh {
 	std::vector<glm::uvec3> triangles;
 
 	Material material;
+
+	// Object-space bounds of the vertices, kept up-to-date by the functions below (see computeBounds()).
+	AxisAlignedBox bounds;
+	BoundingSphere boundingSphere;
 };
 
-[[nodiscard]] std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool normalize = false);
+// Parallel uses parseObjParallel() (see obj_parser.h), falling back to tinyobjloader for files it does not support.
+enum class ObjParser {
+	Parallel,
+	TinyObjLoader
+};
+[[nodiscard]] std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool normalize = false, ObjParser parser = ObjParser::Parallel);
+// Imports an OBJ file for models that are too large for loadMesh(). Sub-meshes are passed to the callback as soon as
+// they are complete, and are split when they would outgrow memoryBudget (in bytes). The budget only bounds the
+// sub-meshes, not the total memory use: the vertex arrays of the whole file (positions, normals and texture
+// coordinates) stay resident until the end, as faces may reference any vertex defined before them. Does not normalize,
+// which would need every vertex at once. Throws std::runtime_error for files that cannot be streamed (see
+// parseObjStreaming()).
+void streamMesh(const std::filesystem::path& file, size_t memoryBudget, const std::function<void(Mesh&&)>& callback);
 [[nodiscard]] Mesh mergeMeshes(std::span<const Mesh> meshes);
+// Split the triangles (in order) into meshes that each reference at most maxVertices vertices; vertices shared by
+// triangles of different chunks are duplicated. Returns the mesh itself if it is small enough.
+[[nodiscard]] std::vector<Mesh> splitMesh(const Mesh& mesh, size_t maxVertices);
+// Recompute the bounds of the mesh; call this after modifying the vertex positions by hand.
+void computeBounds(Mesh& mesh);
 void meshFlipX(Mesh& mesh);
 void meshFlipY(Mesh& mesh);
 void meshFlipZ(Mesh& mesh);
\ No newline at end of file
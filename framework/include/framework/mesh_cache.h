@@ -0,0 +1,91 @@
+#pragma once
+#include "mapped_file.h"
+#include "mesh.h"
+#include "mesh_optimizer.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Binary cache of the output of loadMesh() followed by optimizeMesh(), such that later runs skip both. A .mesh file
+// stores the vertex and triangle arrays of every sub-mesh as-is (in native byte order), with their materials, bounds
+// and the optimization report. It is identified by a key that hashes the contents of the source file and the load
+// settings, so edited sources never load stale data.
+constexpr uint32_t MESH_CACHE_VERSION = 2;
+
+// A memory-mapped .mesh file. The vertex and triangle spans of its sub-meshes point into the mapping, so they can be
+// uploaded to the GPU without copying them first.
+class MeshCache {
+public:
+	struct SubMesh {
+		std::span<const Vertex> vertices;
+		std::span<const glm::uvec3> triangles;
+		Material material;
+		AxisAlignedBox bounds;
+		BoundingSphere boundingSphere;
+	};
+
+	// Returns std::nullopt if the file does not exist, is damaged, or does not match the version or key. Relative texture
+	// paths are resolved against textureBaseDir (the directory of the source file).
+	[[nodiscard]] static std::optional<MeshCache> open(const std::filesystem::path& cacheFile, uint64_t key, const std::filesystem::path& textureBaseDir);
+
+	std::span<const SubMesh> subMeshes() const;
+	const MeshOptimizationReport& report() const;
+	// Copy of the sub-meshes, equal to what was passed to writeMeshCache().
+	[[nodiscard]] std::vector<Mesh> toMeshes() const;
+
+private:
+	explicit MeshCache(MappedFile&& file);
+
+private:
+	MappedFile m_file;
+	std::vector<SubMesh> m_subMeshes;
+	MeshOptimizationReport m_report;
+};
+
+// Writes a .mesh file one sub-mesh at a time, such that the sub-meshes never need to be in memory at once. The file is
+// written next to its destination, and only renamed into place by finish().
+class MeshCacheWriter {
+public:
+	// Texture paths are stored relative to textureBaseDir. Throws std::runtime_error if the file cannot be created.
+	MeshCacheWriter(const std::filesystem::path& cacheFile, uint64_t key, const std::filesystem::path& textureBaseDir);
+	MeshCacheWriter(const MeshCacheWriter&) = delete;
+	~MeshCacheWriter();
+
+	MeshCacheWriter& operator=(const MeshCacheWriter&) = delete;
+
+	void append(const Mesh& mesh);
+	// Throws std::runtime_error if the file cannot be written.
+	void finish(const MeshOptimizationReport& report);
+
+private:
+	std::filesystem::path m_cacheFile;
+	std::filesystem::path m_tempFile;
+	std::filesystem::path m_textureBaseDir;
+	uint64_t m_key;
+	std::ofstream m_stream;
+	uint64_t m_offset;
+	std::vector<std::byte> m_records; // Sub-mesh records, see mesh_cache.cpp
+	bool m_finished { false };
+};
+
+// Key of the cache of a source file: a hash of its contents, the load settings and MESH_CACHE_VERSION.
+[[nodiscard]] uint64_t meshCacheKey(const std::filesystem::path& sourceFile, bool normalize);
+// Location of the cache with the given key in the per-user temporary directory.
+[[nodiscard]] std::filesystem::path defaultMeshCachePath(uint64_t key);
+// Writes the meshes with a MeshCacheWriter, such that a concurrent reader never sees a partial file. Throws
+// std::runtime_error if it cannot be written.
+void writeMeshCache(const std::filesystem::path& cacheFile, uint64_t key, std::span<const Mesh> meshes,
+	const MeshOptimizationReport& report, const std::filesystem::path& textureBaseDir);
+
+// Open the cache of the source file at its default location, first building it with loadMesh() and optimizeMesh() if
+// it is missing or out of date. Throws std::runtime_error if the cache cannot be written.
+[[nodiscard]] MeshCache loadMeshCache(const std::filesystem::path& sourceFile, bool normalize = false);
+// Builds the cache of a source file that is too large for loadMesh(): the sub-meshes are imported with streamMesh() and
+// are optimized and appended to the cache one at a time, each within memoryBudget (in bytes). Like for streamMesh(),
+// this does not cap the memory use, as the vertex arrays of the whole source file stay resident. Returns the number of
+// sub-meshes. Throws std::runtime_error if the source cannot be streamed or the cache cannot be written.
+size_t streamMeshCache(const std::filesystem::path& sourceFile, const std::filesystem::path& cacheFile, uint64_t key, size_t memoryBudget);
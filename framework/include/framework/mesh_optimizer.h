@@ -0,0 +1,52 @@
+#pragma once
+#include "mesh.h"
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+// Post-transform vertex cache behaviour of a triangle order, simulated with a FIFO cache.
+struct VertexCacheStatistics {
+	size_t numTriangles { 0 };
+	size_t numVertices { 0 }; // Referenced by at least one triangle
+	size_t numTransformedVertices { 0 }; // Cache misses
+
+	// Average cache miss ratio: transformed vertices per triangle (0.5 is optimal for large regular meshes, 3 is worst)
+	[[nodiscard]] float acmr() const;
+	// Average transform to vertex ratio: transformed vertices per vertex (1 is optimal)
+	[[nodiscard]] float atvr() const;
+
+	VertexCacheStatistics& operator+=(const VertexCacheStatistics& other);
+};
+
+struct MeshOptimizationReport {
+	VertexCacheStatistics before;
+	VertexCacheStatistics after;
+
+	MeshOptimizationReport& operator+=(const MeshOptimizationReport& other);
+};
+
+struct MeshOptimizationSettings {
+	size_t cacheSize { 16 };
+	// Clusters of the vertex cache order are split further while their ACMR stays below this factor times the ACMR of
+	// the whole mesh; more and smaller clusters give the overdraw order more freedom at the cost of cache misses.
+	float overdrawThreshold { 1.05f };
+};
+
+[[nodiscard]] VertexCacheStatistics analyzeVertexCache(const Mesh& mesh, size_t cacheSize = 16);
+
+// Reorder the triangles for the post-transform vertex cache (Tipsify, Sander et al. 2007). Returns the first triangle
+// of every cluster: runs of triangles that the algorithm emitted without reaching a dead end.
+std::vector<size_t> optimizeVertexCache(Mesh& mesh, size_t cacheSize = 16);
+// Reorder the clusters of optimizeVertexCache() such that triangles facing away from the mesh center, which are more
+// likely to occlude the others, are drawn first.
+void optimizeOverdraw(Mesh& mesh, std::span<const size_t> clusterStarts, size_t cacheSize = 16, float threshold = 1.05f);
+// Reorder the vertices in order of first use by the triangles, and drop unreferenced vertices.
+void optimizeVertexFetch(Mesh& mesh);
+
+// All of the above, in order.
+MeshOptimizationReport optimizeMesh(Mesh& mesh, const MeshOptimizationSettings& settings = {});
+
+// loadMesh() followed by optimizeMesh() on every sub-mesh. The result is kept in a binary cache on disk (see
+// loadMeshCache()), so every file is only optimized once; pReport receives the statistics of the optimization (summed
+// over the sub-meshes).
+[[nodiscard]] std::vector<Mesh> loadOptimizedMesh(const std::filesystem::path& file, bool normalize = false, MeshOptimizationReport* pReport = nullptr);
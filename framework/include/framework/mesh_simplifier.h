@@ -0,0 +1,20 @@
+#pragma once
+#include "mesh.h"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// A level of detail of a mesh and its geometric error: the largest root mean square object space distance of a
+// collapsed vertex to the planes of the original triangles around it.
+struct MeshLod {
+	Mesh mesh;
+	float error { 0.0f };
+};
+
+// Simplify the mesh to at most targetTriangles triangles (if possible) by collapsing edges in order of their quadric
+// error (Garland and Heckbert 1997). Vertices are only ever moved onto other vertices, so the remaining vertices keep
+// their normals and texture coordinates. Borders, texture seams and hard edges are preserved by extra constraint planes.
+[[nodiscard]] MeshLod simplifyMesh(const Mesh& mesh, size_t targetTriangles);
+
+// Simplify the mesh to each of the given fractions of its triangle count; every level is optimized with optimizeMesh().
+[[nodiscard]] std::vector<MeshLod> buildLodChain(const Mesh& mesh, std::span<const float> triangleRatios);
@@ -0,0 +1,31 @@
+#pragma once
+#include "mesh.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A run of consecutive triangles of a mesh, small enough to be culled on its own.
+struct Meshlet {
+	uint32_t firstTriangle;
+	uint32_t numTriangles;
+	uint32_t numVertices; // Distinct vertices referenced by the triangles
+
+	BoundingSphere boundingSphere;
+	// Normal cone: all triangles face away from a viewer at p if dot(normalize(coneApex - p), coneAxis) >= coneCutoff.
+	// Meshlets whose normals spread too far have a cutoff above 1 and are never back-facing.
+	glm::vec3 coneApex { 0.0f };
+	glm::vec3 coneAxis { 0.0f, 0.0f, 1.0f };
+	float coneCutoff { 2.0f };
+};
+
+constexpr size_t MAX_MESHLET_VERTICES = 64;
+constexpr size_t MAX_MESHLET_TRIANGLES = 124;
+
+// Partition the triangles into spatially compact meshlets of at most maxVertices vertices and maxTriangles triangles.
+// The triangles are reordered such that every meshlet is a run of consecutive triangles.
+[[nodiscard]] std::vector<Meshlet> buildMeshlets(Mesh& mesh, size_t maxVertices = MAX_MESHLET_VERTICES, size_t maxTriangles = MAX_MESHLET_TRIANGLES);
@@ -0,0 +1,37 @@
+#pragma once
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <tinyobjloader/tiny_obj_loader.h>
+DISABLE_WARNINGS_POP()
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <vector>
+
+// Multi-threaded replacement for tinyobj::LoadObj() (with triangulation), for large files. The file is memory-mapped
+// and split into chunks of whole lines that are parsed in parallel; the chunks are merged afterwards, resolving
+// relative indices and splitting the faces into shapes and material runs. The result matches tinyobjloader in every
+// field that loadMesh() reads: the vertex, normal and texture coordinate arrays of attrib, the indices and material
+// ids of the shapes, and the materials.
+//
+// Returns false if the file cannot be parsed, or uses features that are left to tinyobjloader: polygons with more
+// than four vertices (which it triangulates by ear clipping), lines and points. numThreads = 0 uses every hardware thread.
+[[nodiscard]] bool parseObjParallel(const std::filesystem::path& file, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes,
+	std::vector<tinyobj::material_t>& materials, unsigned numThreads = 0);
+
+// Receives the faces of an OBJ file from parseObjStreaming(), in file order.
+struct ObjStreamCallbacks {
+	// Triangles (three indices each) of the current group and material, where material indexes the materials (or is -1).
+	// A group may be passed on in several calls.
+	std::function<void(std::span<const tinyobj::index_t> triangles, int material)> onTriangles;
+	// The current group or material ends, or the end of the file was reached.
+	std::function<void()> onRunEnd;
+};
+
+// Parses the file in batches of about batchSize bytes of text, passing the faces of each batch on before the next batch
+// is read, such that the faces of the file never need to be in memory at once. Large batches are parsed in parallel. The vertex arrays of attrib
+// grow as the file is read: faces may reference any vertex defined before them. Throws std::runtime_error for the
+// features that parseObjParallel() does not support, and for faces that reference vertices before they are defined.
+void parseObjStreaming(const std::filesystem::path& file, size_t batchSize, tinyobj::attrib_t& attrib,
+	std::vector<tinyobj::material_t>& materials, const ObjStreamCallbacks& callbacks, unsigned numThreads = 0);
@@ -8,14 +8,76 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 DISABLE_WARNINGS_POP()
+#include <array>
+#include <cstdint>
 #include <exception>
 #include <filesystem>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 struct ShaderLoadingException : public std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
+// Hashed (FNV-1a) name of a uniform. Constructing it from a string literal is consteval, so uniform names in
+// the render loop are hashed at compile time and never turn into std::string or driver string lookups.
+struct UniformId {
+    template <size_t N>
+    consteval UniformId(const char (&name)[N])
+        : hash(hashName(std::string_view(name, N - 1)))
+#ifndef NDEBUG
+        , debugName(name, N - 1)
+#endif
+    {
+    }
+    constexpr explicit UniformId(std::string_view name)
+        : hash(hashName(name))
+#ifndef NDEBUG
+        , debugName(name)
+#endif
+    {
+    }
+    // Name of an element of an array of structs ("arrayName[index].member"), hashed without building the string.
+    constexpr UniformId(std::string_view arrayName, int index, std::string_view member)
+        : hash(hashName(member, hashName("].", hashName(indexDigits(index), hashName("[", hashName(arrayName))))))
+    {
+    }
+
+    static constexpr uint32_t hashName(std::string_view name, uint32_t seed = 2166136261u)
+    {
+        uint32_t h = seed;
+        for (char c : name) {
+            h ^= static_cast<uint8_t>(c);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    uint32_t hash;
+#ifndef NDEBUG
+    // Only for diagnostics; empty for array elements, whose name is never built.
+    std::string_view debugName;
+#endif
+
+private:
+    struct Digits {
+        std::array<char, 11> chars {};
+        size_t count { 0 };
+        constexpr operator std::string_view() const { return std::string_view(chars.data() + chars.size() - count, count); }
+    };
+    static constexpr Digits indexDigits(int index)
+    {
+        Digits out;
+        unsigned value = static_cast<unsigned>(index);
+        do {
+            out.chars[out.chars.size() - ++out.count] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        return out;
+    }
+};
+
 class Shader {
 public:
     Shader();
@@ -29,20 +91,44 @@ public:
     void bind() const;
 
     // Bind the uniform define by the given name to the given buffer and location in its assigned block, 
-    void bindUniformBlock(const std::string& blockName, GLuint bindingLocation, GLuint uniformBlockBuffer) const;
+    void bindUniformBlock(UniformId blockName, GLuint bindingLocation, GLuint uniformBlockBuffer) const;
+    // Same as above, but only binds the range [offset, offset + size) of the buffer to the block.
+    void bindUniformBlock(UniformId blockName, GLuint bindingLocation, GLuint uniformBlockBuffer, GLintptr offset, GLsizeiptr size) const;
 
     // Query an attribute location by its name in the shader
     GLuint getAttributeLocation(const std::string& name) const;
     
-    // Query a uniform location by its name in the shader
-    GLint getUniformLocation(const std::string& name) const;
+    // Look up a uniform location in the table reflected at link time (-1 if the uniform is not active).
+    GLint getUniformLocation(UniformId name) const;
+
+    // Typed uniform setters, either by (compile-time hashed) name or by a location resolved once up front.
+    // The shader must be bound.
+    void setUniform(GLint location, bool value) const;
+    void setUniform(GLint location, int value) const;
+    void setUniform(GLint location, float value) const;
+    void setUniform(GLint location, const glm::vec2& value) const;
+    void setUniform(GLint location, const glm::vec3& value) const;
+    void setUniform(GLint location, const glm::vec4& value) const;
+    void setUniform(GLint location, const glm::ivec2& value) const;
+    void setUniform(GLint location, const glm::ivec3& value) const;
+    void setUniform(GLint location, const glm::mat3& value) const;
+    void setUniform(GLint location, const glm::mat4& value) const;
+    template <typename T>
+    void setUniform(UniformId name, const T& value) const { setUniform(getUniformLocation(name), value); }
 
 private:
     friend class ShaderBuilder;
     Shader(GLuint program);
 
+    void reflectUniforms();
+    GLuint getUniformBlockIndex(UniformId blockName) const;
+
 private:
     GLuint m_program;
+    // All active uniforms of the program as (name hash, location), sorted by hash.
+    std::vector<std::pair<uint32_t, GLint>> m_uniformLocations;
+    // All active uniform blocks of the program as (name hash, block index), sorted by hash.
+    std::vector<std::pair<uint32_t, GLuint>> m_uniformBlockIndices;
 };
 
 class ShaderBuilder {
@@ -0,0 +1,115 @@
+#include "mapped_file.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <fmt/format.h>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& file)
+{
+#ifdef _WIN32
+    const HANDLE fileHandle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        throw std::runtime_error(fmt::format("Could not open {}", file.string()));
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    if (m_size > 0) {
+        // The view keeps the mapping and the file alive after their handles are closed
+        const HANDLE mapping = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+            m_pData = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (mapping)
+            CloseHandle(mapping);
+    }
+    CloseHandle(fileHandle);
+#else
+    const int fileDescriptor = ::open(file.c_str(), O_RDONLY);
+    if (fileDescriptor == -1)
+        throw std::runtime_error(fmt::format("Could not open {}", file.string()));
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) == 0)
+        m_size = static_cast<size_t>(fileStatus.st_size);
+    if (m_size > 0) {
+        // The mapping stays valid after the file descriptor is closed
+        void* pMapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if (pMapping != MAP_FAILED)
+            m_pData = static_cast<const std::byte*>(pMapping);
+    }
+    ::close(fileDescriptor);
+#endif
+    if (m_size > 0 && !m_pData)
+        throw std::runtime_error(fmt::format("Could not map {}", file.string()));
+}
+
+MappedFile::MappedFile(MappedFile&& other)
+{
+    moveInto(std::move(other));
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+    moveInto(std::move(other));
+    return *this;
+}
+
+std::span<const std::byte> MappedFile::data() const
+{
+    return { m_pData, m_size };
+}
+
+void MappedFile::evict(size_t offset, size_t size) const
+{
+    if (!m_pData || offset >= m_size)
+        return;
+    size = std::min(size, m_size - offset);
+#ifdef _WIN32
+    // Unlocking pages that are not locked removes them from the working set
+    VirtualUnlock(const_cast<std::byte*>(m_pData + offset), size);
+#else
+    // The mapping is read-only, so its pages can always be dropped; round outwards to whole pages
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = offset / pageSize * pageSize;
+    madvise(const_cast<std::byte*>(m_pData + begin), offset + size - begin, MADV_DONTNEED);
+#endif
+}
+
+void MappedFile::moveInto(MappedFile&& other)
+{
+    unmap();
+    m_pData = other.m_pData;
+    m_size = other.m_size;
+
+    other.m_pData = nullptr;
+    other.m_size = 0;
+}
+
+void MappedFile::unmap()
+{
+    if (!m_pData)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_pData);
+#else
+    munmap(const_cast<std::byte*>(m_pData), m_size);
+#endif
+    m_pData = nullptr;
+}
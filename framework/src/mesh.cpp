@@ -1,4 +1,5 @@
 #include "mesh.h"
+#include "obj_parser.h"
 // Suppress warnings in third-party code.
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
@@ -49,7 +50,66 @@ struct VertexHash {
     }
 };
 
-std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool centerAndNormalize)
+// Map the index of a vertex as loaded by tinyobjloader to its index in the generated mesh
+using VertexCache = std::unordered_map<Vertex, uint32_t, VertexHash>;
+
+static void addTriangle(Mesh& mesh, VertexCache& vertexCache, const tinyobj::attrib_t& inAttrib, const tinyobj::index_t* pIndices)
+{
+    const glm::vec3 v0 = construct_vec3(&inAttrib.vertices[3 * pIndices[0].vertex_index]);
+    const glm::vec3 v1 = construct_vec3(&inAttrib.vertices[3 * pIndices[1].vertex_index]);
+    const glm::vec3 v2 = construct_vec3(&inAttrib.vertices[3 * pIndices[2].vertex_index]);
+    const auto geometricNormal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+
+    // Load the triangle indices and lazily create the vertices.
+    glm::uvec3 triangle;
+    for (unsigned j = 0; j < 3; j++) {
+        const auto& tinyObjIndex = pIndices[j];
+        Vertex vertex {
+            .position = construct_vec3(&inAttrib.vertices[3 * tinyObjIndex.vertex_index]),
+            .normal = glm::vec3(0),
+            .texCoord = glm::vec2(0)
+        };
+        if (tinyObjIndex.normal_index != -1 && !inAttrib.normals.empty())
+            vertex.normal = glm::vec3(inAttrib.normals[3 * tinyObjIndex.normal_index + 0], inAttrib.normals[3 * tinyObjIndex.normal_index + 1], inAttrib.normals[3 * tinyObjIndex.normal_index + 2]);
+        else
+            vertex.normal = geometricNormal;
+        if (tinyObjIndex.texcoord_index != -1 && !inAttrib.texcoords.empty())
+            vertex.texCoord = glm::vec2(inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 0], inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 1]);
+
+        if (auto iter = vertexCache.find(vertex); iter != std::end(vertexCache)) {
+            // Already visited this vertex? Reuse it!
+            triangle[j] = iter->second;
+        } else {
+            // New vertex? Create it and store it in the vertex cache.
+            vertexCache[vertex] = triangle[j] = (unsigned)mesh.vertices.size();
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    mesh.triangles.push_back(triangle);
+}
+
+static Material convertMaterial(const std::vector<tinyobj::material_t>& inMaterials, int materialID, const std::filesystem::path& baseDir)
+{
+    Material out;
+    if (materialID == -1) {
+        out.kd = glm::vec3(1.0f);
+        out.ks = glm::vec3(0.0f);
+        out.shininess = 1.0f;
+    } else {
+        const auto& objMaterial = inMaterials[materialID];
+        out.kd = construct_vec3(objMaterial.diffuse);
+        if (!objMaterial.diffuse_texname.empty()) {
+            out.kdTexturePath = baseDir / objMaterial.diffuse_texname;
+            out.kdTexture = std::make_shared<Image>(out.kdTexturePath);
+        }
+        out.ks = construct_vec3(objMaterial.specular);
+        out.shininess = objMaterial.shininess;
+        out.transparency = objMaterial.dissolve;
+    }
+    return out;
+}
+
+std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool centerAndNormalize, ObjParser parser)
 {
     if (!std::filesystem::exists(file)) {
         std::cerr << "File " << file << " does not exist." << std::endl;
@@ -62,8 +122,11 @@ std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool centerAndNorm
     std::vector<tinyobj::shape_t> inShapes;
     std::vector<tinyobj::material_t> inMaterials;
 
-    std::string warn, error;
-    bool ret = tinyobj::LoadObj(&inAttrib, &inShapes, &inMaterials, &warn, &error, file.string().c_str(), baseDir.string().c_str());
+    bool ret = parser == ObjParser::Parallel && parseObjParallel(file, inAttrib, inShapes, inMaterials);
+    if (!ret) {
+        std::string warn, error;
+        ret = tinyobj::LoadObj(&inAttrib, &inShapes, &inMaterials, &warn, &error, file.string().c_str(), baseDir.string().c_str());
+    }
     if (!ret) {
         std::cerr << "Failed to load mesh " << file << std::endl;
         throw std::exception();
@@ -72,6 +135,8 @@ std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool centerAndNorm
     std::vector<Mesh> out;
     for (const auto& shape : inShapes) {
         assert(shape.mesh.indices.size() % 3 == 0);
+        if (shape.mesh.indices.empty())
+            continue; // Groups that only contain degenerate faces
 
         size_t startTriangle = 0;
         auto prevMaterialID = shape.mesh.material_ids[0];
@@ -85,56 +150,10 @@ std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool centerAndNorm
                 prevMaterialID = shape.mesh.material_ids[endTriangle];
 
             Mesh mesh;
-            std::unordered_map<Vertex, uint32_t, VertexHash> vertexCache; // Map the index of a vertex as loaded by tinyobjloader to its index in the generated mesh
-            for (size_t i = startTriangle * 3; i != endTriangle * 3; i += 3) {
-                const glm::vec3 v0 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 0].vertex_index]);
-                const glm::vec3 v1 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 1].vertex_index]);
-                const glm::vec3 v2 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 2].vertex_index]);
-                const auto geometricNormal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
-
-                // Load the triangle indices and lazily create the vertices.
-                glm::uvec3 triangle;
-                for (unsigned j = 0; j < 3; j++) {
-                    const auto& tinyObjIndex = shape.mesh.indices[i + j];
-                    Vertex vertex {
-                        .position = construct_vec3(&inAttrib.vertices[3 * tinyObjIndex.vertex_index]),
-                        .normal = glm::vec3(0),
-                        .texCoord = glm::vec2(0)
-                    };
-                    if (tinyObjIndex.normal_index != -1 && !inAttrib.normals.empty())
-                        vertex.normal = glm::vec3(inAttrib.normals[3 * tinyObjIndex.normal_index + 0], inAttrib.normals[3 * tinyObjIndex.normal_index + 1], inAttrib.normals[3 * tinyObjIndex.normal_index + 2]);
-                    else
-                        vertex.normal = geometricNormal;
-                    if (tinyObjIndex.texcoord_index != -1 && !inAttrib.texcoords.empty())
-                        vertex.texCoord = glm::vec2(inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 0], inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 1]);
-
-                    if (auto iter = vertexCache.find(vertex); iter != std::end(vertexCache)) {
-                        // Already visited this vertex? Reuse it!
-                        triangle[j] = iter->second;
-                    } else {                      
-                        // New vertex? Create it and store it in the vertex cache.
-                        vertexCache[vertex] = triangle[j] = (unsigned)mesh.vertices.size();
-                        mesh.vertices.push_back(vertex);
-                    }
-                }
-                mesh.triangles.push_back(triangle);
-            }
-
-            const auto materialID = shape.mesh.material_ids[startTriangle];
-            if (materialID == -1) {
-                mesh.material.kd = glm::vec3(1.0f);
-                mesh.material.ks = glm::vec3(0.0f);
-                mesh.material.shininess = 1.0f;
-            } else {
-                const auto& objMaterial = inMaterials[materialID];
-                mesh.material.kd = construct_vec3(objMaterial.diffuse);
-                if (!objMaterial.diffuse_texname.empty()) {
-                    mesh.material.kdTexture = std::make_shared<Image>(baseDir / objMaterial.diffuse_texname);
-                }
-                mesh.material.ks = construct_vec3(objMaterial.specular);
-                mesh.material.shininess = objMaterial.shininess;
-                mesh.material.transparency = objMaterial.dissolve;
-            }
+            VertexCache vertexCache;
+            for (size_t i = startTriangle * 3; i != endTriangle * 3; i += 3)
+                addTriangle(mesh, vertexCache, inAttrib, &shape.mesh.indices[i]);
+            mesh.material = convertMaterial(inMaterials, shape.mesh.material_ids[startTriangle], baseDir);
 
             out.push_back(std::move(mesh));
 
@@ -144,10 +163,55 @@ std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool centerAndNorm
 
     if (centerAndNormalize)
         centerAndScaleToUnitMesh(out);
+    for (Mesh& mesh : out)
+        computeBounds(mesh);
 
     return out;
 }
 
+void streamMesh(const std::filesystem::path& file, size_t memoryBudget, const std::function<void(Mesh&&)>& callback)
+{
+    if (!std::filesystem::exists(file)) {
+        std::cerr << "File " << file << " does not exist." << std::endl;
+        throw std::exception();
+    }
+
+    const auto baseDir = file.parent_path();
+    tinyobj::attrib_t inAttrib;
+    std::vector<tinyobj::material_t> inMaterials;
+
+    Mesh mesh;
+    VertexCache vertexCache;
+    int materialID = -1;
+    const auto emitMesh = [&]() {
+        if (mesh.triangles.empty())
+            return;
+        mesh.material = convertMaterial(inMaterials, materialID, baseDir);
+        computeBounds(mesh);
+        callback(std::move(mesh));
+        mesh = {};
+        vertexCache = {};
+    };
+
+    // An eighth of the budget for the text of a batch (which takes about twice its size once parsed), half for the
+    // sub-mesh and its vertex cache, and the rest for the caller to process the finished sub-mesh.
+    constexpr size_t vertexCacheEntrySize = sizeof(Vertex) + sizeof(uint32_t) + 4 * sizeof(void*); // Node and bucket
+    const size_t subMeshBudget = memoryBudget / 2;
+    const ObjStreamCallbacks callbacks {
+        .onTriangles = [&](std::span<const tinyobj::index_t> indices, int material) {
+            materialID = material;
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                addTriangle(mesh, vertexCache, inAttrib, &indices[i]);
+                const size_t memory = mesh.vertices.capacity() * sizeof(Vertex) + mesh.triangles.capacity() * sizeof(glm::uvec3) + vertexCache.size() * vertexCacheEntrySize;
+                if (memory > subMeshBudget)
+                    emitMesh();
+            }
+        },
+        .onRunEnd = emitMesh
+    };
+    parseObjStreaming(file, memoryBudget / 8, inAttrib, inMaterials, callbacks);
+}
+
 static void centerAndScaleToUnitMesh(std::span<Mesh> meshes)
 {
     std::vector<glm::vec3> positions;
@@ -188,15 +252,65 @@ Mesh mergeMeshes(std::span<const Mesh> meshes)
             out.triangles.push_back(tri + (unsigned)vertexOffset);
         }
     }
+    computeBounds(out);
+    return out;
+}
+
+std::vector<Mesh> splitMesh(const Mesh& mesh, size_t maxVertices)
+{
+    assert(maxVertices >= 3);
+    if (mesh.vertices.size() <= maxVertices)
+        return { mesh };
+
+    std::vector<Mesh> out;
+    // Index of each vertex of the input mesh in the current chunk
+    std::unordered_map<unsigned, unsigned> chunkIndices;
+    for (const auto& tri : mesh.triangles) {
+        const auto numNewVertices = std::count_if(&tri[0], &tri[0] + 3, [&](unsigned idx) { return !chunkIndices.contains(idx); });
+        if (out.empty() || out.back().vertices.size() + size_t(numNewVertices) > maxVertices) {
+            out.emplace_back().material = mesh.material;
+            chunkIndices.clear();
+        }
+
+        Mesh& chunk = out.back();
+        glm::uvec3 chunkTri;
+        for (int i = 0; i < 3; i++) {
+            const auto [iter, isNew] = chunkIndices.try_emplace(tri[i], (unsigned)chunk.vertices.size());
+            if (isNew)
+                chunk.vertices.push_back(mesh.vertices[tri[i]]);
+            chunkTri[i] = iter->second;
+        }
+        chunk.triangles.push_back(chunkTri);
+    }
+    for (Mesh& chunk : out)
+        computeBounds(chunk);
     return out;
 }
 
+void computeBounds(Mesh& mesh)
+{
+    mesh.bounds = AxisAlignedBox {};
+    for (const Vertex& v : mesh.vertices) {
+        mesh.bounds.lower = glm::min(mesh.bounds.lower, v.position);
+        mesh.bounds.upper = glm::max(mesh.bounds.upper, v.position);
+    }
+
+    // Centered on the box, which is not the tightest sphere but close enough for culling
+    mesh.boundingSphere = BoundingSphere {};
+    if (mesh.vertices.empty())
+        return;
+    mesh.boundingSphere.center = 0.5f * (mesh.bounds.lower + mesh.bounds.upper);
+    for (const Vertex& v : mesh.vertices)
+        mesh.boundingSphere.radius = std::max(mesh.boundingSphere.radius, glm::length(v.position - mesh.boundingSphere.center));
+}
+
 void  meshFlipX(Mesh& mesh)
 {
     for (auto& v : mesh.vertices) {
         v.position.x = -v.position.x;
         v.normal.x = -v.normal.x;
     }
+    computeBounds(mesh);
 }
 
 void  meshFlipY(Mesh& mesh)
@@ -205,6 +319,7 @@ void  meshFlipY(Mesh& mesh)
         v.position.y = -v.position.y;
         v.normal.y = -v.normal.y;
     }
+    computeBounds(mesh);
 }
 
 void meshFlipZ(Mesh& mesh)
@@ -213,4 +328,5 @@ void meshFlipZ(Mesh& mesh)
         v.position.z = -v.position.z;
         v.normal.z = -v.normal.z;
     }
+    computeBounds(mesh);
 }
\ No newline at end of file
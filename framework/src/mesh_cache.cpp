@@ -0,0 +1,290 @@
+#include "mesh_cache.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <fmt/format.h>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// ======== FILE LAYOUT =========
+// Header, the vertex, triangle and texture path data of every sub-mesh, then the sub-mesh records, each 16 byte aligned.
+// The records come last such that sub-meshes can be written before it is known how many there are.
+static constexpr std::array<char, 4> fileMagic { 'M', 'E', 'S', 'H' };
+
+struct FileHeader {
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t fileSize;
+    uint64_t recordOffset;
+    uint32_t numSubMeshes;
+    uint32_t padding;
+    // MeshOptimizationReport: before and after, each numTriangles, numVertices, numTransformedVertices
+    std::array<uint64_t, 6> report;
+};
+
+struct SubMeshRecord {
+    uint64_t vertexOffset;
+    uint64_t triangleOffset;
+    uint64_t texturePathOffset; // Generic format, relative to the texture base directory
+    uint32_t numVertices;
+    uint32_t numTriangles;
+    uint32_t texturePathLength; // Zero without a texture
+    float shininess;
+    float transparency;
+    glm::vec3 kd;
+    glm::vec3 ks;
+    glm::vec3 boundsLower;
+    glm::vec3 boundsUpper;
+    glm::vec3 sphereCenter;
+    float sphereRadius;
+};
+
+// The arrays are stored as they are in memory
+static_assert(std::is_trivially_copyable_v<Vertex> && sizeof(Vertex) == 32);
+static_assert(std::is_trivially_copyable_v<glm::uvec3> && sizeof(glm::uvec3) == 12);
+static_assert(std::is_trivially_copyable_v<FileHeader> && std::is_trivially_copyable_v<SubMeshRecord>);
+
+static uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + 15) & ~uint64_t(15);
+}
+
+// ======== MESH CACHE =========
+MeshCache::MeshCache(MappedFile&& file)
+    : m_file(std::move(file))
+{
+}
+
+std::optional<MeshCache> MeshCache::open(const std::filesystem::path& cacheFile, uint64_t key, const std::filesystem::path& textureBaseDir)
+{
+    if (!std::filesystem::exists(cacheFile))
+        return {};
+    MeshCache out { MappedFile(cacheFile) };
+    const std::span<const std::byte> data = out.m_file.data();
+
+    if (data.size() < sizeof(FileHeader))
+        return {};
+    FileHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != fileMagic || header.version != MESH_CACHE_VERSION || header.key != key || header.fileSize != data.size())
+        return {};
+    const auto inFile = [&](uint64_t offset, uint64_t size) { return offset <= data.size() && size <= data.size() - offset && offset % 16 == 0; };
+    if (!inFile(header.recordOffset, uint64_t(header.numSubMeshes) * sizeof(SubMeshRecord)))
+        return {};
+
+    out.m_report.before = { header.report[0], header.report[1], header.report[2] };
+    out.m_report.after = { header.report[3], header.report[4], header.report[5] };
+    for (uint32_t i = 0; i < header.numSubMeshes; i++) {
+        SubMeshRecord record;
+        std::memcpy(&record, data.data() + header.recordOffset + i * sizeof(SubMeshRecord), sizeof(record));
+        if (!inFile(record.vertexOffset, uint64_t(record.numVertices) * sizeof(Vertex))
+            || !inFile(record.triangleOffset, uint64_t(record.numTriangles) * sizeof(glm::uvec3))
+            || !inFile(record.texturePathOffset, record.texturePathLength))
+            return {};
+
+        SubMesh& subMesh = out.m_subMeshes.emplace_back();
+        subMesh.vertices = { reinterpret_cast<const Vertex*>(data.data() + record.vertexOffset), record.numVertices };
+        subMesh.triangles = { reinterpret_cast<const glm::uvec3*>(data.data() + record.triangleOffset), record.numTriangles };
+        subMesh.material.kd = record.kd;
+        subMesh.material.ks = record.ks;
+        subMesh.material.shininess = record.shininess;
+        subMesh.material.transparency = record.transparency;
+        if (record.texturePathLength > 0) {
+            const std::string texturePath(reinterpret_cast<const char*>(data.data() + record.texturePathOffset), record.texturePathLength);
+            subMesh.material.kdTexturePath = textureBaseDir / std::filesystem::path(texturePath);
+            subMesh.material.kdTexture = std::make_shared<Image>(subMesh.material.kdTexturePath);
+        }
+        subMesh.bounds = { record.boundsLower, record.boundsUpper };
+        subMesh.boundingSphere = { record.sphereCenter, record.sphereRadius };
+    }
+    return out;
+}
+
+std::span<const MeshCache::SubMesh> MeshCache::subMeshes() const
+{
+    return m_subMeshes;
+}
+
+const MeshOptimizationReport& MeshCache::report() const
+{
+    return m_report;
+}
+
+std::vector<Mesh> MeshCache::toMeshes() const
+{
+    std::vector<Mesh> out;
+    for (const SubMesh& subMesh : m_subMeshes) {
+        Mesh& mesh = out.emplace_back();
+        mesh.vertices.assign(std::begin(subMesh.vertices), std::end(subMesh.vertices));
+        mesh.triangles.assign(std::begin(subMesh.triangles), std::end(subMesh.triangles));
+        mesh.material = subMesh.material;
+        mesh.bounds = subMesh.bounds;
+        mesh.boundingSphere = subMesh.boundingSphere;
+    }
+    return out;
+}
+
+// ======== WRITING =========
+MeshCacheWriter::MeshCacheWriter(const std::filesystem::path& cacheFile, uint64_t key, const std::filesystem::path& textureBaseDir)
+    : m_cacheFile(cacheFile)
+    // Unique per writer, such that processes that build the same cache at the same time do not interfere
+    , m_tempFile(cacheFile.string() + fmt::format(".{:08x}.tmp", std::random_device {}()))
+    , m_textureBaseDir(textureBaseDir)
+    , m_key(key)
+    , m_offset(alignOffset(sizeof(FileHeader)))
+{
+    std::error_code error;
+    std::filesystem::create_directories(cacheFile.parent_path(), error);
+    m_stream.open(m_tempFile, std::ios::binary);
+    if (!m_stream)
+        throw std::runtime_error(fmt::format("Could not write mesh cache {}", m_tempFile.string()));
+}
+
+MeshCacheWriter::~MeshCacheWriter()
+{
+    if (m_finished)
+        return;
+    m_stream.close();
+    std::error_code error;
+    std::filesystem::remove(m_tempFile, error);
+}
+
+void MeshCacheWriter::append(const Mesh& mesh)
+{
+    const auto writeAt = [&](uint64_t position, const void* pData, size_t size) {
+        m_stream.seekp(static_cast<std::streamoff>(position));
+        m_stream.write(static_cast<const char*>(pData), static_cast<std::streamsize>(size));
+    };
+    const Material& material = mesh.material;
+    const std::string texturePath = material.kdTexturePath.empty() ? std::string() : material.kdTexturePath.lexically_relative(m_textureBaseDir).generic_string();
+
+    SubMeshRecord record {};
+    record.numVertices = static_cast<uint32_t>(mesh.vertices.size());
+    record.numTriangles = static_cast<uint32_t>(mesh.triangles.size());
+    record.texturePathLength = static_cast<uint32_t>(texturePath.size());
+    record.vertexOffset = m_offset;
+    writeAt(record.vertexOffset, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+    record.triangleOffset = alignOffset(record.vertexOffset + mesh.vertices.size() * sizeof(Vertex));
+    writeAt(record.triangleOffset, mesh.triangles.data(), mesh.triangles.size() * sizeof(glm::uvec3));
+    record.texturePathOffset = alignOffset(record.triangleOffset + mesh.triangles.size() * sizeof(glm::uvec3));
+    writeAt(record.texturePathOffset, texturePath.data(), texturePath.size());
+    m_offset = alignOffset(record.texturePathOffset + texturePath.size());
+    record.kd = material.kd;
+    record.ks = material.ks;
+    record.shininess = material.shininess;
+    record.transparency = material.transparency;
+    record.boundsLower = mesh.bounds.lower;
+    record.boundsUpper = mesh.bounds.upper;
+    record.sphereCenter = mesh.boundingSphere.center;
+    record.sphereRadius = mesh.boundingSphere.radius;
+
+    const auto recordBytes = std::as_bytes(std::span(&record, 1));
+    m_records.insert(std::end(m_records), std::begin(recordBytes), std::end(recordBytes));
+}
+
+void MeshCacheWriter::finish(const MeshOptimizationReport& report)
+{
+    FileHeader header {};
+    header.magic = fileMagic;
+    header.version = MESH_CACHE_VERSION;
+    header.key = m_key;
+    header.recordOffset = m_offset;
+    header.numSubMeshes = static_cast<uint32_t>(m_records.size() / sizeof(SubMeshRecord));
+    header.fileSize = alignOffset(m_offset + m_records.size());
+    header.report = { report.before.numTriangles, report.before.numVertices, report.before.numTransformedVertices,
+        report.after.numTriangles, report.after.numVertices, report.after.numTransformedVertices };
+
+    m_stream.seekp(static_cast<std::streamoff>(header.recordOffset));
+    m_stream.write(reinterpret_cast<const char*>(m_records.data()), static_cast<std::streamsize>(m_records.size()));
+    // Padding at the end of the file
+    m_stream.seekp(static_cast<std::streamoff>(header.fileSize - 1));
+    m_stream.put('\0');
+    m_stream.seekp(0);
+    m_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_stream.close();
+    if (!m_stream)
+        throw std::runtime_error(fmt::format("Could not write mesh cache {}", m_tempFile.string()));
+
+    std::error_code error;
+    std::filesystem::rename(m_tempFile, m_cacheFile, error);
+    if (error)
+        throw std::runtime_error(fmt::format("Could not write mesh cache {}", m_cacheFile.string()));
+    m_finished = true;
+}
+
+uint64_t meshCacheKey(const std::filesystem::path& sourceFile, bool normalize)
+{
+    // 64 bit FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    const auto hashBytes = [&](std::span<const std::byte> bytes) {
+        for (const std::byte byte : bytes)
+            hash = (hash ^ uint64_t(byte)) * 1099511628211ull;
+    };
+    // Evict what was hashed as it goes, such that hashing a large file does not make it resident
+    const MappedFile mappedFile { sourceFile };
+    const std::span<const std::byte> data = mappedFile.data();
+    constexpr size_t sliceSize = 16 << 20;
+    for (size_t offset = 0; offset < data.size(); offset += sliceSize) {
+        hashBytes(data.subspan(offset, std::min(sliceSize, data.size() - offset)));
+        mappedFile.evict(offset, sliceSize);
+    }
+    const std::array<uint32_t, 2> settings { MESH_CACHE_VERSION, normalize ? 1u : 0u };
+    hashBytes(std::as_bytes(std::span(settings)));
+    return hash;
+}
+
+std::filesystem::path defaultMeshCachePath(uint64_t key)
+{
+    return std::filesystem::temp_directory_path() / "mesh_cache" / fmt::format("{:016x}.mesh", key);
+}
+
+void writeMeshCache(const std::filesystem::path& cacheFile, uint64_t key, std::span<const Mesh> meshes,
+    const MeshOptimizationReport& report, const std::filesystem::path& textureBaseDir)
+{
+    MeshCacheWriter writer { cacheFile, key, textureBaseDir };
+    for (const Mesh& mesh : meshes)
+        writer.append(mesh);
+    writer.finish(report);
+}
+
+MeshCache loadMeshCache(const std::filesystem::path& sourceFile, bool normalize)
+{
+    const uint64_t key = meshCacheKey(sourceFile, normalize);
+    const std::filesystem::path cacheFile = defaultMeshCachePath(key);
+    const std::filesystem::path textureBaseDir = sourceFile.parent_path();
+    if (std::optional<MeshCache> cache = MeshCache::open(cacheFile, key, textureBaseDir))
+        return std::move(*cache);
+
+    std::vector<Mesh> meshes = loadMesh(sourceFile, normalize);
+    MeshOptimizationReport report;
+    for (Mesh& mesh : meshes)
+        report += optimizeMesh(mesh);
+    writeMeshCache(cacheFile, key, meshes, report, textureBaseDir);
+    if (std::optional<MeshCache> cache = MeshCache::open(cacheFile, key, textureBaseDir))
+        return std::move(*cache);
+    throw std::runtime_error(fmt::format("Could not read back mesh cache {}", cacheFile.string()));
+}
+
+size_t streamMeshCache(const std::filesystem::path& sourceFile, const std::filesystem::path& cacheFile, uint64_t key, size_t memoryBudget)
+{
+    MeshCacheWriter writer { cacheFile, key, sourceFile.parent_path() };
+    MeshOptimizationReport report;
+    size_t numSubMeshes = 0;
+    streamMesh(sourceFile, memoryBudget, [&](Mesh&& mesh) {
+        report += optimizeMesh(mesh);
+        writer.append(mesh);
+        numSubMeshes++;
+    });
+    writer.finish(report);
+    return numSubMeshes;
+}
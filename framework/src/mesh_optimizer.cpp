@@ -0,0 +1,306 @@
+#include "mesh_optimizer.h"
+#include "mesh_cache.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
+
+float VertexCacheStatistics::acmr() const
+{
+    return numTriangles ? float(numTransformedVertices) / float(numTriangles) : 0.0f;
+}
+
+float VertexCacheStatistics::atvr() const
+{
+    return numVertices ? float(numTransformedVertices) / float(numVertices) : 0.0f;
+}
+
+VertexCacheStatistics& VertexCacheStatistics::operator+=(const VertexCacheStatistics& other)
+{
+    numTriangles += other.numTriangles;
+    numVertices += other.numVertices;
+    numTransformedVertices += other.numTransformedVertices;
+    return *this;
+}
+
+MeshOptimizationReport& MeshOptimizationReport::operator+=(const MeshOptimizationReport& other)
+{
+    before += other.before;
+    after += other.after;
+    return *this;
+}
+
+// FIFO cache of vertex indices, the replacement policy of most GPUs' post-transform caches.
+class FifoCache {
+public:
+    explicit FifoCache(size_t numVertices, size_t cacheSize)
+        : m_insertedAt(numVertices, 0)
+        , m_cacheSize(cacheSize)
+    {
+    }
+
+    // Returns whether the vertex had to be transformed.
+    bool access(unsigned vertex)
+    {
+        // Timestamps start at cacheSize + 1, so a never seen vertex (timestamp 0) always misses
+        if (m_time - m_insertedAt[vertex] <= m_cacheSize)
+            return false;
+        m_insertedAt[vertex] = m_time++;
+        return true;
+    }
+
+private:
+    std::vector<size_t> m_insertedAt;
+    size_t m_cacheSize;
+    size_t m_time { m_cacheSize + 1 };
+};
+
+VertexCacheStatistics analyzeVertexCache(const Mesh& mesh, size_t cacheSize)
+{
+    VertexCacheStatistics statistics;
+    statistics.numTriangles = mesh.triangles.size();
+    FifoCache cache(mesh.vertices.size(), cacheSize);
+    std::vector<bool> referenced(mesh.vertices.size(), false);
+    for (const glm::uvec3& tri : mesh.triangles) {
+        for (int i = 0; i < 3; i++) {
+            if (cache.access(tri[i]))
+                statistics.numTransformedVertices++;
+            if (!referenced[tri[i]]) {
+                referenced[tri[i]] = true;
+                statistics.numVertices++;
+            }
+        }
+    }
+    return statistics;
+}
+
+std::vector<size_t> optimizeVertexCache(Mesh& mesh, size_t cacheSize)
+{
+    const size_t numVertices = mesh.vertices.size();
+    const size_t numTriangles = mesh.triangles.size();
+    if (numTriangles == 0)
+        return {};
+
+    // Triangles adjacent to every vertex, as offsets into one array
+    std::vector<size_t> adjacencyOffsets(numVertices + 1, 0);
+    for (const glm::uvec3& tri : mesh.triangles) {
+        for (int i = 0; i < 3; i++)
+            adjacencyOffsets[tri[i] + 1]++;
+    }
+    std::partial_sum(std::begin(adjacencyOffsets), std::end(adjacencyOffsets), std::begin(adjacencyOffsets));
+    std::vector<size_t> adjacency(adjacencyOffsets.back());
+    std::vector<size_t> fillOffsets(std::begin(adjacencyOffsets), std::end(adjacencyOffsets) - 1);
+    for (size_t t = 0; t < numTriangles; t++) {
+        for (int i = 0; i < 3; i++)
+            adjacency[fillOffsets[mesh.triangles[t][i]]++] = t;
+    }
+
+    std::vector<size_t> liveTriangles(numVertices);
+    for (size_t v = 0; v < numVertices; v++)
+        liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+    std::vector<size_t> cacheTime(numVertices, 0);
+    std::vector<bool> emitted(numTriangles, false);
+    std::vector<unsigned> deadEnds;
+    std::vector<unsigned> candidates;
+    std::vector<glm::uvec3> outTriangles;
+    outTriangles.reserve(numTriangles);
+    std::vector<size_t> clusterStarts;
+    size_t time = cacheSize + 1;
+    size_t cursor = 0; // Next vertex to consider when both the candidates and the dead-end stack are exhausted
+
+    // Vertices of emitted triangles with remaining live triangles, most recently used first
+    const auto skipDeadEnd = [&]() -> std::optional<unsigned> {
+        while (!deadEnds.empty()) {
+            const unsigned vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveTriangles[vertex] > 0)
+                return vertex;
+        }
+        for (; cursor < numVertices; cursor++) {
+            if (liveTriangles[cursor] > 0)
+                return static_cast<unsigned>(cursor);
+        }
+        return {};
+    };
+
+    std::optional<unsigned> fanningVertex = skipDeadEnd();
+    clusterStarts.push_back(0);
+    while (fanningVertex) {
+        candidates.clear();
+        for (size_t a = adjacencyOffsets[*fanningVertex]; a < adjacencyOffsets[*fanningVertex + 1]; a++) {
+            const size_t t = adjacency[a];
+            if (emitted[t])
+                continue;
+            emitted[t] = true;
+            const glm::uvec3& tri = mesh.triangles[t];
+            outTriangles.push_back(tri);
+            for (int i = 0; i < 3; i++) {
+                deadEnds.push_back(tri[i]);
+                candidates.push_back(tri[i]);
+                liveTriangles[tri[i]]--;
+                if (time - cacheTime[tri[i]] > cacheSize)
+                    cacheTime[tri[i]] = time++;
+            }
+        }
+
+        // Prefer the candidate that will still be in the cache after emitting its remaining triangles, and among
+        // those the one that entered the cache first
+        std::optional<unsigned> next;
+        size_t bestPriority = 0;
+        for (const unsigned vertex : candidates) {
+            if (liveTriangles[vertex] == 0)
+                continue;
+            size_t priority = 0;
+            if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+                priority = time - cacheTime[vertex];
+            if (!next || priority > bestPriority) {
+                next = vertex;
+                bestPriority = priority;
+            }
+        }
+        if (!next) {
+            next = skipDeadEnd();
+            // A dead end starts a new cluster
+            if (next && outTriangles.size() < numTriangles)
+                clusterStarts.push_back(outTriangles.size());
+        }
+        fanningVertex = next;
+    }
+    assert(outTriangles.size() == numTriangles);
+
+    mesh.triangles = std::move(outTriangles);
+    return clusterStarts;
+}
+
+void optimizeOverdraw(Mesh& mesh, std::span<const size_t> clusterStarts, size_t cacheSize, float threshold)
+{
+    const size_t numTriangles = mesh.triangles.size();
+    if (numTriangles == 0 || clusterStarts.empty())
+        return;
+
+    // Split the clusters further wherever the cache behaviour so far is good enough, continuing the simulated cache
+    // across splits like the GPU would. Sub-clusters span at least cacheSize triangles, such that a few cache hits at
+    // the start do not break a cluster into single triangles.
+    const float maxAcmr = threshold * analyzeVertexCache(mesh, cacheSize).acmr();
+    std::vector<size_t> starts;
+    FifoCache cache(mesh.vertices.size(), cacheSize);
+    for (size_t cluster = 0; cluster < clusterStarts.size(); cluster++) {
+        const size_t clusterEnd = cluster + 1 < clusterStarts.size() ? clusterStarts[cluster + 1] : numTriangles;
+        size_t subStart = clusterStarts[cluster];
+        size_t subMisses = 0;
+        starts.push_back(subStart);
+        for (size_t t = clusterStarts[cluster]; t < clusterEnd; t++) {
+            for (int i = 0; i < 3; i++) {
+                if (cache.access(mesh.triangles[t][i]))
+                    subMisses++;
+            }
+            const size_t subTriangles = t + 1 - subStart;
+            if (t + 1 < clusterEnd && subTriangles >= cacheSize && float(subMisses) <= maxAcmr * float(subTriangles)) {
+                subStart = t + 1;
+                subMisses = 0;
+                starts.push_back(subStart);
+            }
+        }
+    }
+    starts.push_back(numTriangles);
+
+    // Sort the clusters by how much they face away from the center of the mesh
+    glm::vec3 meshCenter { 0.0f };
+    float meshArea = 0.0f;
+    struct Cluster {
+        size_t first, end;
+        float outwardness;
+    };
+    std::vector<Cluster> clusters;
+    std::vector<glm::vec3> clusterCentroids;
+    std::vector<glm::vec3> clusterNormals;
+    for (size_t c = 0; c + 1 < starts.size(); c++) {
+        glm::vec3 centroid { 0.0f }, normal { 0.0f };
+        float area = 0.0f;
+        for (size_t t = starts[c]; t < starts[c + 1]; t++) {
+            const glm::uvec3& tri = mesh.triangles[t];
+            const glm::vec3 p0 = mesh.vertices[tri[0]].position, p1 = mesh.vertices[tri[1]].position, p2 = mesh.vertices[tri[2]].position;
+            const glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+            const float triArea = glm::length(areaNormal);
+            centroid += triArea * (p0 + p1 + p2) / 3.0f;
+            normal += areaNormal;
+            area += triArea;
+        }
+        meshCenter += centroid;
+        meshArea += area;
+        clusters.push_back({ starts[c], starts[c + 1], 0.0f });
+        clusterCentroids.push_back(area > 0.0f ? centroid / area : centroid);
+        clusterNormals.push_back(glm::length(normal) > 0.0f ? glm::normalize(normal) : normal);
+    }
+    if (meshArea > 0.0f)
+        meshCenter /= meshArea;
+    for (size_t c = 0; c < clusters.size(); c++)
+        clusters[c].outwardness = glm::dot(clusterCentroids[c] - meshCenter, clusterNormals[c]);
+    std::stable_sort(std::begin(clusters), std::end(clusters), [](const Cluster& lhs, const Cluster& rhs) { return lhs.outwardness > rhs.outwardness; });
+
+    std::vector<glm::uvec3> outTriangles;
+    outTriangles.reserve(numTriangles);
+    for (const Cluster& cluster : clusters)
+        outTriangles.insert(std::end(outTriangles), std::begin(mesh.triangles) + static_cast<std::ptrdiff_t>(cluster.first), std::begin(mesh.triangles) + static_cast<std::ptrdiff_t>(cluster.end));
+    mesh.triangles = std::move(outTriangles);
+}
+
+void optimizeVertexFetch(Mesh& mesh)
+{
+    constexpr unsigned unused = 0xFFFFFFFF;
+    std::vector<unsigned> remap(mesh.vertices.size(), unused);
+    std::vector<Vertex> outVertices;
+    outVertices.reserve(mesh.vertices.size());
+    for (glm::uvec3& tri : mesh.triangles) {
+        for (int i = 0; i < 3; i++) {
+            if (remap[tri[i]] == unused) {
+                remap[tri[i]] = (unsigned)outVertices.size();
+                outVertices.push_back(mesh.vertices[tri[i]]);
+            }
+            tri[i] = remap[tri[i]];
+        }
+    }
+    mesh.vertices = std::move(outVertices);
+}
+
+MeshOptimizationReport optimizeMesh(Mesh& mesh, const MeshOptimizationSettings& settings)
+{
+    MeshOptimizationReport report;
+    report.before = analyzeVertexCache(mesh, settings.cacheSize);
+    const std::vector<size_t> clusterStarts = optimizeVertexCache(mesh, settings.cacheSize);
+    optimizeOverdraw(mesh, clusterStarts, settings.cacheSize, settings.overdrawThreshold);
+    optimizeVertexFetch(mesh);
+    // Unreferenced vertices may have been dropped
+    computeBounds(mesh);
+    report.after = analyzeVertexCache(mesh, settings.cacheSize);
+    return report;
+}
+
+std::vector<Mesh> loadOptimizedMesh(const std::filesystem::path& file, bool normalize, MeshOptimizationReport* pReport)
+{
+    // Only loaded and optimized from the source file if there is no binary cache yet
+    std::vector<Mesh> meshes;
+    MeshOptimizationReport report;
+    try {
+        const MeshCache meshCache = loadMeshCache(file, normalize);
+        meshes = meshCache.toMeshes();
+        report = meshCache.report();
+    } catch (const std::runtime_error& error) {
+        std::cerr << error.what() << std::endl;
+        meshes = loadMesh(file, normalize);
+        for (Mesh& mesh : meshes)
+            report += optimizeMesh(mesh);
+    }
+    if (pReport)
+        *pReport = report;
+    return meshes;
+}
@@ -0,0 +1,257 @@
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <queue>
+#include <tuple>
+#include <utility>
+
+// Symmetric 4x4 matrix Q such that v^T Q v (with v = (p, 1)) is the weighted sum of squared distances of p to a set
+// of planes. Dividing by the total weight turns that into a mean squared distance, which is independent of how many
+// triangles were merged into the quadric.
+struct Quadric {
+    // xx, xy, xz, xw, yy, yz, yw, zz, zw, ww
+    std::array<double, 10> m {};
+    double weight { 0.0 };
+
+    static Quadric fromPlane(const glm::dvec3& normal, double offset, double weight)
+    {
+        const double a = normal.x, b = normal.y, c = normal.z, d = offset;
+        Quadric out { { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d }, weight };
+        for (double& coefficient : out.m)
+            coefficient *= weight;
+        return out;
+    }
+
+    Quadric& operator+=(const Quadric& other)
+    {
+        for (size_t i = 0; i < m.size(); i++)
+            m[i] += other.m[i];
+        weight += other.weight;
+        return *this;
+    }
+
+    double meanSquaredDistance(const glm::dvec3& p) const
+    {
+        if (weight == 0.0)
+            return 0.0;
+        const double x = p.x, y = p.y, z = p.z;
+        const double sum = m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x
+            + m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y
+            + m[7] * z * z + 2 * m[8] * z + m[9];
+        return std::max(sum / weight, 0.0);
+    }
+};
+
+// Normals that differ by more than this angle form a hard edge that is preserved like a texture seam.
+static const float hardEdgeCosine = std::cos(glm::radians(60.0f));
+
+static bool isSeam(const Vertex& lhs, const Vertex& rhs)
+{
+    return lhs.texCoord != rhs.texCoord || glm::dot(lhs.normal, rhs.normal) < hardEdgeCosine * glm::length(lhs.normal) * glm::length(rhs.normal);
+}
+
+MeshLod simplifyMesh(const Mesh& mesh, size_t targetTriangles)
+{
+    const size_t numVertices = mesh.vertices.size();
+    std::vector<glm::uvec3> triangles = mesh.triangles;
+
+    // Vertices that only differ in normal or texture coordinates are split, so the topology is defined by position
+    std::map<std::tuple<float, float, float>, unsigned> positionIndices;
+    std::vector<unsigned> positionOf(numVertices);
+    std::vector<glm::dvec3> positions;
+    std::vector<std::vector<unsigned>> verticesAt;
+    for (size_t v = 0; v < numVertices; v++) {
+        const glm::vec3& p = mesh.vertices[v].position;
+        const auto [iter, isNew] = positionIndices.try_emplace({ p.x, p.y, p.z }, static_cast<unsigned>(positions.size()));
+        if (isNew) {
+            positions.push_back(glm::dvec3(p));
+            verticesAt.emplace_back();
+        }
+        positionOf[v] = iter->second;
+        verticesAt[iter->second].push_back(static_cast<unsigned>(v));
+    }
+    const size_t numPositions = positions.size();
+
+    std::vector<std::vector<unsigned>> trianglesAt(numPositions);
+    std::vector<Quadric> quadrics(numPositions);
+    // Edges by position, with the vertices of every triangle that uses them: borders are used once, seams by
+    // triangles whose vertices have different attributes
+    std::map<std::pair<unsigned, unsigned>, std::vector<std::pair<unsigned, unsigned>>> edgeUses;
+    for (size_t t = 0; t < triangles.size(); t++) {
+        const glm::uvec3& tri = triangles[t];
+        const glm::dvec3 p0 = positions[positionOf[tri[0]]], p1 = positions[positionOf[tri[1]]], p2 = positions[positionOf[tri[2]]];
+        const glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        if (glm::length(normal) > 0.0) {
+            // Weighted by area, such that the error is not dominated by many small triangles
+            const glm::dvec3 unitNormal = glm::normalize(normal);
+            const Quadric plane = Quadric::fromPlane(unitNormal, -glm::dot(unitNormal, p0), 0.5 * glm::length(normal));
+            for (int i = 0; i < 3; i++)
+                quadrics[positionOf[tri[i]]] += plane;
+        }
+        for (int i = 0; i < 3; i++) {
+            trianglesAt[positionOf[tri[i]]].push_back(static_cast<unsigned>(t));
+            const unsigned a = positionOf[tri[i]], b = positionOf[tri[(i + 1) % 3]];
+            edgeUses[{ std::min(a, b), std::max(a, b) }].push_back(a < b ? std::pair { tri[i], tri[(i + 1) % 3] } : std::pair { tri[(i + 1) % 3], tri[i] });
+        }
+    }
+    for (const auto& [edge, uses] : edgeUses) {
+        const bool seam = uses.size() != 2
+            || isSeam(mesh.vertices[uses[0].first], mesh.vertices[uses[1].first])
+            || isSeam(mesh.vertices[uses[0].second], mesh.vertices[uses[1].second]);
+        if (!seam || edge.first == edge.second)
+            continue;
+        // Plane through the edge, perpendicular to the (first) triangle that uses it
+        const auto [v0, v1] = uses[0];
+        const glm::dvec3 p0 = positions[edge.first], p1 = positions[edge.second];
+        const unsigned t = *std::find_if(std::begin(trianglesAt[edge.first]), std::end(trianglesAt[edge.first]), [&](unsigned tri) {
+            return std::find(&triangles[tri][0], &triangles[tri][0] + 3, v0) != &triangles[tri][0] + 3
+                && std::find(&triangles[tri][0], &triangles[tri][0] + 3, v1) != &triangles[tri][0] + 3;
+        });
+        const glm::uvec3& tri = triangles[t];
+        const glm::dvec3 faceNormal = glm::cross(positions[positionOf[tri[1]]] - positions[positionOf[tri[0]]], positions[positionOf[tri[2]]] - positions[positionOf[tri[0]]]);
+        const glm::dvec3 edgeNormal = glm::cross(p1 - p0, faceNormal);
+        if (glm::length(edgeNormal) == 0.0)
+            continue;
+        const glm::dvec3 unitNormal = glm::normalize(edgeNormal);
+        const Quadric plane = Quadric::fromPlane(unitNormal, -glm::dot(unitNormal, p0), glm::dot(p1 - p0, p1 - p0));
+        quadrics[edge.first] += plane;
+        quadrics[edge.second] += plane;
+    }
+
+    // Collapse of position "from" onto position "to"; entries are stale once either endpoint changed
+    struct Collapse {
+        double cost;
+        unsigned from, to;
+        uint32_t fromVersion, toVersion;
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+    std::vector<uint32_t> versions(numPositions, 0);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+    const auto pushCollapses = [&](unsigned a, unsigned b) {
+        Quadric sum = quadrics[a];
+        sum += quadrics[b];
+        queue.push({ sum.meanSquaredDistance(positions[b]), a, b, versions[a], versions[b] });
+        queue.push({ sum.meanSquaredDistance(positions[a]), b, a, versions[b], versions[a] });
+    };
+    for (const auto& [edge, uses] : edgeUses) {
+        if (edge.first != edge.second)
+            pushCollapses(edge.first, edge.second);
+    }
+
+    std::vector<bool> removed(triangles.size(), false);
+    size_t numTriangles = triangles.size();
+    double maxCost = 0.0;
+    const auto hasPosition = [&](const glm::uvec3& tri, unsigned position) {
+        return positionOf[tri[0]] == position || positionOf[tri[1]] == position || positionOf[tri[2]] == position;
+    };
+    while (numTriangles > targetTriangles && !queue.empty()) {
+        const Collapse collapse = queue.top();
+        queue.pop();
+        if (collapse.fromVersion != versions[collapse.from] || collapse.toVersion != versions[collapse.to])
+            continue;
+
+        // Reject collapses that flip a triangle that keeps its area
+        bool flips = false;
+        for (const unsigned t : trianglesAt[collapse.from]) {
+            if (removed[t] || hasPosition(triangles[t], collapse.to))
+                continue;
+            const glm::uvec3& tri = triangles[t];
+            std::array<glm::dvec3, 3> before, after;
+            for (int i = 0; i < 3; i++) {
+                before[size_t(i)] = positions[positionOf[tri[i]]];
+                after[size_t(i)] = positionOf[tri[i]] == collapse.from ? positions[collapse.to] : before[size_t(i)];
+            }
+            const glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            const glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            flips |= glm::dot(normalBefore, normalAfter) <= 0.0;
+        }
+        if (flips)
+            continue;
+
+        // Every vertex at the removed position continues as the vertex at the kept position with the closest attributes
+        std::vector<std::pair<unsigned, unsigned>> remap;
+        for (const unsigned from : verticesAt[collapse.from]) {
+            const auto attributeDistance = [&](unsigned to) {
+                const Vertex &a = mesh.vertices[from], &b = mesh.vertices[to];
+                return glm::dot(a.normal - b.normal, a.normal - b.normal) + glm::dot(a.texCoord - b.texCoord, a.texCoord - b.texCoord);
+            };
+            const unsigned to = *std::min_element(std::begin(verticesAt[collapse.to]), std::end(verticesAt[collapse.to]),
+                [&](unsigned lhs, unsigned rhs) { return attributeDistance(lhs) < attributeDistance(rhs); });
+            remap.emplace_back(from, to);
+        }
+        for (const unsigned t : trianglesAt[collapse.from]) {
+            if (removed[t])
+                continue;
+            if (hasPosition(triangles[t], collapse.to)) {
+                removed[t] = true;
+                numTriangles--;
+                continue;
+            }
+            for (int i = 0; i < 3; i++) {
+                for (const auto& [from, to] : remap) {
+                    if (triangles[t][i] == from)
+                        triangles[t][i] = to;
+                }
+            }
+            trianglesAt[collapse.to].push_back(t);
+        }
+        for (const auto& [from, to] : remap)
+            positionOf[from] = collapse.to;
+        trianglesAt[collapse.from].clear();
+        verticesAt[collapse.from].clear();
+        quadrics[collapse.to] += quadrics[collapse.from];
+        versions[collapse.from]++;
+        versions[collapse.to]++;
+        maxCost = std::max(maxCost, collapse.cost);
+
+        // The quadric of the kept position changed, so all of its edges get new costs
+        std::erase_if(trianglesAt[collapse.to], [&](unsigned t) { return removed[t]; });
+        std::vector<unsigned> neighbours;
+        for (const unsigned t : trianglesAt[collapse.to]) {
+            for (int i = 0; i < 3; i++)
+                neighbours.push_back(positionOf[triangles[t][i]]);
+        }
+        std::sort(std::begin(neighbours), std::end(neighbours));
+        neighbours.erase(std::unique(std::begin(neighbours), std::end(neighbours)), std::end(neighbours));
+        for (const unsigned neighbour : neighbours) {
+            if (neighbour != collapse.to)
+                pushCollapses(neighbour, collapse.to);
+        }
+    }
+
+    MeshLod out;
+    out.mesh.vertices = mesh.vertices;
+    out.mesh.material = mesh.material;
+    for (size_t t = 0; t < triangles.size(); t++) {
+        if (!removed[t])
+            out.mesh.triangles.push_back(triangles[t]);
+    }
+    // Drops the vertices that are no longer used
+    optimizeVertexFetch(out.mesh);
+    computeBounds(out.mesh);
+    out.error = static_cast<float>(std::sqrt(maxCost));
+    return out;
+}
+
+std::vector<MeshLod> buildLodChain(const Mesh& mesh, std::span<const float> triangleRatios)
+{
+    std::vector<MeshLod> out;
+    for (const float ratio : triangleRatios) {
+        // Every level is simplified from the original, such that its error is measured against the original
+        MeshLod lod = simplifyMesh(mesh, static_cast<size_t>(ratio * float(mesh.triangles.size())));
+        optimizeMesh(lod.mesh);
+        out.push_back(std::move(lod));
+    }
+    return out;
+}
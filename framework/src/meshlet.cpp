@@ -0,0 +1,194 @@
+#include "meshlet.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <tuple>
+
+// Smallest normal cone that contains the normals of all triangles, centered on their average (meshoptimizer's
+// formulation). The apex is moved back along the axis until it lies behind the plane of every triangle, such that
+// the test holds for viewers close to the meshlet as well.
+static void computeNormalCone(Meshlet& meshlet, std::span<const glm::uvec3> triangles, std::span<const Vertex> vertices)
+{
+    std::vector<glm::vec3> normals;
+    glm::vec3 normalSum { 0.0f };
+    for (const glm::uvec3& tri : triangles) {
+        const glm::vec3 p0 = vertices[tri[0]].position, p1 = vertices[tri[1]].position, p2 = vertices[tri[2]].position;
+        const glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+        const float area = glm::length(areaNormal);
+        normals.push_back(area > 0.0f ? areaNormal / area : glm::vec3(0.0f));
+        normalSum += normals.back();
+    }
+    if (glm::length(normalSum) == 0.0f)
+        return;
+    meshlet.coneAxis = glm::normalize(normalSum);
+
+    float minCosine = 1.0f;
+    for (const glm::vec3& normal : normals)
+        minCosine = std::min(minCosine, glm::dot(normal, meshlet.coneAxis));
+    // A cone that is (almost) a half space cannot be back-facing as a whole
+    if (minCosine <= 0.1f) {
+        meshlet.coneCutoff = 2.0f;
+        return;
+    }
+
+    const glm::vec3 center = meshlet.boundingSphere.center;
+    float maxDistance = 0.0f;
+    for (size_t t = 0; t < triangles.size(); t++) {
+        const float normalAlongAxis = glm::dot(normals[t], meshlet.coneAxis);
+        if (normalAlongAxis <= 0.0f)
+            continue; // Degenerate triangle
+        const float distance = glm::dot(center - vertices[triangles[t][0]].position, normals[t]) / normalAlongAxis;
+        maxDistance = std::max(maxDistance, distance);
+    }
+    meshlet.coneApex = center - meshlet.coneAxis * maxDistance;
+    meshlet.coneCutoff = std::sqrt(1.0f - minCosine * minCosine);
+}
+
+static void finishMeshlet(Meshlet& meshlet, const Mesh& mesh, std::span<const unsigned> meshletVertices)
+{
+    AxisAlignedBox bounds;
+    for (const unsigned vertex : meshletVertices) {
+        bounds.lower = glm::min(bounds.lower, mesh.vertices[vertex].position);
+        bounds.upper = glm::max(bounds.upper, mesh.vertices[vertex].position);
+    }
+    // Centered on the box, like the bounding sphere of computeBounds()
+    meshlet.boundingSphere.center = 0.5f * (bounds.lower + bounds.upper);
+    for (const unsigned vertex : meshletVertices)
+        meshlet.boundingSphere.radius = std::max(meshlet.boundingSphere.radius, glm::length(mesh.vertices[vertex].position - meshlet.boundingSphere.center));
+
+    computeNormalCone(meshlet, std::span(mesh.triangles).subspan(meshlet.firstTriangle, meshlet.numTriangles), mesh.vertices);
+}
+
+std::vector<Meshlet> buildMeshlets(Mesh& mesh, size_t maxVertices, size_t maxTriangles)
+{
+    assert(maxVertices >= 3 && maxTriangles >= 1);
+    const size_t numTriangles = mesh.triangles.size();
+
+    // Vertices that only differ in normal or texture coordinates are split, so triangles are connected by position
+    std::vector<unsigned> sortedVertices(mesh.vertices.size());
+    std::iota(std::begin(sortedVertices), std::end(sortedVertices), 0u);
+    const auto positionLess = [&](unsigned lhs, unsigned rhs) {
+        const glm::vec3 &a = mesh.vertices[lhs].position, &b = mesh.vertices[rhs].position;
+        return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+    };
+    std::sort(std::begin(sortedVertices), std::end(sortedVertices), positionLess);
+    std::vector<unsigned> positionIds(mesh.vertices.size());
+    unsigned numPositions = 0;
+    for (size_t i = 0; i < sortedVertices.size(); i++) {
+        if (i > 0 && positionLess(sortedVertices[i - 1], sortedVertices[i]))
+            numPositions++;
+        positionIds[sortedVertices[i]] = numPositions;
+    }
+    numPositions = sortedVertices.empty() ? 0 : numPositions + 1;
+
+    // Triangles around every position, as offsets into one array
+    std::vector<size_t> adjacencyOffsets(numPositions + 1, 0);
+    for (const glm::uvec3& tri : mesh.triangles) {
+        for (int i = 0; i < 3; i++)
+            adjacencyOffsets[positionIds[tri[i]] + 1]++;
+    }
+    std::partial_sum(std::begin(adjacencyOffsets), std::end(adjacencyOffsets), std::begin(adjacencyOffsets));
+    std::vector<unsigned> adjacency(adjacencyOffsets.back());
+    std::vector<size_t> fillOffsets(std::begin(adjacencyOffsets), std::end(adjacencyOffsets) - 1);
+    for (size_t t = 0; t < numTriangles; t++) {
+        for (int i = 0; i < 3; i++)
+            adjacency[fillOffsets[positionIds[mesh.triangles[t][i]]]++] = static_cast<unsigned>(t);
+    }
+
+    std::vector<glm::vec3> centroids;
+    for (const glm::uvec3& tri : mesh.triangles)
+        centroids.push_back((mesh.vertices[tri[0]].position + mesh.vertices[tri[1]].position + mesh.vertices[tri[2]].position) / 3.0f);
+
+    // Grow every meshlet from a seed triangle by adding the neighbour that adds the fewest vertices, and among those
+    // the one closest to the meshlet's centroid, which keeps meshlets compact and their normal cones narrow
+    std::vector<Meshlet> out;
+    std::vector<glm::uvec3> outTriangles;
+    outTriangles.reserve(numTriangles);
+    std::vector<bool> emitted(numTriangles, false);
+    constexpr uint32_t none = 0xFFFFFFFF;
+    std::vector<uint32_t> vertexMeshlet(mesh.vertices.size(), none); // Meshlet that every vertex was last added to
+    std::vector<unsigned> meshletVertices;
+    std::vector<unsigned> candidates;
+    size_t seed = 0;
+    while (outTriangles.size() < numTriangles) {
+        while (emitted[seed])
+            seed++;
+        const uint32_t meshletIdx = static_cast<uint32_t>(out.size());
+        Meshlet& meshlet = out.emplace_back(Meshlet { .firstTriangle = static_cast<uint32_t>(outTriangles.size()), .numTriangles = 0, .numVertices = 0 });
+        meshletVertices.clear();
+        candidates.assign(1, static_cast<unsigned>(seed));
+        glm::vec3 centroidSum { 0.0f };
+
+        const auto numNewVertices = [&](unsigned t) {
+            const glm::uvec3& tri = mesh.triangles[t];
+            size_t count = 0;
+            for (int i = 0; i < 3; i++) {
+                // Repeated vertices of a degenerate triangle are counted once
+                if (vertexMeshlet[tri[i]] != meshletIdx && (i == 0 || tri[i] != tri[0]) && (i < 2 || tri[2] != tri[1]))
+                    count++;
+            }
+            return count;
+        };
+
+        while (meshlet.numTriangles < maxTriangles) {
+            const glm::vec3 center = meshlet.numTriangles ? centroidSum / float(meshlet.numTriangles) : glm::vec3(0.0f);
+            std::optional<unsigned> best;
+            size_t bestNewVertices = 0;
+            float bestDistance = 0.0f;
+            size_t numLive = 0;
+            for (const unsigned t : candidates) {
+                if (emitted[t])
+                    continue;
+                candidates[numLive++] = t;
+                const size_t newVertices = numNewVertices(t);
+                const float distance = glm::length(centroids[t] - center);
+                if (!best || std::tie(newVertices, distance) < std::tie(bestNewVertices, bestDistance)) {
+                    best = t;
+                    bestNewVertices = newVertices;
+                    bestDistance = distance;
+                }
+            }
+            candidates.resize(numLive);
+            if (!best || meshlet.numVertices + bestNewVertices > maxVertices)
+                break;
+
+            const glm::uvec3& tri = mesh.triangles[*best];
+            emitted[*best] = true;
+            outTriangles.push_back(tri);
+            meshlet.numTriangles++;
+            centroidSum += centroids[*best];
+            for (int i = 0; i < 3; i++) {
+                if (vertexMeshlet[tri[i]] != meshletIdx) {
+                    vertexMeshlet[tri[i]] = meshletIdx;
+                    meshletVertices.push_back(tri[i]);
+                    meshlet.numVertices++;
+                }
+                const unsigned position = positionIds[tri[i]];
+                for (size_t a = adjacencyOffsets[position]; a < adjacencyOffsets[position + 1]; a++) {
+                    if (!emitted[adjacency[a]] && std::find(std::begin(candidates), std::end(candidates), adjacency[a]) == std::end(candidates))
+                        candidates.push_back(adjacency[a]);
+                }
+            }
+        }
+    }
+
+    mesh.triangles = std::move(outTriangles);
+    for (Meshlet& meshlet : out) {
+        meshletVertices.clear();
+        for (uint32_t t = meshlet.firstTriangle; t < meshlet.firstTriangle + meshlet.numTriangles; t++) {
+            for (int i = 0; i < 3; i++)
+                meshletVertices.push_back(mesh.triangles[t][i]);
+        }
+        finishMeshlet(meshlet, mesh, meshletVertices);
+    }
+    return out;
+}
@@ -0,0 +1,573 @@
+#include "obj_parser.h"
+#include "mapped_file.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <fmt/format.h>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+// Chunks are only worth a thread of their own if they are this large.
+static constexpr size_t minChunkSize = 1 << 20;
+
+// ======== CHUNKS =========
+// Faces may use negative indices, which count back from the vertices read so far. Those are first resolved against
+// the arrays of the chunk and marked, such that the merge can add the number of vertices of the preceding chunks.
+static constexpr uint8_t relativePosition = 1, relativeTexCoord = 2, relativeNormal = 4;
+
+struct FaceVertex {
+    int position { -1 };
+    int texCoord { -1 };
+    int normal { -1 };
+    uint8_t relative { 0 };
+};
+
+enum class EventType {
+    UseMaterial,
+    MaterialLibrary,
+    Group // g and o, which are treated the same way
+};
+
+struct Event {
+    EventType type;
+    // Faces, face vertices and positions of the chunk that precede the event
+    size_t face;
+    size_t faceVertex;
+    size_t numPositions;
+    std::string argument;
+};
+
+struct Chunk {
+    std::vector<float> positions, normals, texCoords;
+    std::vector<FaceVertex> faceVertices;
+    std::vector<uint8_t> faceSizes; // Number of vertices of each face
+    std::vector<Event> events;
+    bool supported { true };
+};
+
+// ======== LINE PARSING =========
+// Every line is parsed the same way as tinyobjloader does, such that both produce bit-identical results.
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static const char* skipSpaces(const char* p, const char* end)
+{
+    while (p != end && isSpace(*p))
+        p++;
+    return p;
+}
+
+static const char* findTokenEnd(const char* p, const char* end, bool stopAtSlash)
+{
+    while (p != end && !isSpace(*p) && !(stopAtSlash && *p == '/'))
+        p++;
+    return p;
+}
+
+// Port of tryParseDouble() from tinyobjloader, bounded by the end of the token instead of a terminator.
+static bool tryParseDouble(const char* p, const char* end, double& result)
+{
+    if (p == end)
+        return false;
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    char sign = '+', exponentSign = '+';
+    bool leadingDecimalDot = false;
+    if (*p == '+' || *p == '-') {
+        sign = *p++;
+        leadingDecimalDot = p != end && *p == '.';
+    } else if (*p == '.') {
+        leadingDecimalDot = true;
+    } else if (!isDigit(*p)) {
+        return false;
+    }
+
+    int read = 0;
+    if (!leadingDecimalDot) {
+        while (p != end && isDigit(*p)) {
+            mantissa *= 10;
+            mantissa += *p++ - '0';
+            read++;
+        }
+        if (read == 0)
+            return false;
+    }
+
+    if (p != end && *p == '.') {
+        static constexpr double powLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+        p++;
+        read = 1;
+        while (p != end && isDigit(*p)) {
+            mantissa += (*p++ - '0') * (read < 8 ? powLut[read] : std::pow(10.0, -read));
+            read++;
+        }
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p != end && (*p == '+' || *p == '-'))
+            exponentSign = *p++;
+        else if (p == end || !isDigit(*p))
+            return false;
+
+        read = 0;
+        while (p != end && isDigit(*p)) {
+            if (exponent > std::numeric_limits<int>::max() / 10)
+                return false;
+            exponent = exponent * 10 + (*p++ - '0');
+            read++;
+        }
+        exponent *= (exponentSign == '+' ? 1 : -1);
+        if (read == 0)
+            return false;
+    }
+
+    result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+    return true;
+}
+
+static float parseReal(const char*& p, const char* end)
+{
+    p = skipSpaces(p, end);
+    const char* tokenEnd = findTokenEnd(p, end, false);
+    double value = 0.0; // Invalid numbers read as zero
+    tryParseDouble(p, tokenEnd, value);
+    p = tokenEnd;
+    return static_cast<float>(value);
+}
+
+// Behaves like atoi(), but stops at the end of the line.
+static int parseInt(const char* p, const char* end)
+{
+    while (p != end && std::isspace(static_cast<unsigned char>(*p)))
+        p++;
+    bool negative = false;
+    if (p != end && (*p == '+' || *p == '-'))
+        negative = *p++ == '-';
+    int64_t value = 0;
+    while (p != end && isDigit(*p) && value <= std::numeric_limits<int>::max())
+        value = value * 10 + (*p++ - '0');
+    return static_cast<int>(std::min<int64_t>(negative ? -value : value, std::numeric_limits<int>::max()));
+}
+
+static std::string parseString(const char* p, const char* end)
+{
+    p = skipSpaces(p, end);
+    return std::string(p, findTokenEnd(p, end, false));
+}
+
+// Converts a one-based OBJ index into a zero-based one. Zero is not a valid index.
+static bool fixIndex(int index, size_t count, int& out, uint8_t& relative, uint8_t relativeFlag)
+{
+    if (index > 0) {
+        out = index - 1;
+        return true;
+    }
+    if (index == 0)
+        return false;
+    out = static_cast<int>(count) + index;
+    relative |= relativeFlag;
+    return true;
+}
+
+// Parses v, v/vt, v//vn or v/vt/vn.
+static bool parseFaceVertex(const char*& p, const char* end, const Chunk& chunk, FaceVertex& out)
+{
+    if (!fixIndex(parseInt(p, end), chunk.positions.size() / 3, out.position, out.relative, relativePosition))
+        return false;
+    p = findTokenEnd(p, end, true);
+    if (p == end || *p != '/')
+        return true;
+    p++;
+
+    if (p != end && *p == '/') {
+        p++;
+        if (!fixIndex(parseInt(p, end), chunk.normals.size() / 3, out.normal, out.relative, relativeNormal))
+            return false;
+        p = findTokenEnd(p, end, true);
+        return true;
+    }
+
+    if (!fixIndex(parseInt(p, end), chunk.texCoords.size() / 2, out.texCoord, out.relative, relativeTexCoord))
+        return false;
+    p = findTokenEnd(p, end, true);
+    if (p == end || *p != '/')
+        return true;
+    p++;
+
+    if (!fixIndex(parseInt(p, end), chunk.normals.size() / 3, out.normal, out.relative, relativeNormal))
+        return false;
+    p = findTokenEnd(p, end, true);
+    return true;
+}
+
+static void parseLine(const char* p, const char* end, Chunk& chunk)
+{
+    p = skipSpaces(p, end);
+    if (p == end || *p == '#')
+        return;
+
+    const std::string_view line { p, static_cast<size_t>(end - p) };
+    const auto isCommand = [&](std::string_view name) { return line.size() > name.size() && line.starts_with(name) && isSpace(line[name.size()]); };
+    const auto addEvent = [&](EventType type, std::string argument) {
+        chunk.events.push_back({ type, chunk.faceSizes.size(), chunk.faceVertices.size(), chunk.positions.size() / 3, std::move(argument) });
+    };
+
+    if (isCommand("v")) {
+        p += 2;
+        for (int i = 0; i < 3; i++)
+            chunk.positions.push_back(parseReal(p, end));
+    } else if (isCommand("vn")) {
+        p += 3;
+        for (int i = 0; i < 3; i++)
+            chunk.normals.push_back(parseReal(p, end));
+    } else if (isCommand("vt")) {
+        p += 3;
+        for (int i = 0; i < 2; i++)
+            chunk.texCoords.push_back(parseReal(p, end));
+    } else if (isCommand("f")) {
+        p = skipSpaces(p + 2, end);
+        uint8_t numVertices = 0;
+        while (p != end) {
+            FaceVertex faceVertex;
+            if (numVertices == 4 || !parseFaceVertex(p, end, chunk, faceVertex)) {
+                chunk.supported = false;
+                return;
+            }
+            chunk.faceVertices.push_back(faceVertex);
+            numVertices++;
+            p = skipSpaces(p, end);
+        }
+        chunk.faceSizes.push_back(numVertices);
+    } else if (line.starts_with("usemtl")) {
+        addEvent(EventType::UseMaterial, parseString(p + 6, end));
+    } else if (isCommand("mtllib")) {
+        addEvent(EventType::MaterialLibrary, std::string(p + 7, end));
+    } else if (isCommand("g") || isCommand("o")) {
+        addEvent(EventType::Group, {});
+    } else if (isCommand("l") || isCommand("p") || line.starts_with("vw")) {
+        chunk.supported = false;
+    }
+}
+
+static void parseChunk(const char* begin, const char* end, Chunk& chunk, std::atomic_bool& unsupported)
+{
+    for (const char* line = begin; line < end && chunk.supported; ) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', static_cast<size_t>(end - line)));
+        if (!lineEnd)
+            lineEnd = end;
+        // A lone carriage return ends a line as well
+        for (const char* segment = line;;) {
+            const char* segmentEnd = static_cast<const char*>(std::memchr(segment, '\r', static_cast<size_t>(lineEnd - segment)));
+            if (!segmentEnd)
+                segmentEnd = lineEnd;
+            parseLine(segment, segmentEnd, chunk);
+            if (segmentEnd == lineEnd)
+                break;
+            segment = segmentEnd + 1;
+        }
+        line = lineEnd + 1;
+
+        if (unsupported.load(std::memory_order_relaxed))
+            return;
+    }
+    if (!chunk.supported)
+        unsupported.store(true, std::memory_order_relaxed);
+}
+
+// Splits the text at line breaks into chunks of about equal size, and parses them in parallel. Returns false if the
+// text uses features that are not supported.
+static bool parseChunks(const char* pBegin, const char* pEnd, std::vector<Chunk>& chunks)
+{
+    const size_t size = static_cast<size_t>(pEnd - pBegin);
+    std::vector<const char*> boundaries { pBegin };
+    for (size_t i = 1; i < chunks.size(); i++) {
+        const char* pTarget = std::max(pBegin + size * i / chunks.size(), boundaries.back());
+        const char* pLineEnd = static_cast<const char*>(std::memchr(pTarget, '\n', static_cast<size_t>(pEnd - pTarget)));
+        boundaries.push_back(pLineEnd ? pLineEnd + 1 : pEnd);
+    }
+    boundaries.push_back(pEnd);
+
+    std::atomic_bool unsupported { false };
+    {
+        std::vector<std::jthread> threads;
+        for (size_t i = 1; i < chunks.size(); i++)
+            threads.emplace_back(parseChunk, boundaries[i], boundaries[i + 1], std::ref(chunks[i]), std::ref(unsupported));
+        parseChunk(boundaries[0], boundaries[1], chunks[0], unsupported);
+    }
+    return !unsupported;
+}
+
+// ======== MERGING =========
+// Appends the vertex arrays of the chunk to those read before, and makes its relative indices absolute.
+static void appendVertices(Chunk& chunk, tinyobj::attrib_t& attrib)
+{
+    const int numPositions = static_cast<int>(attrib.vertices.size() / 3);
+    const int numNormals = static_cast<int>(attrib.normals.size() / 3);
+    const int numTexCoords = static_cast<int>(attrib.texcoords.size() / 2);
+    for (FaceVertex& faceVertex : chunk.faceVertices) {
+        if (faceVertex.relative & relativePosition)
+            faceVertex.position += numPositions;
+        if (faceVertex.relative & relativeTexCoord)
+            faceVertex.texCoord += numTexCoords;
+        if (faceVertex.relative & relativeNormal)
+            faceVertex.normal += numNormals;
+        faceVertex.relative = 0;
+    }
+    attrib.vertices.insert(std::end(attrib.vertices), std::begin(chunk.positions), std::end(chunk.positions));
+    attrib.normals.insert(std::end(attrib.normals), std::begin(chunk.normals), std::end(chunk.normals));
+    attrib.texcoords.insert(std::end(attrib.texcoords), std::begin(chunk.texCoords), std::end(chunk.texCoords));
+    std::vector<float>().swap(chunk.positions);
+    std::vector<float>().swap(chunk.normals);
+    std::vector<float>().swap(chunk.texCoords);
+}
+
+// Port of SplitString() from tinyobjloader, used for the file names of mtllib.
+static std::vector<std::string> splitFileNames(const std::string& string)
+{
+    std::vector<std::string> out;
+    std::string token;
+    bool escaping = false;
+    for (const char c : string) {
+        if (escaping) {
+            escaping = false;
+        } else if (c == '\\') {
+            escaping = true;
+            continue;
+        } else if (c == ' ') {
+            if (!token.empty())
+                out.push_back(std::move(token));
+            token.clear();
+            continue;
+        }
+        token += c;
+    }
+    out.push_back(std::move(token));
+    return out;
+}
+
+// Loads the first of the files listed by mtllib that can be read, like tinyobjloader does.
+static void loadMaterialLibrary(const std::string& fileNames, const std::filesystem::path& objFile,
+    std::vector<tinyobj::material_t>& materials, std::map<std::string, int>& materialMap)
+{
+    std::string baseDir = objFile.parent_path().string();
+    if (!baseDir.empty())
+        baseDir += '/';
+    tinyobj::MaterialFileReader materialReader { baseDir };
+    for (const std::string& fileName : splitFileNames(fileNames)) {
+        std::string warning, error;
+        if (materialReader(fileName, &materials, &materialMap, &warning, &error))
+            return;
+    }
+}
+
+static void appendTriangle(tinyobj::mesh_t& mesh, std::initializer_list<FaceVertex> vertices, int material)
+{
+    for (const FaceVertex& vertex : vertices)
+        mesh.indices.push_back({ vertex.position, vertex.normal, vertex.texCoord });
+    mesh.num_face_vertices.push_back(3);
+    mesh.material_ids.push_back(material);
+}
+
+// Triangulates a face the way tinyobjloader does. Quads are split along their shorter diagonal, unless they reference
+// positions that were not read yet (by the end of their group), in which case they are dropped.
+static void appendFace(tinyobj::mesh_t& mesh, const FaceVertex* pFaceVertex, uint8_t numVertices, size_t numPositions, const std::vector<float>& positions, int material)
+{
+    if (numVertices == 3) {
+        appendTriangle(mesh, { pFaceVertex[0], pFaceVertex[1], pFaceVertex[2] }, material);
+    } else if (numVertices == 4) {
+        if (std::any_of(pFaceVertex, pFaceVertex + 4, [&](const FaceVertex& vertex) { return static_cast<size_t>(vertex.position) >= numPositions; }))
+            return;
+
+        const auto squaredDistance = [&](const FaceVertex& a, const FaceVertex& b) {
+            const float* pA = &positions[3 * static_cast<size_t>(a.position)];
+            const float* pB = &positions[3 * static_cast<size_t>(b.position)];
+            const float x = pB[0] - pA[0], y = pB[1] - pA[1], z = pB[2] - pA[2];
+            return x * x + y * y + z * z;
+        };
+        if (squaredDistance(pFaceVertex[0], pFaceVertex[2]) < squaredDistance(pFaceVertex[1], pFaceVertex[3])) {
+            appendTriangle(mesh, { pFaceVertex[0], pFaceVertex[1], pFaceVertex[2] }, material);
+            appendTriangle(mesh, { pFaceVertex[0], pFaceVertex[2], pFaceVertex[3] }, material);
+        } else {
+            appendTriangle(mesh, { pFaceVertex[0], pFaceVertex[1], pFaceVertex[3] }, material);
+            appendTriangle(mesh, { pFaceVertex[1], pFaceVertex[2], pFaceVertex[3] }, material);
+        }
+    }
+}
+
+static void mergeChunks(std::vector<Chunk>& chunks, const std::filesystem::path& file, tinyobj::attrib_t& attrib,
+    std::vector<tinyobj::shape_t>& shapes, std::vector<tinyobj::material_t>& materials)
+{
+    std::vector<size_t> positionOffsets;
+    attrib = {};
+    for (Chunk& chunk : chunks) {
+        positionOffsets.push_back(attrib.vertices.size() / 3);
+        appendVertices(chunk, attrib);
+    }
+
+    // Replay the events in file order. Faces are appended to the current shape whenever the group or material changes.
+    struct Cursor {
+        size_t chunk, face, faceVertex;
+    };
+    Cursor groupStart { 0, 0, 0 };
+    int material = -1;
+    const auto flushGroup = [&](const Cursor& groupEnd, size_t numPositions, tinyobj::shape_t& shape) {
+        size_t numFaces = 0;
+        for (size_t c = groupStart.chunk; c <= groupEnd.chunk; c++) {
+            const Chunk& chunk = chunks[c];
+            size_t face = c == groupStart.chunk ? groupStart.face : 0;
+            size_t faceVertex = c == groupStart.chunk ? groupStart.faceVertex : 0;
+            const size_t endFace = c == groupEnd.chunk ? groupEnd.face : chunk.faceSizes.size();
+            for (; face < endFace; faceVertex += chunk.faceSizes[face++], numFaces++)
+                appendFace(shape.mesh, &chunk.faceVertices[faceVertex], chunk.faceSizes[face], numPositions, attrib.vertices, material);
+        }
+        groupStart = groupEnd;
+        return numFaces;
+    };
+
+    std::map<std::string, int> materialMap;
+    tinyobj::shape_t shape;
+    for (size_t c = 0; c < chunks.size(); c++) {
+        for (const Event& event : chunks[c].events) {
+            const Cursor cursor { c, event.face, event.faceVertex };
+            const size_t numPositions = positionOffsets[c] + event.numPositions;
+            switch (event.type) {
+            case EventType::UseMaterial: {
+                const auto iter = materialMap.find(event.argument);
+                const int newMaterial = iter != std::end(materialMap) ? iter->second : -1;
+                if (newMaterial != material) {
+                    flushGroup(cursor, numPositions, shape);
+                    material = newMaterial;
+                }
+            } break;
+            case EventType::MaterialLibrary: {
+                loadMaterialLibrary(event.argument, file, materials, materialMap);
+            } break;
+            case EventType::Group: {
+                flushGroup(cursor, numPositions, shape);
+                if (!shape.mesh.indices.empty())
+                    shapes.push_back(std::move(shape));
+                shape = {};
+            } break;
+            };
+        }
+    }
+
+    const Chunk& lastChunk = chunks.back();
+    if (flushGroup({ chunks.size() - 1, lastChunk.faceSizes.size(), lastChunk.faceVertices.size() }, attrib.vertices.size() / 3, shape) > 0 || !shape.mesh.indices.empty())
+        shapes.push_back(std::move(shape));
+}
+
+// ======== PARSERS =========
+bool parseObjParallel(const std::filesystem::path& file, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes,
+    std::vector<tinyobj::material_t>& materials, unsigned numThreads)
+{
+    const MappedFile mappedFile { file };
+    const std::span<const std::byte> data = mappedFile.data();
+    const char* pBegin = reinterpret_cast<const char*>(data.data());
+
+    if (numThreads == 0)
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<Chunk> chunks(std::clamp<size_t>(data.size() / minChunkSize, 1, numThreads));
+    if (!parseChunks(pBegin, pBegin + data.size(), chunks))
+        return false;
+
+    mergeChunks(chunks, file, attrib, shapes, materials);
+    return true;
+}
+
+void parseObjStreaming(const std::filesystem::path& file, size_t batchSize, tinyobj::attrib_t& attrib,
+    std::vector<tinyobj::material_t>& materials, const ObjStreamCallbacks& callbacks, unsigned numThreads)
+{
+    const MappedFile mappedFile { file };
+    const std::span<const std::byte> data = mappedFile.data();
+    const char* pBegin = reinterpret_cast<const char*>(data.data());
+    const char* pEnd = pBegin + data.size();
+
+    std::map<std::string, int> materialMap;
+    int material = -1;
+    tinyobj::mesh_t run; // Triangulated faces of the current group and material within the current chunk
+    const auto emitRun = [&]() {
+        if (!run.indices.empty())
+            callbacks.onTriangles(run.indices, material);
+        run.indices.clear();
+        run.num_face_vertices.clear();
+        run.material_ids.clear();
+    };
+    const auto appendFaces = [&](const Chunk& chunk, size_t& face, size_t& faceVertex, size_t endFace) {
+        const size_t numPositions = attrib.vertices.size() / 3;
+        for (; face < endFace; faceVertex += chunk.faceSizes[face++]) {
+            const FaceVertex* pFaceVertex = &chunk.faceVertices[faceVertex];
+            // The triangles that were passed on cannot be dropped afterwards, so faces may only use vertices read before
+            if (std::any_of(pFaceVertex, pFaceVertex + chunk.faceSizes[face], [&](const FaceVertex& vertex) { return static_cast<size_t>(vertex.position) >= numPositions; }))
+                throw std::runtime_error(fmt::format("{} references a vertex before it is defined", file.string()));
+            appendFace(run, pFaceVertex, chunk.faceSizes[face], numPositions, attrib.vertices, material);
+        }
+    };
+
+    // Parse a batch of chunks in parallel, then replay them in order and release them before parsing the next batch
+    if (numThreads == 0)
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    batchSize = std::max(batchSize, size_t(1));
+    for (const char* pBatch = pBegin; pBatch != pEnd;) {
+        const size_t size = std::min(static_cast<size_t>(pEnd - pBatch), batchSize);
+        const char* pLineEnd = static_cast<const char*>(std::memchr(pBatch + size - 1, '\n', static_cast<size_t>(pEnd - pBatch) - size + 1));
+        const char* pBatchEnd = pLineEnd ? pLineEnd + 1 : pEnd;
+
+        std::vector<Chunk> chunks(std::clamp<size_t>(size / minChunkSize, 1, numThreads));
+        if (!parseChunks(pBatch, pBatchEnd, chunks))
+            throw std::runtime_error(fmt::format("{} uses OBJ features that cannot be streamed", file.string()));
+
+        for (Chunk& chunk : chunks) {
+            appendVertices(chunk, attrib);
+            size_t face = 0, faceVertex = 0;
+            for (const Event& event : chunk.events) {
+                appendFaces(chunk, face, faceVertex, event.face);
+                switch (event.type) {
+                case EventType::UseMaterial: {
+                    const auto iter = materialMap.find(event.argument);
+                    const int newMaterial = iter != std::end(materialMap) ? iter->second : -1;
+                    if (newMaterial != material) {
+                        emitRun();
+                        callbacks.onRunEnd();
+                        material = newMaterial;
+                    }
+                } break;
+                case EventType::MaterialLibrary: {
+                    loadMaterialLibrary(event.argument, file, materials, materialMap);
+                } break;
+                case EventType::Group: {
+                    emitRun();
+                    callbacks.onRunEnd();
+                } break;
+                };
+            }
+            appendFaces(chunk, face, faceVertex, chunk.faceSizes.size());
+            emitRun();
+        }
+
+        mappedFile.evict(static_cast<size_t>(pBatch - pBegin), static_cast<size_t>(pBatchEnd - pBatch));
+        pBatch = pBatchEnd;
+    }
+    callbacks.onRunEnd();
+}
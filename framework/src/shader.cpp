@@ -2,7 +2,9 @@
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
 #include <fmt/format.h>
+#include <glm/gtc/type_ptr.hpp>
 DISABLE_WARNINGS_POP()
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <iostream>
@@ -18,6 +20,7 @@ static std::string readFile(std::filesystem::path filePath);
 Shader::Shader(GLuint program)
     : m_program(program)
 {
+    reflectUniforms();
 }
 
 Shader::Shader()
@@ -28,6 +31,8 @@ Shader::Shader()
 Shader::Shader(Shader&& other)
 {
     m_program = other.m_program;
+    m_uniformLocations = std::move(other.m_uniformLocations);
+    m_uniformBlockIndices = std::move(other.m_uniformBlockIndices);
     other.m_program = invalid;
 }
 
@@ -43,6 +48,8 @@ Shader& Shader::operator=(Shader&& other)
         glDeleteProgram(m_program);
 
     m_program = other.m_program;
+    m_uniformLocations = std::move(other.m_uniformLocations);
+    m_uniformBlockIndices = std::move(other.m_uniformBlockIndices);
     other.m_program = invalid;
     return *this;
 }
@@ -53,17 +60,47 @@ void Shader::bind() const
     glUseProgram(m_program);
 }
 
-void Shader::bindUniformBlock(const std::string& blockName, GLuint bindingLocation, GLuint uniformBlockBuffer) const
+// Release builds only keep the hash of a name.
+static std::string describe(UniformId id)
 {
-    GLuint blockIdx = glGetUniformBlockIndex(m_program, blockName.data());
+#ifndef NDEBUG
+    if (!id.debugName.empty())
+        return std::string(id.debugName);
+#endif
+    return fmt::format("with hash {:#010x}", id.hash);
+}
+
+void Shader::bindUniformBlock(UniformId blockName, GLuint bindingLocation, GLuint uniformBlockBuffer) const
+{
+    GLuint blockIdx = getUniformBlockIndex(blockName);
     if (blockIdx != GL_INVALID_INDEX) {
         glUniformBlockBinding(m_program, blockIdx, bindingLocation);
         glBindBufferBase(GL_UNIFORM_BUFFER, bindingLocation, uniformBlockBuffer);
     } else {
-        std::cout << "Could not bind uniform block " << blockName << " invalid name" << std::endl;
+        std::cout << "Could not bind uniform block " << describe(blockName) << " invalid name" << std::endl;
+    }
+}
+
+void Shader::bindUniformBlock(UniformId blockName, GLuint bindingLocation, GLuint uniformBlockBuffer, GLintptr offset, GLsizeiptr size) const
+{
+    GLuint blockIdx = getUniformBlockIndex(blockName);
+    if (blockIdx != GL_INVALID_INDEX) {
+        glUniformBlockBinding(m_program, blockIdx, bindingLocation);
+        glBindBufferRange(GL_UNIFORM_BUFFER, bindingLocation, uniformBlockBuffer, offset, size);
+    } else {
+        std::cout << "Could not bind uniform block " << describe(blockName) << " invalid name" << std::endl;
     }
 }
 
+GLuint Shader::getUniformBlockIndex(UniformId blockName) const
+{
+    auto iter = std::lower_bound(std::begin(m_uniformBlockIndices), std::end(m_uniformBlockIndices), blockName.hash,
+        [](const std::pair<uint32_t, GLuint>& entry, uint32_t hash) { return entry.first < hash; });
+    if (iter == std::end(m_uniformBlockIndices) || iter->first != blockName.hash)
+        return GL_INVALID_INDEX;
+    return iter->second;
+}
+
 GLuint Shader::getAttributeLocation(const std::string& name) const
 {
     GLuint loc = glGetAttribLocation(m_program, name.c_str());
@@ -73,13 +110,115 @@ GLuint Shader::getAttributeLocation(const std::string& name) const
     return loc;
 }
 
-GLint Shader::getUniformLocation(const std::string& name) const
+GLint Shader::getUniformLocation(UniformId name) const
+{
+    // Uniforms that were optimized away are not in the table; glUniform* silently ignores location -1.
+    auto iter = std::lower_bound(std::begin(m_uniformLocations), std::end(m_uniformLocations), name.hash,
+        [](const std::pair<uint32_t, GLint>& entry, uint32_t hash) { return entry.first < hash; });
+    if (iter == std::end(m_uniformLocations) || iter->first != name.hash)
+        return -1;
+    return iter->second;
+}
+
+void Shader::setUniform(GLint location, bool value) const
+{
+    glUniform1i(location, value ? GL_TRUE : GL_FALSE);
+}
+
+void Shader::setUniform(GLint location, int value) const
+{
+    glUniform1i(location, value);
+}
+
+void Shader::setUniform(GLint location, float value) const
+{
+    glUniform1f(location, value);
+}
+
+void Shader::setUniform(GLint location, const glm::vec2& value) const
+{
+    glUniform2fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setUniform(GLint location, const glm::vec3& value) const
 {
-    GLint loc = glGetUniformLocation(m_program, name.c_str());
-    if (loc == GL_INVALID_INDEX) {
-        std::cerr << "Warning : Could not find uniform " << name << std::endl;
+    glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setUniform(GLint location, const glm::vec4& value) const
+{
+    glUniform4fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setUniform(GLint location, const glm::ivec2& value) const
+{
+    glUniform2iv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setUniform(GLint location, const glm::ivec3& value) const
+{
+    glUniform3iv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setUniform(GLint location, const glm::mat3& value) const
+{
+    glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setUniform(GLint location, const glm::mat4& value) const
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::reflectUniforms()
+{
+    // Query every active uniform once so that the render loop never has to call glGetUniformLocation.
+    GLint numUniforms = 0, maxNameLength = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &numUniforms);
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::string name;
+    name.resize(static_cast<size_t>(maxNameLength));
+    for (GLuint i = 0; i < static_cast<GLuint>(numUniforms); i++) {
+        GLsizei nameLength = 0;
+        GLint arraySize = 0;
+        GLenum type;
+        glGetActiveUniform(m_program, i, maxNameLength, &nameLength, &arraySize, &type, name.data());
+        const std::string uniformName = name.substr(0, static_cast<size_t>(nameLength));
+
+        // Members of uniform blocks do not have a location.
+        const GLint location = glGetUniformLocation(m_program, uniformName.c_str());
+        if (location == -1)
+            continue;
+        m_uniformLocations.emplace_back(UniformId(uniformName).hash, location);
+
+        // Arrays of basic types are reported once as "name[0]"; register the bare name and every element.
+        if (uniformName.ends_with("[0]")) {
+            const std::string baseName = uniformName.substr(0, uniformName.size() - 3);
+            m_uniformLocations.emplace_back(UniformId(baseName).hash, location);
+            for (GLint element = 1; element < arraySize; element++) {
+                const std::string elementName = fmt::format("{}[{}]", baseName, element);
+                m_uniformLocations.emplace_back(UniformId(elementName).hash, glGetUniformLocation(m_program, elementName.c_str()));
+            }
+        }
+    }
+
+    GLint numBlocks = 0, maxBlockNameLength = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &numBlocks);
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockNameLength);
+    name.resize(static_cast<size_t>(std::max(maxBlockNameLength, 1)));
+    for (GLuint i = 0; i < static_cast<GLuint>(numBlocks); i++) {
+        GLsizei nameLength = 0;
+        glGetActiveUniformBlockName(m_program, i, maxBlockNameLength, &nameLength, name.data());
+        m_uniformBlockIndices.emplace_back(UniformId(std::string_view(name.data(), static_cast<size_t>(nameLength))).hash, i);
+    }
+
+    std::sort(std::begin(m_uniformLocations), std::end(m_uniformLocations));
+    std::sort(std::begin(m_uniformBlockIndices), std::end(m_uniformBlockIndices));
+    for (size_t i = 1; i < m_uniformLocations.size(); i++) {
+        if (m_uniformLocations[i].first == m_uniformLocations[i - 1].first && m_uniformLocations[i].second != m_uniformLocations[i - 1].second)
+            std::cerr << "Warning : Uniform name hash collision in shader program " << m_program << std::endl;
     }
-    return loc;
 }
 
 ShaderBuilder::~ShaderBuilder()
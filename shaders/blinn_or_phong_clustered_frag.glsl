@@ -0,0 +1,112 @@
+#version 410
+
+// Global variables for lighting calculations
+layout(std140) uniform Material
+{
+    vec3 kd;
+	vec3 ks;
+	float shininess;
+	float transparency;
+};
+
+// Written once per frame by ClusteredLightList, see clustered_lighting.h
+uniform samplerBuffer clusterLightData; // Four texels per light, layout of GPUClusteredLight
+uniform usamplerBuffer clusterLightLists; // (offset, count) into clusterLightIndices for every cluster
+uniform usamplerBuffer clusterLightIndices;
+uniform ivec3 clusterGridSize;
+uniform vec2 clusterTileScale; // Clusters per pixel in x and y
+uniform vec4 clusterDepthPlane; // View-space depth of a world-space position p is dot(plane, vec4(p, 1))
+uniform vec2 clusterSliceScaleBias; // Depth slice of view-space depth d is log(d) * scale + bias
+uniform int directionalLightOffset;
+uniform int numDirectionalLights;
+
+uniform vec3 viewPos;
+uniform bool useBlinnCorrection = true;
+
+uniform bool hasDiffuseMap;
+uniform sampler2D diffuseMap;
+uniform bool hasNormalMap;
+uniform sampler2D normalMap;
+
+// Output for on-screen color
+layout(location = 0) out vec4 outColor;
+
+// Interpolated output data from vertex shader
+in vec3 fragPosition; // World-space position
+in vec3 fragNormal; // World-space normal
+in vec2 fragTexCoord;
+
+float specularRatio(vec3 N, vec3 L, vec3 V)
+{
+    if (useBlinnCorrection){
+        vec3 H = normalize(L + V);
+        return pow(max(dot(N, H), 0.0), shininess);
+    } else {
+        vec3 R = reflect(-L, N);
+        return pow(max(dot(V, R), 0.0), shininess);
+    }
+}
+
+// Point lights are stored as spot lights whose cone covers the whole sphere
+vec3 shadeLight(int lightIdx, vec3 N, vec3 V, vec3 diffuseColor)
+{
+    vec4 positionAndOuterCutoff = texelFetch(clusterLightData, 4 * lightIdx + 0);
+    vec4 directionAndInnerCutoff = texelFetch(clusterLightData, 4 * lightIdx + 1);
+    vec4 diffuseAndLinear = texelFetch(clusterLightData, 4 * lightIdx + 2);
+    vec4 specularAndQuadratic = texelFetch(clusterLightData, 4 * lightIdx + 3);
+
+    vec3 toLight = positionAndOuterCutoff.xyz - fragPosition;
+    float dist = length(toLight);
+    vec3 L = toLight / dist;
+    float att = 1.0 / (1.0 + (diffuseAndLinear.w * dist) + (specularAndQuadratic.w * dist * dist));
+
+    // Soft edges / brightness falloff
+    float theta = dot(L, -directionAndInnerCutoff.xyz);
+    float intensity = clamp((theta - positionAndOuterCutoff.w) / (directionAndInnerCutoff.w - positionAndOuterCutoff.w), 0.0, 1.0);
+
+    return (max(dot(N, L), 0.0) * diffuseColor * diffuseAndLinear.rgb * att * intensity) +
+        (specularRatio(N, L, V) * ks * specularAndQuadratic.rgb * att * intensity);
+}
+
+vec3 shadeDirectionalLight(int lightIdx, vec3 N, vec3 V, vec3 diffuseColor)
+{
+    vec3 L = -texelFetch(clusterLightData, 4 * lightIdx + 1).xyz;
+    vec3 lightDiffuseColor = texelFetch(clusterLightData, 4 * lightIdx + 2).rgb;
+    vec3 lightSpecularColor = texelFetch(clusterLightData, 4 * lightIdx + 3).rgb;
+
+    return (max(dot(N, L), 0.0) * diffuseColor * lightDiffuseColor) +
+        (specularRatio(N, L, V) * ks * lightSpecularColor);
+}
+
+void main()
+{
+    vec3 N = normalize(fragNormal);
+    if (hasNormalMap){
+        N = normalize(texture(normalMap, fragTexCoord).rgb * 2.0 - 1.0);
+    }
+
+    vec3 V = normalize(viewPos - fragPosition);
+    vec3 diffuseColor = hasDiffuseMap ? texture(diffuseMap, fragTexCoord).rgb : kd;
+
+    // Find the cluster of this fragment
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterTileScale), clusterGridSize.xy - 1);
+    float viewDepth = dot(clusterDepthPlane, vec4(fragPosition, 1.0));
+    int slice = clamp(int(log(max(viewDepth, 1e-4)) * clusterSliceScaleBias.x + clusterSliceScaleBias.y), 0, clusterGridSize.z - 1);
+    int cluster = tile.x + clusterGridSize.x * (tile.y + clusterGridSize.y * slice);
+    uvec2 lightList = texelFetch(clusterLightLists, cluster).xy;
+
+    vec3 finalColor = vec3(0);
+
+    // Point and spot lights that overlap the cluster
+    for (uint i = 0u; i < lightList.y; i++){
+        int lightIdx = int(texelFetch(clusterLightIndices, int(lightList.x + i)).x);
+        finalColor += shadeLight(lightIdx, N, V, diffuseColor);
+    }
+
+    // Directional lights affect every cluster
+    for (int i = 0; i < numDirectionalLights; i++){
+        finalColor += shadeDirectionalLight(directionalLightOffset + i, N, V, diffuseColor);
+    }
+
+    outColor = vec4(finalColor, transparency);
+}
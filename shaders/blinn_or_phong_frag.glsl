@@ -15,24 +15,36 @@ layout(std140) uniform Material
 	float transparency;
 };
 
+// Light types that LIGHT_TYPE can be set to
+#define POINT_LIGHT 0
+#define DIRECTIONAL_LIGHT 1
+
+// Member order and padding must match GPUPointLight and GPUDirectionalLight in light.h (std140)
 struct Light {
 #ifdef LIGHT_TYPE
     #if (LIGHT_TYPE == POINT_LIGHT)
     vec3 lightPos;
     float linearAttenuationCoeff;
+    vec3 lightDiffuseColor;
     float quadraticAttenuationCoeff;
+    vec3 lightSpecularColor;
 
     #elif (LIGHT_TYPE == DIRECTIONAL_LIGHT)
     vec3 lightDir;
+    vec3 lightDiffuseColor;
+    vec3 lightSpecularColor;
 
     #endif
 #endif
-    vec3 lightDiffuseColor;
-    vec3 lightSpecularColor;
 };
 
-uniform Light lights[MAX_NUM_LIGHTS];
-uniform int numLights;
+// One batch of lights, written once per frame by LightBuffer
+layout(std140) uniform Lights
+{
+    Light lights[MAX_NUM_LIGHTS];
+    int numLights;
+};
+
 uniform vec3 viewPos;
 uniform bool useBlinnCorrection = true;
 
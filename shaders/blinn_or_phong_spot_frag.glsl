@@ -15,6 +15,7 @@ layout(std140) uniform Material
 	float transparency;
 };
 
+// Member order and padding must match GPUSpotLight in light.h (std140)
 struct Light {
     vec3 lightPos;
     float innerCutoff;
@@ -26,8 +27,13 @@ struct Light {
     vec3 lightSpecularColor;
 };
 
-uniform Light lights[MAX_NUM_LIGHTS];
-uniform int numLights;
+// One batch of lights, written once per frame by LightBuffer
+layout(std140) uniform Lights
+{
+    Light lights[MAX_NUM_LIGHTS];
+    int numLights;
+};
+
 uniform vec3 viewPos;
 uniform bool useBlinnCorrection = true;
 
@@ -0,0 +1,139 @@
+#version 410
+
+//$define_string
+
+#ifndef MAX_NUM_POINT_LIGHTS
+    #define MAX_NUM_POINT_LIGHTS 128
+#endif
+#ifndef MAX_NUM_SPOT_LIGHTS
+    #define MAX_NUM_SPOT_LIGHTS 64
+#endif
+#ifndef MAX_NUM_DIR_LIGHTS
+    #define MAX_NUM_DIR_LIGHTS 4
+#endif
+
+// Global variables for lighting calculations
+layout(std140) uniform Material
+{
+    vec3 kd;
+	vec3 ks;
+	float shininess;
+	float transparency;
+};
+
+// Member order and padding must match GPUPointLight, GPUSpotLight and GPUDirectionalLight in light.h (std140)
+struct PointLight {
+    vec3 lightPos;
+    float linearAttenuationCoeff;
+    vec3 lightDiffuseColor;
+    float quadraticAttenuationCoeff;
+    vec3 lightSpecularColor;
+};
+
+struct SpotLight {
+    vec3 lightPos;
+    float innerCutoff;
+    vec3 lightDir;
+    float outerCutoff;
+    float linearAttenuationCoeff;
+    float quadraticAttenuationCoeff;
+    vec3 lightDiffuseColor;
+    vec3 lightSpecularColor;
+};
+
+struct DirectionalLight {
+    vec3 lightDir;
+    vec3 lightDiffuseColor;
+    vec3 lightSpecularColor;
+};
+
+// All lights of the frame, written once per frame by LightBuffer
+layout(std140) uniform AllLights
+{
+    PointLight pointLights[MAX_NUM_POINT_LIGHTS];
+    SpotLight spotLights[MAX_NUM_SPOT_LIGHTS];
+    DirectionalLight dirLights[MAX_NUM_DIR_LIGHTS];
+    int numPointLights;
+    int numSpotLights;
+    int numDirLights;
+};
+
+uniform vec3 viewPos;
+uniform bool useBlinnCorrection = true;
+
+uniform bool hasDiffuseMap;
+uniform sampler2D diffuseMap;
+uniform bool hasNormalMap;
+uniform sampler2D normalMap;
+
+// Output for on-screen color
+layout(location = 0) out vec4 outColor;
+
+// Interpolated output data from vertex shader
+in vec3 fragPosition; // World-space position
+in vec3 fragNormal; // World-space normal
+in vec2 fragTexCoord;
+
+float specularRatio(vec3 N, vec3 L, vec3 V)
+{
+    if (useBlinnCorrection){
+        vec3 H = normalize(L + V);
+        return pow(max(dot(N, H), 0.0), shininess);
+    } else {
+        vec3 R = reflect(-L, N);
+        return pow(max(dot(V, R), 0.0), shininess);
+    }
+}
+
+float attenuation(float dist, float linearCoeff, float quadraticCoeff)
+{
+    return 1.0 / (1.0 + (linearCoeff * dist) + (quadraticCoeff * dist * dist));
+}
+
+void main()
+{
+    vec3 N = normalize(fragNormal);
+    if (hasNormalMap){
+        N = normalize(texture(normalMap, fragTexCoord).rgb * 2.0 - 1.0);
+    }
+
+    vec3 V = normalize(viewPos - fragPosition);
+    vec3 diffuseColor = hasDiffuseMap ? texture(diffuseMap, fragTexCoord).rgb : kd;
+
+    vec3 finalColor = vec3(0);
+
+    // Point lights calculation
+    for (int i = 0; i < numPointLights && i < MAX_NUM_POINT_LIGHTS; i++){
+        PointLight lt = pointLights[i];
+        vec3 L = normalize(lt.lightPos - fragPosition);
+        float att = attenuation(length(lt.lightPos - fragPosition), lt.linearAttenuationCoeff, lt.quadraticAttenuationCoeff);
+
+        finalColor += (max(dot(N, L), 0.0) * diffuseColor * lt.lightDiffuseColor * att) +
+            (specularRatio(N, L, V) * ks * lt.lightSpecularColor * att);
+    }
+
+    // Spot lights calculation
+    for (int i = 0; i < numSpotLights && i < MAX_NUM_SPOT_LIGHTS; i++){
+        SpotLight lt = spotLights[i];
+        vec3 L = normalize(lt.lightPos - fragPosition);
+        float att = attenuation(length(lt.lightPos - fragPosition), lt.linearAttenuationCoeff, lt.quadraticAttenuationCoeff);
+
+        // Soft edges / brightness falloff
+        float theta = dot(L, normalize(-lt.lightDir));
+        float intensity = clamp((theta - lt.outerCutoff) / (lt.innerCutoff - lt.outerCutoff), 0.0, 1.0);
+
+        finalColor += (max(dot(N, L), 0.0) * diffuseColor * lt.lightDiffuseColor * att * intensity) +
+            (specularRatio(N, L, V) * ks * lt.lightSpecularColor * att * intensity);
+    }
+
+    // Directional lights calculation
+    for (int i = 0; i < numDirLights && i < MAX_NUM_DIR_LIGHTS; i++){
+        DirectionalLight lt = dirLights[i];
+        vec3 L = normalize(-lt.lightDir);
+
+        finalColor += (max(dot(N, L), 0.0) * diffuseColor * lt.lightDiffuseColor) +
+            (specularRatio(N, L, V) * ks * lt.lightSpecularColor);
+    }
+
+    outColor = vec4(finalColor, transparency);
+}
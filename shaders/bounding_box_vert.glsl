@@ -0,0 +1,14 @@
+#version 410
+
+// Box drawn for occlusion queries, see OcclusionQueries::queryBounds()
+uniform mat4 mvpMatrix;
+uniform vec3 boxLower;
+uniform vec3 boxUpper;
+
+void main()
+{
+    // The 14 vertex triangle strip of a unit cube, generated from the vertex index
+    int strip = 1 << gl_VertexID;
+    vec3 corner = vec3((0x287a & strip) != 0, (0x02af & strip) != 0, (0x31e3 & strip) != 0);
+    gl_Position = mvpMatrix * vec4(mix(boxLower, boxUpper, corner), 1);
+}
@@ -0,0 +1,63 @@
+#version 410
+
+//$define_string
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedo;
+uniform sampler2D gSpecular; // Specular color and shininess
+
+uniform vec3 viewPos;
+uniform bool useBlinnCorrection = true;
+
+flat in vec3 lightPos;
+flat in vec3 lightDir;
+flat in vec3 lightDiffuse;
+flat in vec3 lightSpecular;
+flat in vec4 attenuationAndCutoffs; // Linear and quadratic attenuation, cosine of the inner and outer cutoff angle
+
+// Output for on-screen color, accumulated over all lights with additive blending
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 position = texelFetch(gPosition, pixel, 0);
+    if (position.w == 0.0){
+        discard; // Background
+    }
+
+    vec3 fragPosition = position.xyz;
+    vec3 N = texelFetch(gNormal, pixel, 0).xyz;
+    vec3 diffuseColor = texelFetch(gAlbedo, pixel, 0).rgb;
+    vec4 specular = texelFetch(gSpecular, pixel, 0);
+    vec3 ks = specular.rgb;
+    float shininess = specular.a;
+
+    vec3 V = normalize(viewPos - fragPosition);
+#ifdef DIRECTIONAL_LIGHT
+    vec3 L = normalize(-lightDir);
+    float att = 1.0;
+#else
+    // Point lights are stored as spot lights whose cone covers the whole sphere
+    vec3 L = normalize(lightPos - fragPosition);
+    float dist = length(lightPos - fragPosition);
+    float att = 1.0 / (1.0 + (attenuationAndCutoffs.x * dist) + (attenuationAndCutoffs.y * dist * dist));
+
+    // Soft edges / brightness falloff
+    float theta = dot(L, normalize(-lightDir));
+    att *= clamp((theta - attenuationAndCutoffs.w) / (attenuationAndCutoffs.z - attenuationAndCutoffs.w), 0.0, 1.0);
+#endif
+
+    float specularRatio;
+    if (useBlinnCorrection){
+        vec3 H = normalize(L + V);
+        specularRatio = pow(max(dot(N, H), 0.0), shininess);
+    } else {
+        vec3 R = reflect(-L, N);
+        specularRatio = pow(max(dot(V, R), 0.0), shininess);
+    }
+
+    outColor = vec4((max(dot(N, L), 0.0) * diffuseColor * lightDiffuse * att) +
+        (specularRatio * ks * lightSpecular * att), 1.0);
+}
@@ -0,0 +1,37 @@
+#version 410
+
+//$define_string
+
+uniform mat4 viewProjMatrix;
+
+// Sphere vertex (unused by the full-screen triangle of directional lights)
+layout(location = 0) in vec3 position;
+// Per-instance light, see GPULightVolume in deferred_shading.h
+layout(location = 1) in vec4 lightPositionAndRadius;
+layout(location = 2) in vec3 lightDirection;
+layout(location = 3) in vec3 lightDiffuseColor;
+layout(location = 4) in vec3 lightSpecularColor;
+layout(location = 5) in vec4 lightAttenuationAndCutoffs;
+
+flat out vec3 lightPos;
+flat out vec3 lightDir;
+flat out vec3 lightDiffuse;
+flat out vec3 lightSpecular;
+flat out vec4 attenuationAndCutoffs;
+
+void main()
+{
+#ifdef DIRECTIONAL_LIGHT
+    // One triangle covering the whole screen
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+#else
+    gl_Position = viewProjMatrix * vec4(lightPositionAndRadius.xyz + position * lightPositionAndRadius.w, 1.0);
+#endif
+
+    lightPos = lightPositionAndRadius.xyz;
+    lightDir = lightDirection;
+    lightDiffuse = lightDiffuseColor;
+    lightSpecular = lightSpecularColor;
+    attenuationAndCutoffs = lightAttenuationAndCutoffs;
+}
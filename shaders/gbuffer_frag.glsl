@@ -0,0 +1,39 @@
+#version 410
+
+// Global variables for lighting calculations
+layout(std140) uniform Material
+{
+    vec3 kd;
+	vec3 ks;
+	float shininess;
+	float transparency;
+};
+
+uniform bool hasDiffuseMap;
+uniform sampler2D diffuseMap;
+uniform bool hasNormalMap;
+uniform sampler2D normalMap;
+
+// G-buffer render targets, see GBuffer in deferred_shading.h
+layout(location = 0) out vec4 gPosition;
+layout(location = 1) out vec4 gNormal;
+layout(location = 2) out vec4 gAlbedo;
+layout(location = 3) out vec4 gSpecular; // Specular color and shininess
+
+// Interpolated output data from vertex shader
+in vec3 fragPosition; // World-space position
+in vec3 fragNormal; // World-space normal
+in vec2 fragTexCoord;
+
+void main()
+{
+    vec3 N = normalize(fragNormal);
+    if (hasNormalMap){
+        N = normalize(texture(normalMap, fragTexCoord).rgb * 2.0 - 1.0);
+    }
+
+    gPosition = vec4(fragPosition, 1.0);
+    gNormal = vec4(N, 0.0);
+    gAlbedo = vec4(hasDiffuseMap ? texture(diffuseMap, fragTexCoord).rgb : kd, 1.0);
+    gSpecular = vec4(ks, shininess);
+}
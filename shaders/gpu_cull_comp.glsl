@@ -0,0 +1,66 @@
+#version 450
+
+// Frustum culling of all renderables, see GpuDrivenScene in gpu_driven.h. Every visible renderable appends a draw
+// command to the range of its bucket.
+layout(local_size_x = 64) in;
+
+struct CullObject {
+    vec4 boundingSphere; // Object space
+    uint mesh;
+    uint bucket;
+};
+
+struct CullMesh {
+    uint numIndices;
+    uint firstIndex;
+    int baseVertex;
+    uint padding;
+};
+
+struct DrawElementsIndirectCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer Objects { CullObject objects[]; };
+layout(std430, binding = 1) readonly buffer Meshes { CullMesh meshes[]; };
+// GPUInstanceData (instancing.h) is a mat4 followed by a mat3, tightly packed
+layout(std430, binding = 2) readonly buffer Instances { float instanceData[]; };
+layout(std430, binding = 3) readonly buffer Buckets { uint bucketFirstCommand[]; };
+layout(std430, binding = 4) buffer DrawCounts { uint drawCounts[]; };
+layout(std430, binding = 5) writeonly buffer Commands { DrawElementsIndirectCommand commands[]; };
+
+uniform int numObjects;
+uniform vec4 frustumPlanes[6];
+
+const uint INSTANCE_FLOATS = 25;
+
+void main()
+{
+    const uint objectIdx = gl_GlobalInvocationID.x;
+    if (objectIdx >= uint(numObjects))
+        return;
+
+    const uint base = objectIdx * INSTANCE_FLOATS;
+    mat4 modelMatrix;
+    for (int column = 0; column < 4; column++)
+        modelMatrix[column] = vec4(instanceData[base + 4 * column], instanceData[base + 4 * column + 1], instanceData[base + 4 * column + 2], instanceData[base + 4 * column + 3]);
+
+    // Radius scaled by the largest axis scale, as in CullingBounds::add()
+    const CullObject object = objects[objectIdx];
+    const vec3 center = (modelMatrix * vec4(object.boundingSphere.xyz, 1.0)).xyz;
+    const float maxScale = max(length(modelMatrix[0].xyz), max(length(modelMatrix[1].xyz), length(modelMatrix[2].xyz)));
+    const float radius = object.boundingSphere.w * maxScale;
+    for (int i = 0; i < 6; i++) {
+        if (dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w < -radius)
+            return;
+    }
+
+    const CullMesh mesh = meshes[object.mesh];
+    const uint slot = atomicAdd(drawCounts[object.bucket], 1u);
+    // The base instance selects the matrices of this renderable from the instance attributes
+    commands[bucketFirstCommand[object.bucket] + slot] = DrawElementsIndirectCommand(mesh.numIndices, 1u, mesh.firstIndex, mesh.baseVertex, objectIdx);
+}
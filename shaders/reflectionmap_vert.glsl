@@ -1,18 +1,53 @@
 #version 450
 
+// Computed once per frame for every object by ObjectConstantsBuffer
+layout(std140) uniform ObjectConstants
+{
+    mat4 mvpMatrix;
+    mat4 modelMatrix;
+    mat3 normalModelMatrix;
+};
+
+// Per-instance matrices from InstanceBuffer, used instead of the block above when drawing instanced
+uniform bool instanced = false;
 uniform mat4 viewProjMatrix;
-uniform mat4 modelMatrix;
-uniform mat3 normalModelMatrix;
+layout(location = 3) in mat4 instanceModelMatrix;
+layout(location = 7) in mat3 instanceNormalModelMatrix;
+
+layout (location = 0) in vec3 encodedPosition;
+layout (location = 1) in vec3 encodedNormal;
 
-layout (location = 0) in vec3 pos;
-layout (location = 1) in vec3 normal;
+// Decoding of VertexFormat::Quantized, set per mesh by GPUMesh::bindMaterial(); the defaults decode full floats
+uniform vec3 positionOffset = vec3(0);
+uniform vec3 positionScale = vec3(1);
+uniform bool octahedralNormals = false;
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0)));
+    return normalize(normal);
+}
 
 out vec3 fragNormal;
 out vec3 fragPosition;
 
+// Depth tested with GL_EQUAL against the prepass (shadow_vert.glsl), which computes the position the same way
+invariant gl_Position;
+
 void main()
 {
-    fragNormal = normalize(normalModelMatrix * normal);
-    fragPosition = vec3(modelMatrix * vec4(pos, 1.0));
-    gl_Position = viewProjMatrix * vec4(fragPosition, 1.0);
+    vec3 pos = positionOffset + positionScale * encodedPosition;
+    vec3 normal = octahedralNormals ? decodeOctahedral(encodedNormal.xy / 32767.0) : encodedNormal;
+    if (instanced) {
+        fragNormal = normalize(instanceNormalModelMatrix * normal);
+        vec4 worldPosition = instanceModelMatrix * vec4(pos, 1.0);
+        fragPosition = worldPosition.xyz;
+        gl_Position = viewProjMatrix * worldPosition;
+    } else {
+        fragNormal = normalize(normalModelMatrix * normal);
+        fragPosition = vec3(modelMatrix * vec4(pos, 1.0));
+        gl_Position = mvpMatrix * vec4(pos, 1.0);
+    }
 }  
\ No newline at end of file
@@ -1,24 +1,58 @@
 #version 410
 
-uniform mat4 mvpMatrix;
-uniform mat4 modelMatrix;
-// Normals should be transformed differently than positions:
-// https://paroj.github.io/gltut/Illumination/Tut09%20Normal%20Transformation.html
-uniform mat3 normalModelMatrix;
-
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
+// Computed once per frame for every object by ObjectConstantsBuffer
+layout(std140) uniform ObjectConstants
+{
+    mat4 mvpMatrix;
+    mat4 modelMatrix;
+    // Normals should be transformed differently than positions:
+    // https://paroj.github.io/gltut/Illumination/Tut09%20Normal%20Transformation.html
+    mat3 normalModelMatrix;
+};
+
+// Per-instance matrices from InstanceBuffer, used instead of the block above when drawing instanced
+uniform bool instanced = false;
+uniform mat4 viewProjMatrix;
+layout(location = 3) in mat4 instanceModelMatrix;
+layout(location = 7) in mat3 instanceNormalModelMatrix;
+
+layout(location = 0) in vec3 encodedPosition;
+layout(location = 1) in vec3 encodedNormal;
 layout(location = 2) in vec2 texCoord;
 
+// Decoding of VertexFormat::Quantized, set per mesh by GPUMesh::bindMaterial(); the defaults decode full floats
+uniform vec3 positionOffset = vec3(0);
+uniform vec3 positionScale = vec3(1);
+uniform bool octahedralNormals = false;
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0)));
+    return normalize(normal);
+}
+
 out vec3 fragPosition;
 out vec3 fragNormal;
 out vec2 fragTexCoord;
 
+// Depth tested with GL_EQUAL against the prepass (shadow_vert.glsl), which computes the position the same way
+invariant gl_Position;
+
 void main()
 {
-    gl_Position = mvpMatrix * vec4(position, 1);
-    
-    fragPosition    = (modelMatrix * vec4(position, 1)).xyz;
-    fragNormal      = normalModelMatrix * normal;
+    vec3 position = positionOffset + positionScale * encodedPosition;
+    vec3 normal = octahedralNormals ? decodeOctahedral(encodedNormal.xy / 32767.0) : encodedNormal;
+    if (instanced) {
+        vec4 worldPosition = instanceModelMatrix * vec4(position, 1);
+        fragPosition    = worldPosition.xyz;
+        fragNormal      = instanceNormalModelMatrix * normal;
+        gl_Position     = viewProjMatrix * worldPosition;
+    } else {
+        fragPosition    = (modelMatrix * vec4(position, 1)).xyz;
+        fragNormal      = normalModelMatrix * normal;
+        gl_Position     = mvpMatrix * vec4(position, 1);
+    }
     fragTexCoord    = texCoord;
 }
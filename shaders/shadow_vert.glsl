@@ -1,10 +1,35 @@
 #version 410
 
-uniform mat4 mvpMatrix;
+// Computed once per frame for every object by ObjectConstantsBuffer
+layout(std140) uniform ObjectConstants
+{
+    mat4 mvpMatrix;
+    mat4 modelMatrix;
+    mat3 normalModelMatrix;
+};
+
+// Per-instance matrices from InstanceBuffer, used instead of the block above when drawing instanced
+uniform bool instanced = false;
+uniform mat4 viewProjMatrix;
+layout(location = 3) in mat4 instanceModelMatrix;
+layout(location = 7) in mat3 instanceNormalModelMatrix;
+
+layout(location = 0) in vec3 encodedPosition;
+
+// The lit passes test against the depth of this prepass with GL_EQUAL, so all of them must compute the position alike
+invariant gl_Position;
 
-layout(location = 0) in vec3 position;
+// Decoding of VertexFormat::Quantized, set per mesh by GPUMesh::bindMaterial()
+uniform vec3 positionOffset = vec3(0);
+uniform vec3 positionScale = vec3(1);
 
 void main()
 {
-    gl_Position = mvpMatrix * vec4(position, 1);
+    vec3 position = positionOffset + positionScale * encodedPosition;
+    if (instanced) {
+        vec4 worldPosition = instanceModelMatrix * vec4(position, 1);
+        gl_Position = viewProjMatrix * worldPosition;
+    } else {
+        gl_Position = mvpMatrix * vec4(position, 1);
+    }
 }
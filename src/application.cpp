@@ -2,8 +2,12 @@
 
 #include <framework/image.h>
 
+#include <array>
+#include <cstddef>
+#include <random>
+
 Application::Application()
-    : m_window("Final Project", glm::ivec2(utils::globals::WINDOW_WIDTH, utils::globals::WINDOW_HEIGHT), OpenGLVersion::GL41)
+    : m_window("Final Project", glm::ivec2(utils::globals::WINDOW_WIDTH, utils::globals::WINDOW_HEIGHT), OPENGL_VERSION)
     , m_texture(RESOURCE_ROOT "resources/checkerboard.png")
     , m_firstCamera(&m_window, glm::vec3(0,5,10), glm::vec3(0,0,-1), glm::perspective(glm::radians(80.0f), 1.0f, 0.1f, 50.0f))
     , m_secondCamera(&m_window, glm::vec3(5, 5, 5), glm::vec3(-5, -5, -5), glm::perspective(glm::radians(80.0f), 1.0f, 0.1f, 50.0f))
@@ -34,45 +38,88 @@ Application::Application()
 
 void Application::initMeshes() 
 {
+    // Meshes are optimized for the vertex cache, overdraw and vertex fetch once per file, and mapped from their binary
+    // cache afterwards (see loadMeshCache())
+    const auto openSceneMesh = [&](const std::filesystem::path& filePath) {
+        MeshCache meshCache = loadMeshCache(filePath);
+        m_meshOptimizationReport += meshCache.report();
+        return meshCache;
+    };
+    // A mesh of a single sub-mesh is uploaded straight from the mapping. Merging sub-meshes, building meshlets and
+    // simplifying levels of detail all need a copy
+    const auto copySceneMesh = [](const MeshCache& meshCache) { return mergeMeshes(meshCache.toMeshes()); };
+    const auto uploadSceneMesh = [&](const MeshCache& meshCache) {
+        if (meshCache.subMeshes().size() == 1)
+            return std::make_shared<GPUMesh>(m_meshArena, meshCache.subMeshes()[0]);
+        return std::make_shared<GPUMesh>(m_meshArena, copySceneMesh(meshCache));
+    };
+
+    // Dense meshes get simplified levels of detail with these fractions of their triangles
+    constexpr std::array lodRatios { 0.5f, 0.25f, 0.125f };
+
     // ========= INITIALIZING HIERARCHICAL TRANSFORM MESHES ========
-    // Index 0 - 2 is the hierarchical transform meshes
-    m_renderable.emplace_back(mergeMeshes(loadMesh("resources/sphere.obj")), glm::mat4{ 1.0f },
+    // Index 0 - 2 is the hierarchical transform meshes, which all share one sphere mesh
+    const auto sphereMesh = std::make_shared<GPUMesh>(m_meshArena, copySceneMesh(openSceneMesh("resources/sphere.obj")), true, lodRatios);
+    m_renderable.emplace_back(sphereMesh, glm::mat4{ 1.0f },
         Texture("resources/2k_sun.jpg"), std::nullopt, StateType::Dynamic, DrawingMode::Opaque);
    
-    m_renderable.emplace_back(mergeMeshes(loadMesh("resources/sphere.obj")), glm::mat4{ 1.0f },
+    m_renderable.emplace_back(sphereMesh, glm::mat4{ 1.0f },
         std::nullopt, std::nullopt, StateType::Dynamic, DrawingMode::Opaque);
 
-    m_renderable.emplace_back(mergeMeshes(loadMesh("resources/sphere.obj")), glm::mat4{ 1.0f },
+    m_renderable.emplace_back(sphereMesh, glm::mat4{ 1.0f },
         std::nullopt, std::nullopt, StateType::Dynamic, DrawingMode::Opaque);
 
     // ========= OTHER MESHES =========
-    m_renderable.emplace_back(mergeMeshes(loadMesh("resources/brickwall.obj")), glm::mat4(1.0f), 
+    // The wall and the terrain are large enough to hide other renderables, so they are also used as occluders
+    const MeshCache brickWallMesh = openSceneMesh("resources/brickwall.obj");
+    m_occluders.push_back({ m_renderable.size(), OccluderMesh(brickWallMesh.subMeshes()) });
+    m_renderable.emplace_back(uploadSceneMesh(brickWallMesh), glm::mat4(1.0f), 
         Texture("resources/alley-brick-wall_albedo.png"), Texture("resources/alley-brick-wall_normal-ogl.png"), StateType::Static, DrawingMode::Opaque);
-    m_renderable.emplace_back(mergeMeshes(loadMesh("resources/grassy_terrain.obj")), glm::mat4{1.0f}, 
+    const MeshCache terrainMesh = openSceneMesh("resources/grassy_terrain.obj");
+    m_occluders.push_back({ m_renderable.size(), OccluderMesh(terrainMesh.subMeshes()) });
+    m_renderable.emplace_back(uploadSceneMesh(terrainMesh), glm::mat4{1.0f}, 
         Texture("resources/grass1-albedo3.png"), std::nullopt, StateType::Static, DrawingMode::Opaque);
 
     // Reflective meshes
-    m_renderable.emplace_back(mergeMeshes(loadMesh("resources/dragoon.obj")),
+    m_renderable.emplace_back(std::make_shared<GPUMesh>(m_meshArena, copySceneMesh(openSceneMesh("resources/dragoon.obj")), true, lodRatios),
         glm::translate(glm::mat4{ 1.0f }, { 0, 4, -5 }) * glm::scale(glm::mat4{ 1.0f }, { 3,3,3 }),
         std::nullopt, std::nullopt, StateType::Static, DrawingMode::Reflective);
+
+    m_numSceneRenderables = m_renderable.size();
 }
 
-void Application::initHierarchicalTransform()
+// Replace the generated copies of the sphere mesh by numSphereInstances new ones; used to stress instanced drawing.
+// The instances are laid out in a square grid above the terrain.
+void Application::setNumSphereInstances(size_t numSphereInstances)
 {
-    sun = &m_renderable[0];
-    planet = &m_renderable[1];
-    moon = &m_renderable[2];
+    m_renderable.erase(std::begin(m_renderable) + static_cast<std::ptrdiff_t>(m_numSceneRenderables), std::end(m_renderable));
+    m_gpuDrivenSceneDirty = true;
+    m_sceneBvh.invalidate();
+    m_pickedDrawID.reset();
+    const std::shared_ptr<GPUMesh> sphereMesh = m_renderable[PLANET].mesh;
+
+    constexpr float spacing = 0.6f;
+    const size_t gridSize = static_cast<size_t>(std::ceil(std::sqrt(static_cast<float>(numSphereInstances))));
+    const glm::vec3 gridOrigin { -0.5f * spacing * float(gridSize), 0.3f, -0.5f * spacing * float(gridSize) };
+    for (size_t instance = 0; instance < numSphereInstances; instance++) {
+        const glm::vec3 position = gridOrigin + spacing * glm::vec3(float(instance % gridSize), 0.0f, float(instance / gridSize));
+        m_renderable.emplace_back(sphereMesh, glm::translate(glm::mat4{ 1.0f }, position) * glm::scale(glm::mat4{ 1.0f }, glm::vec3(0.2f)),
+            std::nullopt, std::nullopt, StateType::Static, DrawingMode::Opaque);
+    }
+}
 
+void Application::initHierarchicalTransform()
+{
     m_sunTransform = { glm::translate(glm::mat4{ 1.0f }, { 0,8,0 }) * glm::scale(glm::mat4{1.0f}, {2,2,2}) , nullptr };
-    sun->modelMat = m_sunTransform.getGlobalTransform();
+    m_renderable[SUN].modelMat = m_sunTransform.getGlobalTransform();
 
     // Put planet relative to the sun
     m_planetTransform = { glm::translate(glm::mat4{ 1.0f }, { 0, 0, -4 }) * glm::scale(glm::mat4{1.0f}, {0.5, 0.5, 0.5}) , &m_sunTransform };
-    planet->modelMat = m_planetTransform.getGlobalTransform();
+    m_renderable[PLANET].modelMat = m_planetTransform.getGlobalTransform();
 
     // Put moon relative to the planet
     m_moonTransform = { glm::translate(glm::mat4{ 1.0f }, { 0,2,0 }) * glm::scale(glm::mat4{1.0f}, {0.5, 0.5, 0.5}) , &m_planetTransform };
-    moon->modelMat = m_moonTransform.getGlobalTransform();
+    m_renderable[MOON].modelMat = m_moonTransform.getGlobalTransform();
 }
 
 void Application::initLights()
@@ -85,8 +132,34 @@ void Application::initLights()
     m_pointLights.emplace_back(glm::vec3(3, 2, -4), glm::vec3(0.6,0.6,0), glm::vec3(1, 1, 0), 50);
     m_pointLights.emplace_back(glm::vec3(-3, 2, -4), glm::vec3(0.2, 0.7, 0.7), glm::vec3(0.7, 1, 1), 50);
 
-    // Spot lights
+    // ======== INITIALIZING INACTIVE CAMERA SPOT LIGHT =============
+    // Index 0 is always the spot light attached to the inactive camera, see updateInactiveCameraLight()
+    m_spotLights.emplace_back(glm::vec3(0), glm::vec3(0, 0, -1), glm::radians(12.5f), glm::radians(17.5f),
+        utils::globals::inactiveCameraColor, utils::globals::inactiveCameraColor, 32);
+    updateInactiveCameraLight();
+
+    // (Other) spot lights
     m_spotLights.emplace_back(glm::vec3(0,2, 4), glm::vec3(0,-1,-3), glm::radians(12.5f), glm::radians(17.5f), glm::vec3(0.8, 0.8, 0.8), glm::vec3(1, 1, 1), 50);
+
+    m_numScenePointLights = m_pointLights.size();
+}
+
+// Add generated point lights (or remove them again) until there are numPointLights in total; used to stress the render paths
+void Application::setNumPointLights(size_t numPointLights)
+{
+    numPointLights = std::max(numPointLights, m_numScenePointLights);
+    if (numPointLights <= m_pointLights.size()) {
+        m_pointLights.erase(std::begin(m_pointLights) + static_cast<std::ptrdiff_t>(numPointLights), std::end(m_pointLights));
+        return;
+    }
+
+    // Seeded by the light index so the same lights come back every time
+    while (m_pointLights.size() < numPointLights) {
+        std::minstd_rand rng(static_cast<unsigned>(m_pointLights.size()));
+        std::uniform_real_distribution<float> position(-10.0f, 10.0f), height(0.5f, 3.0f), color(0.1f, 1.0f);
+        const glm::vec3 lightColor { color(rng), color(rng), color(rng) };
+        m_pointLights.emplace_back(glm::vec3(position(rng), height(rng), position(rng)), lightColor, lightColor, 7.0f);
+    }
 }
 
 void Application::initShaders()
@@ -125,6 +198,34 @@ void Application::initShaders()
                 "#define LIGHT_TYPE SPOT_LIGHT\n#define MAX_NUM_LIGHTS " + std::to_string(utils::globals::shader_preprocessor_params::MAX_NUM_SPOT_LIGHT)).
             build();
 
+        m_blinnOrPhongUberShader = ShaderBuilder().
+            addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/shader_vert.glsl").
+            addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/blinn_or_phong_uber_frag.glsl",
+                "#define MAX_NUM_POINT_LIGHTS " + std::to_string(utils::globals::shader_preprocessor_params::MAX_NUM_UBER_POINT_LIGHT) +
+                "\n#define MAX_NUM_SPOT_LIGHTS " + std::to_string(utils::globals::shader_preprocessor_params::MAX_NUM_UBER_SPOT_LIGHT) +
+                "\n#define MAX_NUM_DIR_LIGHTS " + std::to_string(utils::globals::shader_preprocessor_params::MAX_NUM_UBER_DIR_LIGHT)).
+            build();
+
+        m_blinnOrPhongClusteredShader = ShaderBuilder().
+            addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/shader_vert.glsl").
+            addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/blinn_or_phong_clustered_frag.glsl").
+            build();
+
+        m_gBufferShader = ShaderBuilder().
+            addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/shader_vert.glsl").
+            addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/gbuffer_frag.glsl").
+            build();
+
+        m_deferredLightShader = ShaderBuilder().
+            addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/deferred_light_vert.glsl").
+            addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/deferred_light_frag.glsl").
+            build();
+
+        m_deferredDirLightShader = ShaderBuilder().
+            addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/deferred_light_vert.glsl", "#define DIRECTIONAL_LIGHT").
+            addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/deferred_light_frag.glsl", "#define DIRECTIONAL_LIGHT").
+            build();
+
         m_bezierPathShader = ShaderBuilder().
             addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/bezier_curve_vert.glsl").
             addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/bezier_curve_frag.glsl").
@@ -135,6 +236,18 @@ void Application::initShaders()
             addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/reflectionmap_frag.glsl").
             build();
 
+        m_boundingBoxShader = ShaderBuilder().
+            addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/bounding_box_vert.glsl").
+            addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/shadow_frag.glsl").
+            build();
+
+        // Compute shaders require OpenGL 4.3
+        if constexpr (OPENGL_VERSION == OpenGLVersion::GL45) {
+            m_gpuCullShader = ShaderBuilder().
+                addStage(GL_COMPUTE_SHADER, RESOURCE_ROOT "shaders/gpu_cull_comp.glsl").
+                build();
+        }
+
     }
     catch (ShaderLoadingException e) {
         std::cerr << e.what() << std::endl;
@@ -239,12 +352,12 @@ void Application::drawSkybox()
     m_skyboxShader.bind();
     const glm::mat4 untranslatedViewMatrix = glm::mat4(glm::mat3(activeCamera.viewMatrix()));
     const glm::mat4 skyboxMatrix = activeCamera.projectionMatrix() * untranslatedViewMatrix;
-    glUniformMatrix4fv(m_skyboxShader.getUniformLocation("viewProjMatrix"), 1, GL_FALSE, glm::value_ptr(skyboxMatrix));
+    m_skyboxShader.setUniform("viewProjMatrix", skyboxMatrix);
 
     const int skyboxTexUnit = 0;
     glActiveTexture(GL_TEXTURE0 + skyboxTexUnit);
     glBindTexture(GL_TEXTURE_CUBE_MAP, m_skyboxTex);
-    glUniform1i(m_skyboxShader.getUniformLocation("skybox"), skyboxTexUnit);
+    m_skyboxShader.setUniform("skybox", skyboxTexUnit);
 
     glBindVertexArray(m_skyboxVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
@@ -257,8 +370,8 @@ void Application::drawBezierPath() {
     const glm::mat4 mvpMatrix = activeCamera.viewProjectionMatrix() * glm::mat4(1.0f);
     const glm::vec3 lineColor{ 1,0,0 };
 
-    glUniformMatrix4fv(m_bezierPathShader.getUniformLocation("mvpMatrix"), 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-    glUniform3fv(m_bezierPathShader.getUniformLocation("color"), 1, glm::value_ptr(lineColor));
+    m_bezierPathShader.setUniform("mvpMatrix", mvpMatrix);
+    m_bezierPathShader.setUniform("color", lineColor);
 
     glLineWidth(10.0f); // Driver implementation dependent, only 1.0f is guaranteed by the spec
     glBindVertexArray(m_bezierPathVAO);
@@ -270,227 +383,418 @@ void Application::drawScene()
 {
     Camera& activeCamera = m_firstCameraActive ? m_firstCamera : m_secondCamera;
 
-    // Fill depth buffer, but disable color writes
-    glDepthFunc(GL_LEQUAL); 
-    glDepthMask(GL_TRUE); 
-    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-    m_shadowShader.bind();
-    for (auto& renderable : m_renderable) {
+    // ======== OBJECT CONSTANTS =========
+    // Matrices of every renderable are computed and uploaded once, all passes below index them by draw ID
+    m_objectConstants.update(m_renderable, activeCamera.viewProjectionMatrix());
 
-        if (renderable.drawMode == DrawingMode::Reflective) continue;
+    // Either culling and submission order are computed on the CPU (frustum culling and render queue), or all
+    // renderables are culled on the GPU, which also generates the draw commands (OpenGL 4.5 only)
+    const bool gpuDriven = OPENGL_VERSION == OpenGLVersion::GL45 && utils::globals::gpuDrivenSubmission;
+    const size_t numDirectionalLights = utils::globals::sunlight ? 1 : 0;
 
-        const glm::mat4 modelMatrix = renderable.modelMat;
-        const glm::mat4 mvpMatrix = activeCamera.viewProjectionMatrix() * modelMatrix;
+    // ======== SCENE BVH =========
+    // Rebuilt only when renderables were added or removed, otherwise only the dynamic renderables are refit
+    m_sceneBvh.update(m_renderable, m_objectConstants.modelMatrices());
+
+    if (gpuDriven) {
+        // ======== GPU-DRIVEN CULLING =========
+        if (m_gpuDrivenSceneDirty) {
+            m_gpuDrivenScene.build(m_renderable);
+            m_gpuDrivenSceneDirty = false;
+        }
+        Frustum frustum(activeCamera.viewProjectionMatrix());
+        if (!utils::globals::frustumCulling)
+            frustum.planes.fill(glm::vec4(0, 0, 0, 1)); // Every renderable lies in front of these planes
+        m_gpuDrivenScene.cull(m_gpuCullShader, frustum, m_objectConstants.modelMatrices(), m_objectConstants.normalModelMatrices());
+    } else {
+        // ======== FRUSTUM CULLING =========
+        // Renderables outside of the view frustum are skipped by every pass below. Either the scene BVH is traversed,
+        // or the bounds of all renderables are tested four at a time
+        if (!utils::globals::frustumCulling) {
+            m_visibleRenderables.assign(m_renderable.size(), 1);
+        } else if (utils::globals::sceneBvhCulling) {
+            m_sceneBvh.cull(Frustum(activeCamera.viewProjectionMatrix()), m_visibleRenderables);
+        } else {
+            m_cullingBounds.clear();
+            for (size_t drawID = 0; drawID < m_renderable.size(); drawID++)
+                m_cullingBounds.add(m_renderable[drawID].mesh->bounds(), m_renderable[drawID].mesh->boundingSphere(), m_objectConstants.modelMatrices()[drawID]);
+            m_cullingBounds.cull(Frustum(activeCamera.viewProjectionMatrix()), m_visibleRenderables);
+        }
+
+        // ======== OCCLUSION CULLING =========
+        // Renderables hidden behind the (visible) occluders, as rasterized on the CPU, are skipped as well
+        m_numOccludedRenderables = 0;
+        if (utils::globals::occlusionCulling) {
+            m_occlusionCuller.clear();
+            for (const Occluder& occluder : m_occluders) {
+                if (m_visibleRenderables[occluder.drawID])
+                    m_occlusionCuller.addOccluder(occluder.mesh, m_objectConstants.mvpMatrices()[occluder.drawID]);
+            }
+            m_occlusionCuller.rasterize();
+            for (size_t drawID = 0; drawID < m_renderable.size(); drawID++) {
+                if (m_visibleRenderables[drawID] && !m_occlusionCuller.isVisible(m_renderable[drawID].mesh->bounds(), m_objectConstants.mvpMatrices()[drawID])) {
+                    m_visibleRenderables[drawID] = 0;
+                    m_numOccludedRenderables++;
+                }
+            }
+        }
 
-        glUniformMatrix4fv(m_shadowShader.getUniformLocation("mvpMatrix"), 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-        renderable.mesh.draw(m_shadowShader);
+        // ======== LEVEL OF DETAIL =========
+        // Distant renderables are drawn with a simplified mesh in every pass, as long as its error stays below a pixel
+        const float pixelsPerUnit = 0.5f * float(m_window.getFrameBufferSize().y) * activeCamera.projectionMatrix()[1][1];
+        m_lodSelection.update(m_renderable, m_visibleRenderables, m_objectConstants.modelMatrices(), activeCamera.cameraPos(),
+            pixelsPerUnit, utils::globals::levelOfDetail ? utils::globals::lodErrorPixels : 0.0f);
+
+        // ======== RENDER QUEUE =========
+        // Visible renderables sorted by pass and state, such that consecutive draws share as many binds as possible
+        m_renderQueue.clear();
+        m_textureSetIds.clear();
+        m_meshIds.clear();
+        for (size_t drawID = 0; drawID < m_renderable.size(); drawID++) {
+            if (!m_visibleRenderables[drawID]) continue;
+            const Renderable& renderable = m_renderable[drawID];
+
+            const RenderPass pass = renderable.drawMode == DrawingMode::Reflective ? RenderPass::Reflective : RenderPass::Opaque;
+            const uint32_t textureSet = m_textureSetIds.idOf({
+                renderable.diffuseMap.has_value() && utils::globals::useDiffuseMap ? &renderable.diffuseMap.value() : nullptr,
+                renderable.normalMap.has_value() && utils::globals::useNormalMap ? &renderable.normalMap.value() : nullptr });
+            // Every mesh owns its material, so the mesh id covers both. Levels of detail are separate meshes
+            // for the draw calls, which keeps them out of each other's instanced runs
+            const uint32_t mesh = m_meshIds.idOf({ renderable.mesh.get(), m_lodSelection.level(static_cast<uint32_t>(drawID)) });
+            // Front to back within equal state, which helps early depth testing
+            const float depth = glm::dot(glm::vec3(m_objectConstants.modelMatrices()[drawID][3]) - activeCamera.cameraPos(), activeCamera.cameraForward());
+            // All renderables of a pass share its shader for now
+            m_renderQueue.push(RenderQueue::makeSortKey(pass, 0, textureSet, mesh, depth / MAX_SORT_DEPTH), static_cast<uint32_t>(drawID));
+        }
+        m_renderQueue.sort();
+    }
+    // Code outside of the queue binds programs, vertex arrays and textures between frames
+    m_stateCache.reset();
+    m_stateCache.resetCounters();
+
+    // ======== INSTANCE BUFFER =========
+    // Matrices of all queued draws in queue order, such that every run of draws with equal state is one range
+    const bool useInstancing = utils::globals::useInstancing && !gpuDriven;
+    if (useInstancing)
+        m_instanceBuffer.update(m_renderQueue.items(), m_objectConstants.modelMatrices(), m_objectConstants.normalModelMatrices());
+
+    // ======== MESHLET CULLING =========
+    // Dense closed meshes are drawn per meshlet, skipping the ones that are off-screen or face away from the camera.
+    // Instanced draws share one index stream between all instances, so only runs of a single item are drawn per
+    // meshlet. Meshlets only exist for the full detail level.
+    const bool meshletCulling = utils::globals::meshletCulling && !gpuDriven;
+    if (meshletCulling) {
+        m_fullDetailRenderables.resize(m_renderable.size());
+        for (uint32_t drawID = 0; drawID < m_renderable.size(); drawID++)
+            m_fullDetailRenderables[drawID] = m_visibleRenderables[drawID] && m_lodSelection.level(drawID) == 0;
+        m_meshletCulling.update(m_renderable, m_fullDetailRenderables, m_objectConstants.modelMatrices(), m_objectConstants.mvpMatrices(), activeCamera.cameraPos());
     }
 
-    // Enable color write and set depth test function to also check for equal depth
-    glDepthFunc(GL_EQUAL);
-    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-    glEnable(GL_BLEND); // Blending for multiple lights
-    glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ONE, GL_ZERO);
-    
-    // Each light type (point, spot, directional) has its own shader
-    // Each shader can handle a certain maximum number of lights defined in "utils.h"
-    // Iterating through mesh first (i.e. outer for-loop) will introduce many state changes (shader program binding)
-    // To minimize state changes, we iterate through each light type first
-
-    // ======== POINT LIGHT =========
-    const int& maxPointLight = utils::globals::shader_preprocessor_params::MAX_NUM_POINT_LIGHT;
-    m_blinnOrPhongPointLightShader.bind();
-    for (int idx = 0; idx < m_pointLights.size(); idx += maxPointLight) {
-        for (auto& renderable : m_renderable) {
-
-            if (renderable.drawMode == DrawingMode::Reflective) continue;
-
-            // ======= MESH UNIFORMS =========
-            const glm::mat4 modelMatrix = renderable.modelMat;
-            const glm::mat4 mvpMatrix = activeCamera.viewProjectionMatrix() * modelMatrix;
-            const glm::mat3 normalModelMatrix = glm::inverseTranspose(glm::mat3(modelMatrix));
-            glUniformMatrix4fv(m_blinnOrPhongPointLightShader.getUniformLocation("mvpMatrix"), 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-            glUniformMatrix4fv(m_blinnOrPhongPointLightShader.getUniformLocation("modelMatrix"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-            glUniformMatrix3fv(m_blinnOrPhongPointLightShader.getUniformLocation("normalModelMatrix"), 1, GL_FALSE, glm::value_ptr(normalModelMatrix));
-            glUniform3fv(m_blinnOrPhongPointLightShader.getUniformLocation("viewPos"), 1, glm::value_ptr(activeCamera.cameraPos()));
-            glUniform1i(m_blinnOrPhongPointLightShader.getUniformLocation("useBlinnCorrection"), utils::globals::useBlinnCorrection);
-            // ======= DIFFUSE MAP AND NORMAL MAP UNIFORMS ========
-            if (renderable.diffuseMap.has_value() && utils::globals::useDiffuseMap) {
-                glUniform1i(m_blinnOrPhongPointLightShader.getUniformLocation("hasDiffuseMap"), GL_TRUE);
-                renderable.diffuseMap.value().bind(GL_TEXTURE0);
-                glUniform1i(m_blinnOrPhongPointLightShader.getUniformLocation("diffuseMap"), 0);
+    // ======== OCCLUSION QUERIES =========
+    // Only the forward paths have a depth prepass to query against
+    const bool occlusionQueries = utils::globals::occlusionQueries && !gpuDriven && utils::globals::currentRenderPath != RenderPath::Deferred;
+    if (occlusionQueries)
+        m_occlusionQueries.beginFrame(m_renderable.size());
+    const auto queryAction = [&](uint32_t drawID) {
+        return occlusionQueries ? m_occlusionQueries.action(drawID) : OcclusionQueries::Action::Draw;
+    };
+
+    // Draws count queue items starting at first, with one instanced draw or (when count is 1) a regular draw
+    const auto drawRun = [&](const Shader& shader, std::span<const DrawItem> items, size_t first, size_t count) {
+        const Renderable& renderable = m_renderable[items[first].drawID];
+        // Runs share their level of detail, which is part of the sort key
+        const uint32_t lod = m_lodSelection.level(items[first].drawID);
+        const size_t firstInstance = static_cast<size_t>(&items[first] - m_renderQueue.items().data());
+        if (meshletCulling && count == 1 && lod == 0 && m_meshletCulling.hasMeshlets(items[first].drawID)) {
+            const std::span<const MeshArena::IndexRange> ranges = m_meshletCulling.visibleRanges(items[first].drawID);
+            if (ranges.empty())
+                return;
+            if (useInstancing) {
+                m_stateCache.drawMeshRanges(*renderable.mesh, m_instanceBuffer, firstInstance, ranges);
             } else {
-                glUniform1i(m_blinnOrPhongPointLightShader.getUniformLocation("hasDiffuseMap"), GL_FALSE);
+                m_objectConstants.bind(shader, items[first].drawID);
+                m_stateCache.drawMeshRanges(*renderable.mesh, ranges);
+            }
+        } else if (useInstancing) {
+            m_stateCache.drawMeshInstanced(*renderable.mesh, m_instanceBuffer, firstInstance, count, lod);
+        } else {
+            m_objectConstants.bind(shader, items[first].drawID);
+            m_stateCache.drawMesh(*renderable.mesh, lod);
+        }
+    };
+
+    // Draws the renderables of a pass with the bound program: one multi-draw indirect call per bucket when GPU-driven,
+    // otherwise one draw per queue item or one instanced draw per run of items that only differ in depth.
+    // bindGroupState(renderable) sets the per-renderable state that is shared by such a bucket or run. Renderables
+    // with an occlusion query action are drawn on their own: queried in the depth prepass, or conditionally after it.
+    // lightBatchOf(drawID) selects the light batch of a queue item, which is bound by bindLightBatch(batch) when it
+    // changes; items without a batch are skipped and runs never span different batches.
+    const auto submitPass = [&](const Shader& shader, RenderPass pass, const auto& bindGroupState, bool depthPrepass,
+                                const auto& lightBatchOf, const auto& bindLightBatch) {
+        shader.setUniform("instanced", useInstancing || gpuDriven);
+        if (useInstancing || gpuDriven)
+            shader.setUniform("viewProjMatrix", activeCamera.viewProjectionMatrix());
+
+        if (gpuDriven) {
+            const std::span<const GpuDrivenScene::Bucket> buckets = m_gpuDrivenScene.buckets();
+            for (size_t bucket = 0; bucket < buckets.size(); bucket++) {
+                if (buckets[bucket].pass != pass) continue;
+                bindGroupState(*buckets[bucket].pRenderable);
+                m_stateCache.drawBucketIndirect(*buckets[bucket].pRenderable->mesh, m_gpuDrivenScene, bucket);
             }
+            return;
+        }
 
-            if (renderable.normalMap.has_value() && utils::globals::useNormalMap) {
-                glUniform1i(m_blinnOrPhongPointLightShader.getUniformLocation("hasNormalMap"), GL_TRUE);
-                renderable.normalMap.value().bind(GL_TEXTURE1);
-                glUniform1i(m_blinnOrPhongPointLightShader.getUniformLocation("normalMap"), 1);
-            } else {
-                glUniform1i(m_blinnOrPhongPointLightShader.getUniformLocation("hasNormalMap"), GL_FALSE);
+        const std::span<const DrawItem> items = m_renderQueue.items(pass);
+        std::optional<uint32_t> boundLightBatch;
+        for (size_t first = 0; first < items.size();) {
+            const uint32_t drawID = items[first].drawID;
+            const std::optional<uint32_t> lightBatch = lightBatchOf(drawID);
+            if (!lightBatch) {
+                first++;
+                continue;
             }
-            // ======== LIGHT UNIFORMS ==========
-            int j = 0;
-            for (; j < maxPointLight && idx + j < m_pointLights.size(); j++) {
-                PointLight& current = m_pointLights[idx + j];
-                glUniform3fv(m_blinnOrPhongPointLightShader.getUniformLocation("lights[" + std::to_string(j) + "].lightPos"), 1, glm::value_ptr(current.position));
-                glUniform1f(m_blinnOrPhongPointLightShader.getUniformLocation("lights[" + std::to_string(j) + "].linearAttenuationCoeff"), current.attenuationCoefficients.x);
-                glUniform1f(m_blinnOrPhongPointLightShader.getUniformLocation("lights[" + std::to_string(j) + "].quadraticAttenuationCoeff"), current.attenuationCoefficients.y);
-                glUniform3fv(m_blinnOrPhongPointLightShader.getUniformLocation("lights[" + std::to_string(j) + "].lightDiffuseColor"), 1, glm::value_ptr(current.diffuseColor));
-                glUniform3fv(m_blinnOrPhongPointLightShader.getUniformLocation("lights[" + std::to_string(j) + "].lightSpecularColor"), 1, glm::value_ptr(current.specularColor));
+            const OcclusionQueries::Action action = queryAction(drawID);
+            size_t count = 1;
+            while (useInstancing && action == OcclusionQueries::Action::Draw && first + count < items.size()
+                && RenderQueue::sameState(items[first], items[first + count]) && queryAction(items[first + count].drawID) == OcclusionQueries::Action::Draw
+                && lightBatchOf(items[first + count].drawID) == lightBatch)
+                count++;
+            if (lightBatch != boundLightBatch) {
+                bindLightBatch(*lightBatch);
+                boundLightBatch = lightBatch;
             }
-            glUniform1i(m_blinnOrPhongPointLightShader.getUniformLocation("numLights"), j);
 
-            renderable.mesh.draw(m_blinnOrPhongPointLightShader);
+            // Hidden renderables are drawn after their bounding boxes were queried against the prepass depth
+            if (depthPrepass && action == OcclusionQueries::Action::QueryBounds) {
+                first += count;
+                continue;
+            }
 
+            bindGroupState(m_renderable[drawID]);
+            if (depthPrepass && action == OcclusionQueries::Action::DrawAndQuery) {
+                m_occlusionQueries.beginQuery(drawID);
+                drawRun(shader, items, first, count);
+                m_occlusionQueries.endQuery();
+            } else if (action == OcclusionQueries::Action::QueryBounds) {
+                m_occlusionQueries.beginConditionalRender(drawID);
+                drawRun(shader, items, first, count);
+                m_occlusionQueries.endConditionalRender(drawID);
+            } else {
+                drawRun(shader, items, first, count);
+            }
+            first += count;
         }
-    }
+    };
+
+    const auto everyItem = [](uint32_t) { return std::optional<uint32_t>(0); };
+    const auto noLightBatch = [](uint32_t) {};
 
-    // ======== SPOT LIGHT =========
-    const int& maxSpotLight = utils::globals::shader_preprocessor_params::MAX_NUM_SPOT_LIGHT;
-    m_blinnOrPhongSpotLightShader.bind();
-    for (int idx = 0; idx < m_spotLights.size(); idx += maxSpotLight) {
-        for (auto& renderable : m_renderable) {
-
-            if (renderable.drawMode == DrawingMode::Reflective) continue;
-
-            // ======= MESH UNIFORMS ========
-            const glm::mat4 modelMatrix = renderable.modelMat;
-            const glm::mat4 mvpMatrix = activeCamera.viewProjectionMatrix() * modelMatrix;
-            const glm::mat3 normalModelMatrix = glm::inverseTranspose(glm::mat3(modelMatrix));
-            glUniformMatrix4fv(m_blinnOrPhongSpotLightShader.getUniformLocation("mvpMatrix"), 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-            glUniformMatrix4fv(m_blinnOrPhongSpotLightShader.getUniformLocation("modelMatrix"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-            glUniformMatrix3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("normalModelMatrix"), 1, GL_FALSE, glm::value_ptr(normalModelMatrix));
-            glUniform3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("viewPos"), 1, glm::value_ptr(activeCamera.cameraPos()));
-            glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("useBlinnCorrection"), utils::globals::useBlinnCorrection);
+    const auto drawLitRenderablesPerLightBatch = [&](const Shader& shader, const auto& lightBatchOf, const auto& bindLightBatch) {
+        m_stateCache.useProgram(shader);
+        shader.setUniform("viewPos", activeCamera.cameraPos());
+        shader.setUniform("useBlinnCorrection", utils::globals::useBlinnCorrection);
+        submitPass(shader, RenderPass::Opaque, [&](const Renderable& renderable) {
             // ======= DIFFUSE MAP AND NORMAL MAP UNIFORMS ========
             if (renderable.diffuseMap.has_value() && utils::globals::useDiffuseMap) {
-                glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("hasDiffuseMap"), GL_TRUE);
-                renderable.diffuseMap.value().bind(GL_TEXTURE0);
-                glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("diffuseMap"), 0);
-            }
-            else {
-                glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("hasDiffuseMap"), GL_FALSE);
+                shader.setUniform("hasDiffuseMap", true);
+                m_stateCache.bindTexture(0, renderable.diffuseMap.value());
+                shader.setUniform("diffuseMap", 0);
+            } else {
+                shader.setUniform("hasDiffuseMap", false);
             }
 
             if (renderable.normalMap.has_value() && utils::globals::useNormalMap) {
-                glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("hasNormalMap"), GL_TRUE);
-                renderable.normalMap.value().bind(GL_TEXTURE1);
-                glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("normalMap"), 1);
+                shader.setUniform("hasNormalMap", true);
+                m_stateCache.bindTexture(1, renderable.normalMap.value());
+                shader.setUniform("normalMap", 1);
+            } else {
+                shader.setUniform("hasNormalMap", false);
             }
-            else {
-                glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("hasNormalMap"), GL_FALSE);
+        }, false, lightBatchOf, bindLightBatch);
+    };
+    const auto drawLitRenderables = [&](const Shader& shader) {
+        drawLitRenderablesPerLightBatch(shader, everyItem, noLightBatch);
+    };
+    const auto noGroupState = [](const Renderable&) {};
+
+    // ======== DEFERRED =========
+    // Geometry is rasterized once into the G-buffer, then every light only shades the pixels inside its volume
+    if (utils::globals::currentRenderPath == RenderPath::Deferred) {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+        m_gBuffer.bindForGeometryPass(m_window.getFrameBufferSize());
+        drawLitRenderables(m_gBufferShader);
+        // Reflective objects, light points and the skybox are drawn forward on top and need the scene depth
+        m_gBuffer.blitDepthToDefaultFramebuffer();
+
+        m_lightVolumes.update(m_pointLights, m_spotLights, std::span<const DirectionalLight>(&m_sunLight, numDirectionalLights));
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND); // Blending for multiple lights
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ONE, GL_ZERO);
+
+        // ======== POINT AND SPOT LIGHT VOLUMES =========
+        // Back faces that lie behind the scene geometry cover exactly the pixels that may be lit, also with the camera
+        // inside the volume. Depth clamping keeps volumes that cross the far plane closed.
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+        glEnable(GL_DEPTH_CLAMP);
+        glDepthFunc(GL_GEQUAL);
+        m_deferredLightShader.bind();
+        m_gBuffer.bindTextures(m_deferredLightShader);
+        m_deferredLightShader.setUniform("viewProjMatrix", activeCamera.viewProjectionMatrix());
+        m_deferredLightShader.setUniform("viewPos", activeCamera.cameraPos());
+        m_deferredLightShader.setUniform("useBlinnCorrection", utils::globals::useBlinnCorrection);
+        m_lightVolumes.drawPointAndSpotLights();
+        glDisable(GL_DEPTH_CLAMP);
+        glCullFace(GL_BACK);
+        glDisable(GL_CULL_FACE);
+
+        // ==== DIRECTIONAL LIGHT SUNLIGHT =====
+        glDisable(GL_DEPTH_TEST);
+        m_deferredDirLightShader.bind();
+        m_gBuffer.bindTextures(m_deferredDirLightShader);
+        m_deferredDirLightShader.setUniform("viewPos", activeCamera.cameraPos());
+        m_deferredDirLightShader.setUniform("useBlinnCorrection", utils::globals::useBlinnCorrection);
+        m_lightVolumes.drawDirectionalLights();
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_TRUE);
+        // The lighting passes bound their own program, vertex arrays and textures
+        m_stateCache.reset();
+    }
+    else {
+        // Fill depth buffer, but disable color writes
+        glDepthFunc(GL_LEQUAL); 
+        glDepthMask(GL_TRUE); 
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        m_stateCache.useProgram(m_shadowShader, VertexStream::Position);
+        submitPass(m_shadowShader, RenderPass::Opaque, noGroupState, true, everyItem, noLightBatch);
+
+        // ======== BOUNDING BOX QUERIES =========
+        // Renderables that were hidden last frame are tested with their bounding box against the depth of the visible
+        // ones, then conditionally drawn into the depth buffer themselves
+        if (occlusionQueries) {
+            const std::span<const DrawItem> opaqueItems = m_renderQueue.items(RenderPass::Opaque);
+            glDepthMask(GL_FALSE);
+            m_stateCache.useProgram(m_boundingBoxShader);
+            for (const DrawItem& item : opaqueItems) {
+                if (queryAction(item.drawID) == OcclusionQueries::Action::QueryBounds)
+                    m_occlusionQueries.queryBounds(m_boundingBoxShader, item.drawID, m_renderable[item.drawID].mesh->bounds(),
+                        m_objectConstants.modelMatrices()[item.drawID], activeCamera.viewProjectionMatrix(), activeCamera.cameraPos());
             }
-            // ======== LIGHT UNIFORMS ==========
-            int j = 0;
-            for (; j < maxSpotLight && idx + j < m_spotLights.size(); j++) {
-                SpotLight& current = m_spotLights[idx + j];
-                glUniform3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[" + std::to_string(j) + "].lightPos"), 1, glm::value_ptr(current.position));
-                glUniform3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[" + std::to_string(j) + "].lightDir"), 1, glm::value_ptr(current.direction));
-                glUniform1f(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[" + std::to_string(j) + "].innerCutoff"), glm::cos(current.innerCutoffAngle));
-                glUniform1f(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[" + std::to_string(j) + "].outerCutoff"), glm::cos(current.outerCutoffAngle));
-                glUniform1f(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[" + std::to_string(j) + "].linearAttenuationCoeff"), current.attenuationCoefficients.x);
-                glUniform1f(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[" + std::to_string(j) + "].quadraticAttenuationCoeff"), current.attenuationCoefficients.y);
-                glUniform3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[" + std::to_string(j) + "].lightDiffuseColor"), 1, glm::value_ptr(current.diffuseColor));
-                glUniform3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[" + std::to_string(j) + "].lightSpecularColor"), 1, glm::value_ptr(current.specularColor));
+            // The queries bound their own vertex array
+            m_stateCache.reset();
+            glDepthMask(GL_TRUE);
+
+            m_stateCache.useProgram(m_shadowShader, VertexStream::Position);
+            for (size_t i = 0; i < opaqueItems.size(); i++) {
+                if (queryAction(opaqueItems[i].drawID) != OcclusionQueries::Action::QueryBounds)
+                    continue;
+                m_occlusionQueries.beginConditionalRender(opaqueItems[i].drawID);
+                drawRun(m_shadowShader, opaqueItems, i, 1);
+                m_occlusionQueries.endConditionalRender(opaqueItems[i].drawID);
             }
-            glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("numLights"), j);
-
-            renderable.mesh.draw(m_blinnOrPhongSpotLightShader);
         }
-    }
 
-    // ===== INACTIVE CAMERA SPOT LIGHT ========
-    for (auto& renderable : m_renderable) {
-
-        if (renderable.drawMode == DrawingMode::Reflective) continue;
-
-        // ======= MESH UNIFORMS =======
-        const glm::mat4 modelMatrix = renderable.modelMat;
-        const glm::mat4 mvpMatrix = activeCamera.viewProjectionMatrix() * modelMatrix;
-        const glm::mat3 normalModelMatrix = glm::inverseTranspose(glm::mat3(modelMatrix));
-        glUniformMatrix4fv(m_blinnOrPhongSpotLightShader.getUniformLocation("mvpMatrix"), 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-        glUniformMatrix4fv(m_blinnOrPhongSpotLightShader.getUniformLocation("modelMatrix"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-        glUniformMatrix3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("normalModelMatrix"), 1, GL_FALSE, glm::value_ptr(normalModelMatrix));
-        glUniform3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("viewPos"), 1, glm::value_ptr(activeCamera.cameraPos()));
-        glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("useBlinnCorrection"), utils::globals::useBlinnCorrection);
-        // ======= DIFFUSE MAP AND NORMAL MAP UNIFORMS ========
-        if (renderable.diffuseMap.has_value() && utils::globals::useDiffuseMap) {
-            glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("hasDiffuseMap"), GL_TRUE);
-            renderable.diffuseMap.value().bind(GL_TEXTURE0);
-            glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("diffuseMap"), 0);
-        }
-        else {
-            glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("hasDiffuseMap"), GL_FALSE);
+        // Enable color write and set depth test function to also check for equal depth
+        glDepthFunc(GL_EQUAL);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glEnable(GL_BLEND); // Blending for multiple lights
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ONE, GL_ZERO);
+    
+        // Each light type (point, spot, directional) has its own shader
+        // Each shader can handle a certain maximum number of lights defined in "utils.h"
+        // Iterating through mesh first (i.e. outer for-loop) will introduce many state changes (shader program binding)
+        // To minimize state changes, we iterate through each light type first
+
+        // ======== LIGHT UNIFORM BUFFER =========
+        // All lights are uploaded once per frame, each pass below only binds the range holding its batch of lights
+        m_lightBuffer.update(m_pointLights, m_spotLights, std::span<const DirectionalLight>(&m_sunLight, numDirectionalLights));
+
+        // ======== SINGLE PASS =========
+        // One shader evaluates all lights, so every renderable is shaded exactly once
+        if (utils::globals::currentRenderPath == RenderPath::SinglePassForward) {
+            glDisable(GL_BLEND);
+            m_stateCache.useProgram(m_blinnOrPhongUberShader);
+            m_lightBuffer.bindAllLights(m_blinnOrPhongUberShader);
+            drawLitRenderables(m_blinnOrPhongUberShader);
         }
-
-        if (renderable.normalMap.has_value() && utils::globals::useNormalMap) {
-            glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("hasNormalMap"), GL_TRUE);
-            renderable.normalMap.value().bind(GL_TEXTURE1);
-            glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("normalMap"), 1);
+        // ======== CLUSTERED =========
+        // Also a single pass, but every fragment only evaluates the lights that overlap its cluster of the view frustum
+        else if (utils::globals::currentRenderPath == RenderPath::ClusteredForward) {
+            glDisable(GL_BLEND);
+            m_clusteredLightList.update(activeCamera.viewMatrix(), activeCamera.projectionMatrix(),
+                m_pointLights, m_spotLights, std::span<const DirectionalLight>(&m_sunLight, numDirectionalLights));
+            m_stateCache.useProgram(m_blinnOrPhongClusteredShader);
+            m_clusteredLightList.bind(m_blinnOrPhongClusteredShader, m_window.getFrameBufferSize());
+            drawLitRenderables(m_blinnOrPhongClusteredShader);
         }
         else {
-            glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("hasNormalMap"), GL_FALSE);
-        }
-        // ======== LIGHT UNIFORMS ==========
-        Camera& InactiveCamera = m_firstCameraActive ? m_secondCamera : m_firstCamera;
-        glUniform3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[0].lightPos"), 1, glm::value_ptr(InactiveCamera.cameraPos()));
-        glUniform3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[0].lightDir"), 1, glm::value_ptr(InactiveCamera.cameraForward()));
-        glUniform1f(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[0].innerCutoff"), glm::cos(glm::radians(12.5f)));
-        glUniform1f(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[0].outerCutoff"), glm::cos(glm::radians(17.5f)));
-        glUniform1f(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[0].linearAttenuationCoeff"), 0.14);
-        glUniform1f(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[0].quadraticAttenuationCoeff"), 0.07);
-        glUniform3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[0].lightDiffuseColor"), 1, glm::value_ptr(utils::globals::inactiveCameraColor));
-        glUniform3fv(m_blinnOrPhongSpotLightShader.getUniformLocation("lights[0].lightSpecularColor"), 1, glm::value_ptr(utils::globals::inactiveCameraColor));
-        glUniform1i(m_blinnOrPhongSpotLightShader.getUniformLocation("numLights"), 1);
-
-        renderable.mesh.draw(m_blinnOrPhongSpotLightShader);
-    }
-
-    // ==== DIRECTIONAL LIGHT SUNLIGHT =====
-    if (utils::globals::sunlight)
-    {
-        m_blinnOrPhongDirLightShader.bind();
-        for (auto& renderable : m_renderable) {
-
-            if (renderable.drawMode == DrawingMode::Reflective) continue;
-
-            // ======= MESH UNIFORMS =======
-            const glm::mat4 modelMatrix = renderable.modelMat;
-            const glm::mat4 mvpMatrix = activeCamera.viewProjectionMatrix() * modelMatrix;
-            const glm::mat3 normalModelMatrix = glm::inverseTranspose(glm::mat3(modelMatrix));
-            glUniformMatrix4fv(m_blinnOrPhongDirLightShader.getUniformLocation("mvpMatrix"), 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-            glUniformMatrix4fv(m_blinnOrPhongDirLightShader.getUniformLocation("modelMatrix"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-            glUniformMatrix3fv(m_blinnOrPhongDirLightShader.getUniformLocation("normalModelMatrix"), 1, GL_FALSE, glm::value_ptr(normalModelMatrix));
-            glUniform3fv(m_blinnOrPhongDirLightShader.getUniformLocation("viewPos"), 1, glm::value_ptr(activeCamera.cameraPos()));
-            glUniform1i(m_blinnOrPhongDirLightShader.getUniformLocation("useBlinnCorrection"), utils::globals::useBlinnCorrection);
-
-            // ======= DIFFUSE MAP AND NORMAL MAP UNIFORMS ========
-            if (renderable.diffuseMap.has_value() && utils::globals::useDiffuseMap) {
-                glUniform1i(m_blinnOrPhongDirLightShader.getUniformLocation("hasDiffuseMap"), GL_TRUE);
-                renderable.diffuseMap.value().bind(GL_TEXTURE0);
-                glUniform1i(m_blinnOrPhongDirLightShader.getUniformLocation("diffuseMap"), 0);
+            // ======== PER-OBJECT LIGHT LISTS =========
+            // Every renderable is only shaded by the point and spot lights that reach its bounds, so the number of
+            // passes depends on the local rather than the global number of lights
+            const bool objectLightLists = utils::globals::objectLightLists && !gpuDriven;
+            if (objectLightLists)
+                m_objectLightLists.update(m_sceneBvh, m_renderable.size(), m_pointLights, m_spotLights);
+
+            // ======== LIGHT SCISSOR AND DEPTH BOUNDS =========
+            // Every batch of point or spot lights only shades the pixels inside the screen rectangle (and depth range)
+            // of its lights
+            const bool lightClipping = utils::globals::lightClipping;
+            if (lightClipping) {
+                m_lightClipping.update(activeCamera.viewMatrix(), activeCamera.projectionMatrix(), m_window.getFrameBufferSize(), m_pointLights, m_spotLights);
+                m_lightClipping.begin();
             }
-            else {
-                glUniform1i(m_blinnOrPhongDirLightShader.getUniformLocation("hasDiffuseMap"), GL_FALSE);
+
+            const auto drawLightListPass = [&](const Shader& shader, LightType type, size_t pass) {
+                drawLitRenderablesPerLightBatch(shader,
+                    [&](uint32_t drawID) { return m_objectLightLists.batchOf(type, drawID, pass); },
+                    [&](uint32_t batch) {
+                        m_objectLightLists.bindBatch(shader, type, batch);
+                        if (lightClipping)
+                            m_lightClipping.clipTo(type, m_objectLightLists.lightsOf(type, batch));
+                    });
+            };
+
+            // ======== POINT LIGHT =========
+            m_stateCache.useProgram(m_blinnOrPhongPointLightShader);
+            if (objectLightLists) {
+                for (size_t pass = 0; pass < m_objectLightLists.numPasses(LightType::Point); pass++)
+                    drawLightListPass(m_blinnOrPhongPointLightShader, LightType::Point, pass);
+            } else {
+                constexpr size_t batchSize = utils::globals::shader_preprocessor_params::MAX_NUM_POINT_LIGHT;
+                for (size_t batch = 0; batch < m_lightBuffer.numPointLightBatches(); batch++) {
+                    m_lightBuffer.bindPointLightBatch(m_blinnOrPhongPointLightShader, batch);
+                    if (lightClipping)
+                        m_lightClipping.clipTo(LightType::Point, batch * batchSize, std::min(batchSize, m_pointLights.size() - batch * batchSize));
+                    drawLitRenderables(m_blinnOrPhongPointLightShader);
+                }
             }
 
-            if (renderable.normalMap.has_value() && utils::globals::useNormalMap) {
-                glUniform1i(m_blinnOrPhongDirLightShader.getUniformLocation("hasNormalMap"), GL_TRUE);
-                renderable.normalMap.value().bind(GL_TEXTURE1);
-                glUniform1i(m_blinnOrPhongDirLightShader.getUniformLocation("normalMap"), 1);
+            // ======== SPOT LIGHT (INCLUDING INACTIVE CAMERA SPOT LIGHT) =========
+            m_stateCache.useProgram(m_blinnOrPhongSpotLightShader);
+            if (objectLightLists) {
+                for (size_t pass = 0; pass < m_objectLightLists.numPasses(LightType::Spot); pass++)
+                    drawLightListPass(m_blinnOrPhongSpotLightShader, LightType::Spot, pass);
+            } else {
+                constexpr size_t batchSize = utils::globals::shader_preprocessor_params::MAX_NUM_SPOT_LIGHT;
+                for (size_t batch = 0; batch < m_lightBuffer.numSpotLightBatches(); batch++) {
+                    m_lightBuffer.bindSpotLightBatch(m_blinnOrPhongSpotLightShader, batch);
+                    if (lightClipping)
+                        m_lightClipping.clipTo(LightType::Spot, batch * batchSize, std::min(batchSize, m_spotLights.size() - batch * batchSize));
+                    drawLitRenderables(m_blinnOrPhongSpotLightShader);
+                }
             }
-            else {
-                glUniform1i(m_blinnOrPhongDirLightShader.getUniformLocation("hasNormalMap"), GL_FALSE);
+            // The directional light covers the whole screen
+            if (lightClipping)
+                m_lightClipping.end();
+
+            // ==== DIRECTIONAL LIGHT SUNLIGHT =====
+            m_stateCache.useProgram(m_blinnOrPhongDirLightShader);
+            for (size_t batch = 0; batch < m_lightBuffer.numDirectionalLightBatches(); batch++) {
+                m_lightBuffer.bindDirectionalLightBatch(m_blinnOrPhongDirLightShader, batch);
+                drawLitRenderables(m_blinnOrPhongDirLightShader);
             }
-            // ======== LIGHT UNIFORMS ==========
-            glUniform3fv(m_blinnOrPhongDirLightShader.getUniformLocation("lights[0].lightDir"), 1, glm::value_ptr(m_sunLight.direction));
-            glUniform3fv(m_blinnOrPhongDirLightShader.getUniformLocation("lights[0].lightDiffuseColor"), 1, glm::value_ptr(m_sunLight.diffuseColor));
-            glUniform3fv(m_blinnOrPhongDirLightShader.getUniformLocation("lights[0].lightSpecularColor"), 1, glm::value_ptr(m_sunLight.specularColor));
-            glUniform1i(m_blinnOrPhongDirLightShader.getUniformLocation("numLights"), 1);
-
-            renderable.mesh.draw(m_blinnOrPhongDirLightShader);
         }
     }
 
@@ -498,28 +802,14 @@ void Application::drawScene()
     glDepthFunc(GL_LESS);
 
     // ======== DRAWING REFLECTION MAP ==========
-    m_reflectionMapShader.bind();
-    for (auto& renderable : m_renderable) {
-
-        if (renderable.drawMode != DrawingMode::Reflective) continue;
-
-        // ======== MESH UNIFORMS =========
-        const glm::mat4 modelMatrix = renderable.modelMat;
-        const glm::mat4 mvpMatrix = activeCamera.viewProjectionMatrix() * modelMatrix;
-        const glm::mat3 normalModelMatrix = glm::inverseTranspose(glm::mat3(modelMatrix));
-        glUniformMatrix4fv(m_reflectionMapShader.getUniformLocation("viewProjMatrix"), 1, GL_FALSE, glm::value_ptr(activeCamera.viewProjectionMatrix()));
-        glUniformMatrix4fv(m_reflectionMapShader.getUniformLocation("modelMatrix"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-        glUniformMatrix3fv(m_reflectionMapShader.getUniformLocation("normalModelMatrix"), 1, GL_FALSE, glm::value_ptr(normalModelMatrix));
-
-        // ========= OTHER UNIFORMS ========
-        glUniform3fv(m_reflectionMapShader.getUniformLocation("viewPos"), 1, glm::value_ptr(activeCamera.cameraPos()));
-        const int skyboxTexUnit = 0;
-        glActiveTexture(GL_TEXTURE0 + skyboxTexUnit);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, m_skyboxTex);
-        glUniform1i(m_reflectionMapShader.getUniformLocation("skybox"), skyboxTexUnit);
-
-        renderable.mesh.draw(m_reflectionMapShader);
-    }
+    m_stateCache.useProgram(m_reflectionMapShader);
+    // ========= OTHER UNIFORMS ========
+    m_reflectionMapShader.setUniform("viewPos", activeCamera.cameraPos());
+    const int skyboxTexUnit = 0;
+    glActiveTexture(GL_TEXTURE0 + skyboxTexUnit);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_skyboxTex);
+    m_reflectionMapShader.setUniform("skybox", skyboxTexUnit);
+    submitPass(m_reflectionMapShader, RenderPass::Reflective, noGroupState, false, everyItem, noLightBatch);
 }
 
 void Application::drawLightsAsPoints() 
@@ -530,28 +820,21 @@ void Application::drawLightsAsPoints()
     m_lightShader.bind();
     for (const PointLight& pointLight : m_pointLights) {
         const glm::vec4 screenPos = activeCamera.viewProjectionMatrix() * glm::vec4(pointLight.position, 1.0f);
-        glUniform4fv(m_lightShader.getUniformLocation("pos"), 1, glm::value_ptr(screenPos));
+        m_lightShader.setUniform("pos", screenPos);
         glPointSize(utils::globals::lightPointSize);
-        glUniform3fv(m_lightShader.getUniformLocation("color"), 1, glm::value_ptr(pointLight.specularColor));
+        m_lightShader.setUniform("color", pointLight.specularColor);
         glDrawArrays(GL_POINTS, 0, 1);
     }
 
+    // Includes the inactive camera spot light (index 0)
     for (const SpotLight& spotLight : m_spotLights) {
         const glm::vec4 screenPos = activeCamera.viewProjectionMatrix() * glm::vec4(spotLight.position, 1.0f);
-        glUniform4fv(m_lightShader.getUniformLocation("pos"), 1, glm::value_ptr(screenPos));
+        m_lightShader.setUniform("pos", screenPos);
         glPointSize(utils::globals::lightPointSize);
-        glUniform3fv(m_lightShader.getUniformLocation("color"), 1, glm::value_ptr(spotLight.specularColor));
+        m_lightShader.setUniform("color", spotLight.specularColor);
         glDrawArrays(GL_POINTS, 0, 1);
     }
 
-    { // INACTIVE CAMERA SPOT LIGHT
-        Camera& InactiveCamera = m_firstCameraActive ? m_secondCamera : m_firstCamera;
-        const glm::vec4 screenPos = activeCamera.viewProjectionMatrix() * glm::vec4(InactiveCamera.cameraPos(), 1.0f);
-        glUniform4fv(m_lightShader.getUniformLocation("pos"), 1, glm::value_ptr(screenPos));
-        glPointSize(utils::globals::lightPointSize);
-        glUniform3fv(m_lightShader.getUniformLocation("color"), 1, glm::value_ptr(utils::globals::inactiveCameraColor));
-        glDrawArrays(GL_POINTS, 0, 1);
-    }
 }
 
 void Application::updateBezierLightPosition() 
@@ -576,6 +859,32 @@ void Application::updateBezierLightPosition()
     }
 }
 
+void Application::updateInactiveCameraLight()
+{
+    SpotLight& cameraLight = m_spotLights[0];
+    const Camera& inactiveCamera = m_firstCameraActive ? m_secondCamera : m_firstCamera;
+
+    cameraLight.position = inactiveCamera.cameraPos();
+    cameraLight.direction = inactiveCamera.cameraForward();
+    cameraLight.diffuseColor = utils::globals::inactiveCameraColor;
+    cameraLight.specularColor = utils::globals::inactiveCameraColor;
+}
+
+// Let the generated point lights orbit around the y-axis, each at its own speed
+void Application::updateGeneratedLights()
+{
+    if (utils::globals::pauseGeneratedLights) return;
+
+    for (size_t i = m_numScenePointLights; i < m_pointLights.size(); i++) {
+        const float angle = glm::radians(0.2f + 0.1f * float(i % 8)) * (i % 2 == 0 ? 1.0f : -1.0f);
+        const glm::vec3 position = m_pointLights[i].position;
+        m_pointLights[i].position = glm::vec3(
+            glm::cos(angle) * position.x + glm::sin(angle) * position.z,
+            position.y,
+            -glm::sin(angle) * position.x + glm::cos(angle) * position.z);
+    }
+}
+
 void Application::updateHierarchicalTransform() 
 {
     if (utils::globals::pauseHierarchyTransform) return;
@@ -583,12 +892,15 @@ void Application::updateHierarchicalTransform()
     m_planetTransform.localModelMatrix = glm::rotate(glm::mat4{ 1.0f }, glm::radians(utils::globals::hierarchy_transform::planetOrbitSpeed), {0,1,0}) * m_planetTransform.localModelMatrix;
     m_moonTransform.localModelMatrix = glm::rotate(glm::mat4{ 1.0f }, glm::radians(utils::globals::hierarchy_transform::moonOrbitSpeed), {1,0,0}) * m_moonTransform.localModelMatrix;
 
-    planet->modelMat = m_planetTransform.getGlobalTransform();
-    moon->modelMat = m_moonTransform.getGlobalTransform();
+    m_renderable[PLANET].modelMat = m_planetTransform.getGlobalTransform();
+    m_renderable[MOON].modelMat = m_moonTransform.getGlobalTransform();
 }
 
 void Application::update()
 {
+    // Total number of point lights that the render path benchmark steps through
+    static constexpr std::array benchmarkPointLightCounts { 4, 16, 64, 128, 256, 1024 };
+
     glEnable(GL_DEPTH_TEST);
 
     int dummyInteger = 0; // Initialized to 0
@@ -602,6 +914,8 @@ void Application::update()
         activeCamera.updateInput();
         updateBezierLightPosition();
         updateHierarchicalTransform();
+        updateInactiveCameraLight();
+        updateGeneratedLights();
 
         // Use ImGui for easy input/output of ints, floats, strings, etc...
         ImGui::Begin("Window");
@@ -630,14 +944,118 @@ void Application::update()
         ImGui::Checkbox("Activate sunlight", &utils::globals::sunlight);
         //ImGui::DragFloat3("Sunlight direction", glm::value_ptr(utils::globals::sunlightDirection), 0.01, 0.0, 1, "%.2f");
 
+        ImGui::Separator();
+        ImGui::Text("Culling");
+        ImGui::Checkbox("Frustum culling", &utils::globals::frustumCulling);
+        if (OPENGL_VERSION == OpenGLVersion::GL45)
+            ImGui::Checkbox("GPU-driven culling and submission", &utils::globals::gpuDrivenSubmission);
+        if (OPENGL_VERSION == OpenGLVersion::GL45 && utils::globals::gpuDrivenSubmission)
+            ImGui::Text("Renderables: %zu in %zu buckets", m_renderable.size(), m_gpuDrivenScene.buckets().size());
+        else
+            ImGui::Text("Visible renderables: %d / %zu", static_cast<int>(std::count(std::begin(m_visibleRenderables), std::end(m_visibleRenderables), 1)), m_renderable.size());
+        if (utils::globals::frustumCulling)
+            ImGui::Checkbox("Frustum culling with scene BVH", &utils::globals::sceneBvhCulling);
+        if (m_pickedDrawID)
+            ImGui::Text("Picked renderable (right click): %u", *m_pickedDrawID);
+        else
+            ImGui::Text("Picked renderable (right click): none");
+        ImGui::Checkbox("Occlusion culling (CPU)", &utils::globals::occlusionCulling);
+        if (utils::globals::occlusionCulling)
+            ImGui::Text("Occluded renderables: %zu, occluder triangles: %zu", m_numOccludedRenderables, m_occlusionCuller.numOccluderTriangles());
+        ImGui::Checkbox("Occlusion queries (forward paths)", &utils::globals::occlusionQueries);
+        if (utils::globals::occlusionQueries)
+            ImGui::Text("Hidden by occlusion queries: %zu", m_occlusionQueries.numHidden());
+        const RenderStateCache::Counters& stateCounters = m_stateCache.counters();
+        ImGui::Checkbox("Meshlet culling", &utils::globals::meshletCulling);
+        if (utils::globals::meshletCulling && !utils::globals::gpuDrivenSubmission)
+            ImGui::Text("Meshlets: %zu / %zu, triangles: %zu / %zu", m_meshletCulling.numVisibleMeshlets(), m_meshletCulling.numMeshlets(),
+                m_meshletCulling.numVisibleTriangles(), m_meshletCulling.numTriangles());
+        ImGui::Checkbox("Level of detail (CPU submission)", &utils::globals::levelOfDetail);
+        if (utils::globals::levelOfDetail && !utils::globals::gpuDrivenSubmission) {
+            ImGui::SliderFloat("Max LOD error (pixels)", &utils::globals::lodErrorPixels, 0.1f, 8.0f);
+            ImGui::Text("Triangles at selected LOD: %zu / %zu", m_lodSelection.numTriangles(), m_lodSelection.numFullDetailTriangles());
+        }
+        ImGui::Text("Binds: %u program, %u texture, %u material, %u VAO",
+            stateCounters.programBinds, stateCounters.textureBinds, stateCounters.materialBinds, stateCounters.vertexArrayBinds);
+        ImGui::Text("Redundant binds skipped: %u", stateCounters.skippedBinds);
+        ImGui::Text("Draw calls: %u", stateCounters.drawCalls);
+        ImGui::Checkbox("Instanced drawing", &utils::globals::useInstancing);
+        int numSphereInstances = static_cast<int>(m_renderable.size() - m_numSceneRenderables);
+        if (ImGui::SliderInt("Sphere instances", &numSphereInstances, 0, 20000))
+            setNumSphereInstances(static_cast<size_t>(numSphereInstances));
+        // Sphere instances share the mesh of the planet, so the scene renderables cover all meshes
+        QuantizationError maxQuantizationError;
+        for (size_t drawID = 0; drawID < m_numSceneRenderables; drawID++) {
+            const QuantizationError& error = m_renderable[drawID].mesh->quantizationError();
+            maxQuantizationError.position = std::max(maxQuantizationError.position, error.position);
+            maxQuantizationError.normalDegrees = std::max(maxQuantizationError.normalDegrees, error.normalDegrees);
+            maxQuantizationError.texCoord = std::max(maxQuantizationError.texCoord, error.texCoord);
+        }
+        ImGui::Text("Vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", double(m_meshOptimizationReport.before.acmr()), double(m_meshOptimizationReport.after.acmr()),
+            double(m_meshOptimizationReport.before.atvr()), double(m_meshOptimizationReport.after.atvr()));
+        ImGui::Text("Vertex memory: %zu bytes per vertex", m_meshArena.bytesPerVertex());
+        ImGui::Text("Index memory: %.1f KiB (%.1f KiB with 32 bit indices)", double(m_meshArena.indexMemory()) / 1024.0, double(m_meshArena.indexMemory32Bit()) / 1024.0);
+        ImGui::Text("Max. vertex error: %.2e position, %.3f deg normal, %.2e UV",
+            double(maxQuantizationError.position), double(maxQuantizationError.normalDegrees), double(maxQuantizationError.texCoord));
+
+        ImGui::Separator();
+        ImGui::Text("Render path");
+        int renderPathIdx = static_cast<int>(utils::globals::currentRenderPath);
+        const auto getRenderPathName = [](void*, int idx, const char** outText) {
+            *outText = utils::renderPathName(utils::allRenderPaths[static_cast<size_t>(idx)]);
+            return true;
+        };
+        if (ImGui::Combo("Render path", &renderPathIdx, getRenderPathName, nullptr, static_cast<int>(utils::allRenderPaths.size())))
+            utils::globals::currentRenderPath = utils::allRenderPaths[static_cast<size_t>(renderPathIdx)];
+        int numPointLights = static_cast<int>(m_pointLights.size());
+        if (ImGui::SliderInt("Point lights", &numPointLights, static_cast<int>(m_numScenePointLights), 2048))
+            setNumPointLights(static_cast<size_t>(numPointLights));
+        if (const size_t maxPointLights = utils::maxPointLights(utils::globals::currentRenderPath); m_pointLights.size() > maxPointLights)
+            ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.0f, 1.0f), "%s only shades the first %zu point lights",
+                utils::renderPathName(utils::globals::currentRenderPath), maxPointLights);
+        ImGui::Checkbox("Pause generated lights", &utils::globals::pauseGeneratedLights);
+        if (utils::globals::currentRenderPath == RenderPath::ClusteredForward)
+            ImGui::Text("Cluster light indices: %zu", m_clusteredLightList.numLightIndices());
+        if (utils::globals::currentRenderPath == RenderPath::MultiPassForward) {
+            ImGui::Checkbox("Per-object light lists", &utils::globals::objectLightLists);
+            ImGui::Checkbox(m_lightClipping.hasDepthBounds() ? "Light scissor and depth bounds" : "Light scissor (no depth bounds test)", &utils::globals::lightClipping);
+            if (utils::globals::lightClipping)
+                ImGui::Text("Light pass scissor area: %.2f screens", double(m_lightClipping.scissoredArea()));
+        }
+        if (utils::globals::currentRenderPath == RenderPath::MultiPassForward && utils::globals::objectLightLists)
+            ImGui::Text("Passes: %zu point, %zu spot; object-light pairs: %zu", m_objectLightLists.numPasses(LightType::Point),
+                m_objectLightLists.numPasses(LightType::Spot), m_objectLightLists.numAssignments());
+        if (const auto sceneMilliseconds = m_sceneTimer.latestMilliseconds())
+            ImGui::Text("Scene GPU time: %.3f ms", *sceneMilliseconds);
+        if (m_renderPathBenchmark.isRunning())
+            ImGui::Text("Benchmark running...");
+        else if (ImGui::Button("Benchmark render paths"))
+            m_renderPathBenchmark.start(utils::allRenderPaths, benchmarkPointLightCounts);
+
         ImGui::End();
 
+        // ==== BENCHMARK ====
+        // Overrides the render path and number of lights while it runs
+        if (m_renderPathBenchmark.isRunning()) {
+            const RenderPathBenchmark::Step step = m_renderPathBenchmark.currentStep();
+            utils::globals::currentRenderPath = step.renderPath;
+            setNumPointLights(static_cast<size_t>(step.numPointLights));
+        }
+
         // Clear the screen
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClearDepth(1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        m_sceneTimer.begin();
         drawScene();
+        m_sceneTimer.end();
+        const std::optional<double> sceneMilliseconds = m_sceneTimer.collect();
+        if (m_renderPathBenchmark.isRunning()) {
+            m_renderPathBenchmark.recordFrame(sceneMilliseconds);
+            if (!m_renderPathBenchmark.isRunning())
+                m_renderPathBenchmark.printResults(std::cout);
+        }
         drawBezierPath();
 
         // Draw point lights and spotlights as square points
@@ -685,6 +1103,13 @@ void Application::onMouseMove(const glm::dvec2& cursorPos)
 void Application::onMouseClicked(int button, int mods)
 {
     std::cout << "Pressed mouse button: " << button << std::endl;
+
+    // Pick the renderable under the cursor with the scene BVH (as of the last frame)
+    if (button == GLFW_MOUSE_BUTTON_RIGHT && !ImGui::GetIO().WantCaptureMouse) {
+        const Camera& activeCamera = m_firstCameraActive ? m_firstCamera : m_secondCamera;
+        const glm::vec2 ndc = 2.0f * m_window.getNormalizedCursorPos() - 1.0f;
+        m_pickedDrawID = m_sceneBvh.pick(activeCamera.generateRay(ndc));
+    }
 }
 
 // If one of the mouse buttons is released this function will be called
@@ -1,6 +1,24 @@
 #pragma once
 
+#include "benchmark.h"
+#include "clustered_lighting.h"
+#include "culling.h"
+#include "deferred_shading.h"
+#include "gpu_driven.h"
+#include "instancing.h"
+#include "light.h"
+#include "light_assignment.h"
+#include "light_clipping.h"
 #include "mesh.h"
+#include "mesh_arena.h"
+#include "level_of_detail.h"
+#include "meshlet_culling.h"
+#include "object_constants.h"
+#include "occlusion_culling.h"
+#include "occlusion_queries.h"
+#include "render_queue.h"
+#include "renderable.h"
+#include "scene_bvh.h"
 #include "texture.h"
 #include "camera.h"
 #include "utils.h"
@@ -18,116 +36,15 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/mat4x4.hpp>
 #include <imgui/imgui.h>
 DISABLE_WARNINGS_POP()
+#include <framework/mesh_optimizer.h>
 #include <framework/shader.h>
 #include <framework/window.h>
 
 #include <functional>
 #include <iostream>
+#include <optional>
 #include <vector>
 
-
-enum class StateType {
-    Static,
-    Dynamic
-};
-
-enum class DrawingMode {
-    Opaque,
-    Reflective,
-};
-
-struct Light {
-    glm::vec3 diffuseColor;
-    glm::vec3 specularColor;
-    StateType lightType;
-};
-
-struct DirectionalLight : Light {
-    glm::vec3 direction;
-
-    DirectionalLight(const glm::vec3& dir,
-        const glm::vec3& diffuse,
-        const glm::vec3& specular,
-        StateType type = StateType::Static)
-        : direction(glm::normalize(dir))
-    {
-        diffuseColor = diffuse;
-        specularColor = specular;
-        lightType = type;
-    }
-};
-
-// vec2 attenuation coefficients: first component is linear coefficient, second is quadratic coefficient, constant coefficient is 1.0
-struct PointLight : Light {
-    glm::vec3 position;
-    glm::vec2 attenuationCoefficients;
-
-    PointLight(const glm::vec3& pos,
-        const glm::vec3& diffuse,
-        const glm::vec3& specular,
-        const float& maxDistance,
-        StateType type = StateType::Static)
-        : position(pos)
-        , attenuationCoefficients(utils::math::getAttenuationCoefficient(maxDistance))
-    {
-        diffuseColor = diffuse;
-        specularColor = specular;
-        lightType = type;
-    }
-};
-
-struct SpotLight : Light {
-    glm::vec3 position;
-    glm::vec3 direction;
-    glm::vec2 attenuationCoefficients;
-    float innerCutoffAngle;
-    float outerCutoffAngle;
-
-    SpotLight(const glm::vec3& pos,
-        const glm::vec3& dir,
-        const float& innerCutoff,
-        const float& outerCutoff,
-        const glm::vec3& diffuse,
-        const glm::vec3& specular,
-        const float& maxDistance,
-        StateType type = StateType::Static)
-        : position(pos)
-        , direction(glm::normalize(dir))
-        , attenuationCoefficients(utils::math::getAttenuationCoefficient(maxDistance))
-        , innerCutoffAngle(innerCutoff)
-        , outerCutoffAngle(outerCutoff)
-    {
-        diffuseColor = diffuse;
-        specularColor = specular;
-        lightType = type;
-    }
-};
-
-struct Transform {
-    glm::mat4 localModelMatrix;
-    Transform* parent; // nullptr when "this" transform is root
-
-    glm::mat4 getGlobalTransform(){
-        glm::mat4 globMatrix = localModelMatrix;
-        Transform* iter = parent;
-        while (iter != nullptr) {
-            globMatrix = iter->localModelMatrix * globMatrix;
-            iter = iter->parent;
-        }
-        return globMatrix;
-    }
-};
-
-struct Renderable {
-    GPUMesh mesh;
-    glm::mat4 modelMat;
-    std::optional<Texture> diffuseMap;
-    std::optional<Texture> normalMap;
-    StateType meshType;
-    DrawingMode drawMode;
-};
-
-
 class Application {
 public:
     Application();
@@ -139,12 +56,16 @@ public:
     void initLights();
     void initEnvironmentMapping();
     void initHierarchicalTransform();
+    void setNumPointLights(size_t numPointLights);
+    void setNumSphereInstances(size_t numSphereInstances);
 
     void drawScene();
     void drawSkybox();
     void drawBezierPath();
     void drawLightsAsPoints();
     void updateBezierLightPosition();
+    void updateInactiveCameraLight();
+    void updateGeneratedLights();
     void updateHierarchicalTransform();
     void update();
 
@@ -155,6 +76,13 @@ public:
     void onMouseReleased(int button, int mods);
 
 private:
+#ifdef TECHDEMO_GL45
+    static constexpr OpenGLVersion OPENGL_VERSION = OpenGLVersion::GL45;
+#else
+    static constexpr OpenGLVersion OPENGL_VERSION = OpenGLVersion::GL41;
+#endif
+    static constexpr float MAX_SORT_DEPTH = 100.0f; // Depth at which the depth bits of the sort keys saturate
+
     Window m_window;
 
     Shader m_lightShader;
@@ -163,17 +91,63 @@ private:
     Shader m_blinnOrPhongPointLightShader;
     Shader m_blinnOrPhongDirLightShader;
     Shader m_blinnOrPhongSpotLightShader;
+    Shader m_blinnOrPhongUberShader;
+    Shader m_blinnOrPhongClusteredShader;
+    Shader m_gBufferShader;
+    Shader m_deferredLightShader;
+    Shader m_deferredDirLightShader;
     Shader m_bezierPathShader;
     Shader m_reflectionMapShader;
+    Shader m_boundingBoxShader;
+    Shader m_gpuCullShader; // OpenGL 4.5 only
 
     Texture m_texture;
     bool m_useMaterial{ true };
     
+    MeshOptimizationReport m_meshOptimizationReport; // Of the scene meshes, summed
+    MeshArena m_meshArena { VertexFormat::Quantized }; // Declared before the renderables, whose meshes free their ranges on destruction
     std::vector < Renderable> m_renderable;
+    size_t m_numSceneRenderables; // Renderables of the scene itself, the remaining ones are generated sphere instances
+    ObjectConstantsBuffer m_objectConstants;
+    CullingBounds m_cullingBounds;
+    SceneBvh m_sceneBvh;
+    std::optional<uint32_t> m_pickedDrawID; // Renderable under the cursor at the last right click
+    std::vector<uint8_t> m_visibleRenderables; // Result of frustum and occlusion culling against the active camera, by draw ID
+    struct Occluder {
+        size_t drawID;
+        OccluderMesh mesh;
+    };
+    std::vector<Occluder> m_occluders;
+    OcclusionCuller m_occlusionCuller;
+    size_t m_numOccludedRenderables { 0 };
+    OcclusionQueries m_occlusionQueries;
+    LodSelection m_lodSelection;
+    std::vector<uint8_t> m_fullDetailRenderables; // Visible renderables drawn at level of detail 0, for meshlet culling
+    MeshletCulling m_meshletCulling;
+    RenderQueue m_renderQueue;
+    RenderStateCache m_stateCache;
+    SortIdTable<std::pair<const Texture*, const Texture*>> m_textureSetIds;
+    SortIdTable<std::pair<const GPUMesh*, uint32_t>> m_meshIds; // Mesh and level of detail
+    InstanceBuffer m_instanceBuffer;
+    GpuDrivenScene m_gpuDrivenScene;
+    bool m_gpuDrivenSceneDirty { true }; // Renderables were added or removed since the last GpuDrivenScene::build()
 
     std::vector<PointLight> m_pointLights;
+    size_t m_numScenePointLights; // Point lights of the scene itself, the remaining ones are generated
     std::vector<SpotLight> m_spotLights;
     DirectionalLight m_sunLight;
+    LightBuffer m_lightBuffer;
+    ObjectLightLists m_objectLightLists;
+    LightClipping m_lightClipping;
+    ClusteredLightList m_clusteredLightList;
+
+    // Deferred shading
+    GBuffer m_gBuffer;
+    LightVolumes m_lightVolumes;
+
+    // Benchmarking
+    GpuTimer m_sceneTimer;
+    RenderPathBenchmark m_renderPathBenchmark;
 
     bool m_firstCameraActive = true;
     Camera m_firstCamera;
@@ -188,10 +162,10 @@ private:
     GLuint m_skyboxVBO;
     GLuint m_skyboxTex;
 
-    // Hierarchical transform
-    Renderable* sun;
-    Renderable* planet;
-    Renderable* moon;
+    // Hierarchical transform, indices into m_renderable (which may grow and move its elements)
+    static constexpr size_t SUN = 0;
+    static constexpr size_t PLANET = 1;
+    static constexpr size_t MOON = 2;
     Transform m_sunTransform;
     Transform m_planetTransform;
     Transform m_moonTransform;
@@ -0,0 +1,130 @@
+#include "benchmark.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <fmt/format.h>
+DISABLE_WARNINGS_POP()
+
+GpuTimer::GpuTimer()
+{
+    glGenQueries(static_cast<GLsizei>(NUM_QUERIES), m_queries.data());
+}
+
+GpuTimer::~GpuTimer()
+{
+    glDeleteQueries(static_cast<GLsizei>(NUM_QUERIES), m_queries.data());
+}
+
+void GpuTimer::begin()
+{
+    // All queries in flight? Drop the oldest measurement rather than waiting for it.
+    if (m_pending[m_next]) {
+        m_pending[m_next] = false;
+        m_oldestPending = (m_next + 1) % NUM_QUERIES;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+}
+
+void GpuTimer::end()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    m_pending[m_next] = true;
+    m_next = (m_next + 1) % NUM_QUERIES;
+}
+
+std::optional<double> GpuTimer::collect()
+{
+    std::optional<double> newest;
+    while (m_pending[m_oldestPending]) {
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(m_queries[m_oldestPending], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(m_queries[m_oldestPending], GL_QUERY_RESULT, &nanoseconds);
+        newest = m_latest = static_cast<double>(nanoseconds) * 1e-6;
+        m_pending[m_oldestPending] = false;
+        m_oldestPending = (m_oldestPending + 1) % NUM_QUERIES;
+    }
+    return newest;
+}
+
+std::optional<double> GpuTimer::latestMilliseconds() const
+{
+    return m_latest;
+}
+
+void RenderPathBenchmark::start(std::span<const RenderPath> renderPaths, std::span<const int> pointLightCounts)
+{
+    m_renderPaths.assign(std::begin(renderPaths), std::end(renderPaths));
+    m_pointLightCounts.assign(std::begin(pointLightCounts), std::end(pointLightCounts));
+    m_results.clear();
+    m_currentStep = 0;
+    m_frameInStep = 0;
+    m_accumulatedMilliseconds = 0.0;
+    m_numMeasurements = 0;
+    skipUnsupportedSteps();
+}
+
+bool RenderPathBenchmark::isRunning() const
+{
+    return m_currentStep < m_renderPaths.size() * m_pointLightCounts.size();
+}
+
+RenderPathBenchmark::Step RenderPathBenchmark::currentStep() const
+{
+    return { m_renderPaths[m_currentStep % m_renderPaths.size()], m_pointLightCounts[m_currentStep / m_renderPaths.size()] };
+}
+
+void RenderPathBenchmark::recordFrame(std::optional<double> gpuMilliseconds)
+{
+    if (!isRunning())
+        return;
+
+    if (++m_frameInStep > WARMUP_FRAMES && gpuMilliseconds) {
+        m_accumulatedMilliseconds += *gpuMilliseconds;
+        m_numMeasurements++;
+    }
+
+    if (m_frameInStep == WARMUP_FRAMES + MEASURED_FRAMES) {
+        m_results.push_back(m_numMeasurements > 0 ? m_accumulatedMilliseconds / m_numMeasurements : 0.0);
+        m_currentStep++;
+        m_frameInStep = 0;
+        m_accumulatedMilliseconds = 0.0;
+        m_numMeasurements = 0;
+        skipUnsupportedSteps();
+    }
+}
+
+void RenderPathBenchmark::skipUnsupportedSteps()
+{
+    while (isRunning()) {
+        const Step step = currentStep();
+        if (static_cast<size_t>(step.numPointLights) <= utils::maxPointLights(step.renderPath))
+            break;
+        m_results.push_back(std::nullopt);
+        m_currentStep++;
+    }
+}
+
+void RenderPathBenchmark::printResults(std::ostream& stream) const
+{
+    stream << fmt::format("{:>12}", "point lights");
+    for (RenderPath renderPath : m_renderPaths)
+        stream << fmt::format(" | {:>22}", utils::renderPathName(renderPath));
+    stream << std::endl;
+
+    for (size_t lightCountIdx = 0; lightCountIdx < m_pointLightCounts.size(); lightCountIdx++) {
+        stream << fmt::format("{:>12}", m_pointLightCounts[lightCountIdx]);
+        for (size_t pathIdx = 0; pathIdx < m_renderPaths.size(); pathIdx++) {
+            const size_t resultIdx = lightCountIdx * m_renderPaths.size() + pathIdx;
+            if (resultIdx >= m_results.size())
+                continue;
+            if (m_results[resultIdx])
+                stream << fmt::format(" | {:>19.3f} ms", *m_results[resultIdx]);
+            else
+                stream << fmt::format(" | {:>22}", fmt::format("n/a (max {})", utils::maxPointLights(m_renderPaths[pathIdx])));
+        }
+        stream << std::endl;
+    }
+}
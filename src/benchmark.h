@@ -0,0 +1,76 @@
+#pragma once
+
+#include "utils.h"
+#include <framework/opengl_includes.h>
+
+#include <array>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <vector>
+
+// Measures the GPU time of a range of commands with GL_TIME_ELAPSED queries. Results are read back a few frames
+// later from a small ring of queries, so measuring never stalls the pipeline.
+class GpuTimer {
+public:
+    GpuTimer();
+    GpuTimer(const GpuTimer&) = delete;
+    ~GpuTimer();
+
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    void begin();
+    void end();
+
+    // Read back the queries that the GPU has finished; returns the newest measurement (in milliseconds)
+    // that became available since the previous call.
+    std::optional<double> collect();
+    // Most recent measurement that the GPU has finished, in milliseconds.
+    std::optional<double> latestMilliseconds() const;
+
+private:
+    static constexpr size_t NUM_QUERIES = 4;
+
+    std::array<GLuint, NUM_QUERIES> m_queries {};
+    std::array<bool, NUM_QUERIES> m_pending {};
+    size_t m_next { 0 };
+    size_t m_oldestPending { 0 };
+    std::optional<double> m_latest;
+};
+
+// Renders the scene with each render path for a growing number of point lights and reports the average
+// GPU time per combination. Combinations with more point lights than the render path can shade are skipped.
+class RenderPathBenchmark {
+public:
+    struct Step {
+        RenderPath renderPath;
+        int numPointLights;
+    };
+
+    void start(std::span<const RenderPath> renderPaths, std::span<const int> pointLightCounts);
+    bool isRunning() const;
+
+    // Configuration that the next frame should be rendered with.
+    Step currentStep() const;
+    // Record the GPU time measured for a frame rendered with currentStep(). Moves on to the next step once
+    // enough frames were measured.
+    void recordFrame(std::optional<double> gpuMilliseconds);
+
+    void printResults(std::ostream& stream) const;
+
+private:
+    // Frames skipped after switching configuration; covers the latency of GpuTimer.
+    static constexpr int WARMUP_FRAMES = 10;
+    static constexpr int MEASURED_FRAMES = 60;
+
+    // Move past the steps whose point light count exceeds utils::maxPointLights() of their render path.
+    void skipUnsupportedSteps();
+
+    std::vector<RenderPath> m_renderPaths;
+    std::vector<int> m_pointLightCounts;
+    std::vector<std::optional<double>> m_results; // Average GPU time per step (empty if skipped), indexed [lightCountIdx * numPaths + pathIdx]
+    size_t m_currentStep { 0 };
+    int m_frameInStep { 0 };
+    double m_accumulatedMilliseconds { 0.0 };
+    int m_numMeasurements { 0 };
+};
@@ -5,6 +5,7 @@ DISABLE_WARNINGS_PUSH()
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include <glm/matrix.hpp>
 DISABLE_WARNINGS_POP()
 
 #include <imgui/imgui.h>
@@ -53,6 +54,18 @@ glm::mat4 Camera::viewProjectionMatrix() const
     return m_projectionMatrixCached * viewMatrix();
 }
 
+Ray Camera::generateRay(const glm::vec2& ndc) const
+{
+    const glm::mat4 inverseViewProjection = glm::inverse(viewProjectionMatrix());
+    const glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+    const glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+
+    Ray ray;
+    ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+    ray.direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - ray.origin);
+    return ray;
+}
+
 void Camera::rotateX(float angle)
 {
     const glm::vec3 horAxis = glm::cross(s_yAxis, m_forward);
@@ -7,6 +7,7 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 DISABLE_WARNINGS_POP()
+#include <framework/ray.h>
 #include <framework/window.h>
 
 class Camera {
@@ -22,6 +23,8 @@ public:
     glm::mat4 viewMatrix() const;
     glm::mat4 projectionMatrix() const;
     glm::mat4 viewProjectionMatrix() const;
+    // Ray from the near plane through a point in normalized device coordinates ([-1, 1], y up), e.g. for picking.
+    Ray generateRay(const glm::vec2& ndc) const;
 
 
 private:
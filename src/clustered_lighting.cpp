@@ -0,0 +1,239 @@
+#include "clustered_lighting.h"
+#include "simd.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/gtc/type_ptr.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+static_assert(ClusteredLightList::GRID_SIZE.x % 4 == 0);
+static_assert(sizeof(GPUClusteredLight) == 4 * sizeof(glm::vec4));
+
+// Cone that covers the whole sphere, such that point lights can be shaded as spot lights
+static constexpr float POINT_LIGHT_OUTER_CUTOFF = -2.0f;
+static constexpr float POINT_LIGHT_INNER_CUTOFF = -1.0f;
+
+ClusteredLightList::ClusteredLightList()
+{
+    glGenBuffers(static_cast<GLsizei>(m_buffers.size()), m_buffers.data());
+    glGenTextures(static_cast<GLsizei>(m_textures.size()), m_textures.data());
+
+    // The association between a buffer texture and its buffer survives re-specifying the buffer storage
+    constexpr std::array<GLenum, 3> formats { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+    for (size_t i = 0; i < m_buffers.size(); i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_buffers[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+ClusteredLightList::~ClusteredLightList()
+{
+    freeGpuMemory();
+}
+
+void ClusteredLightList::update(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
+    std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights, std::span<const DirectionalLight> directionalLights)
+{
+    if (projectionMatrix != m_cachedProjectionMatrix)
+        updateClusterBounds(projectionMatrix);
+    m_depthPlane = -glm::vec4(viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2], viewMatrix[3][2]);
+
+    // ======== LIGHT DATA ========
+    // Point lights first, then spot lights (both are assigned to clusters), then directional lights (which affect every cluster)
+    m_lights.clear();
+    for (const PointLight& light : pointLights) {
+        m_lights.push_back({ glm::vec4(light.position, POINT_LIGHT_OUTER_CUTOFF), glm::vec4(0, 0, 1, POINT_LIGHT_INNER_CUTOFF),
+            glm::vec4(light.diffuseColor, light.attenuationCoefficients.x), glm::vec4(light.specularColor, light.attenuationCoefficients.y) });
+    }
+    for (const SpotLight& light : spotLights) {
+        m_lights.push_back({ glm::vec4(light.position, glm::cos(light.outerCutoffAngle)), glm::vec4(light.direction, glm::cos(light.innerCutoffAngle)),
+            glm::vec4(light.diffuseColor, light.attenuationCoefficients.x), glm::vec4(light.specularColor, light.attenuationCoefficients.y) });
+    }
+    for (const DirectionalLight& light : directionalLights) {
+        m_lights.push_back({ glm::vec4(0.0f), glm::vec4(light.direction, 0.0f), glm::vec4(light.diffuseColor, 0.0f), glm::vec4(light.specularColor, 0.0f) });
+    }
+    m_numPointAndSpotLights = static_cast<int>(pointLights.size() + spotLights.size());
+    m_numDirectionalLights = static_cast<int>(directionalLights.size());
+
+    // ======== LIGHT ASSIGNMENT ========
+    m_clusterLightPairs.clear();
+    uint32_t lightIdx = 0;
+    for (const PointLight& light : pointLights) {
+        const glm::vec3 viewPosition = viewMatrix * glm::vec4(light.position, 1.0f);
+        assignLight(lightIdx++, viewPosition, utils::math::getAttenuationRadius(light.attenuationCoefficients, maxIntensity(light)), nullptr);
+    }
+    for (const SpotLight& light : spotLights) {
+        const glm::vec3 viewPosition = viewMatrix * glm::vec4(light.position, 1.0f);
+        const Cone cone { viewPosition, glm::normalize(glm::vec3(viewMatrix * glm::vec4(light.direction, 0.0f))),
+            glm::cos(light.outerCutoffAngle), glm::sin(light.outerCutoffAngle) };
+        assignLight(lightIdx++, viewPosition, utils::math::getAttenuationRadius(light.attenuationCoefficients, maxIntensity(light)), &cone);
+    }
+
+    // Counting sort of the (cluster, light) pairs into one compact index list per cluster
+    m_clusters.assign(NUM_CLUSTERS, glm::uvec2(0));
+    for (const auto& [cluster, light] : m_clusterLightPairs)
+        m_clusters[cluster].y++;
+    uint32_t offset = 0;
+    for (glm::uvec2& cluster : m_clusters) {
+        cluster.x = offset;
+        offset += cluster.y;
+    }
+    m_lightIndices.resize(std::max<size_t>(m_clusterLightPairs.size(), 1)); // Buffer textures may not be empty
+    std::vector<uint32_t> cursors(NUM_CLUSTERS, 0);
+    for (const auto& [cluster, light] : m_clusterLightPairs)
+        m_lightIndices[m_clusters[cluster].x + cursors[cluster]++] = light;
+
+    // ======== UPLOAD ========
+    // Re-specifying the whole buffers lets the driver orphan last frame's storage instead of stalling on it.
+    if (m_lights.empty())
+        m_lights.emplace_back();
+    const auto upload = [](GLuint buffer, size_t size, const void* pData) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(size), pData, GL_STREAM_DRAW);
+    };
+    upload(m_buffers[0], m_lights.size() * sizeof(GPUClusteredLight), m_lights.data());
+    upload(m_buffers[1], m_clusters.size() * sizeof(glm::uvec2), m_clusters.data());
+    upload(m_buffers[2], m_lightIndices.size() * sizeof(uint32_t), m_lightIndices.data());
+}
+
+void ClusteredLightList::bind(const Shader& shader, const glm::ivec2& framebufferSize) const
+{
+    constexpr std::array<GLint, 3> textureUnits { LIGHT_DATA_TEXTURE_UNIT, CLUSTER_TEXTURE_UNIT, LIGHT_INDEX_TEXTURE_UNIT };
+    for (size_t i = 0; i < m_textures.size(); i++) {
+        glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(textureUnits[i]));
+        glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+    }
+    shader.setUniform("clusterLightData", LIGHT_DATA_TEXTURE_UNIT);
+    shader.setUniform("clusterLightLists", CLUSTER_TEXTURE_UNIT);
+    shader.setUniform("clusterLightIndices", LIGHT_INDEX_TEXTURE_UNIT);
+
+    // Depth slice of view-space depth d is log(d) * scale + bias, see depthSlice()
+    const float sliceScale = float(GRID_SIZE.z) / std::log(m_farPlane / m_nearPlane);
+    shader.setUniform("clusterGridSize", GRID_SIZE);
+    shader.setUniform("clusterTileScale", glm::vec2(GRID_SIZE.x, GRID_SIZE.y) / glm::vec2(framebufferSize));
+    shader.setUniform("clusterDepthPlane", m_depthPlane);
+    shader.setUniform("clusterSliceScaleBias", glm::vec2(sliceScale, -std::log(m_nearPlane) * sliceScale));
+    shader.setUniform("directionalLightOffset", m_numPointAndSpotLights);
+    shader.setUniform("numDirectionalLights", m_numDirectionalLights);
+}
+
+size_t ClusteredLightList::numLightIndices() const
+{
+    return m_clusterLightPairs.size();
+}
+
+void ClusteredLightList::updateClusterBounds(const glm::mat4& projectionMatrix)
+{
+    // Parameters of a symmetric perspective projection (as created by glm::perspective)
+    m_cachedProjectionMatrix = projectionMatrix;
+    m_nearPlane = projectionMatrix[3][2] / (projectionMatrix[2][2] - 1.0f);
+    m_farPlane = projectionMatrix[3][2] / (projectionMatrix[2][2] + 1.0f);
+    const float tanHalfFovX = 1.0f / projectionMatrix[0][0];
+    const float tanHalfFovY = 1.0f / projectionMatrix[1][1];
+
+    m_minX.resize(NUM_CLUSTERS);
+    m_minY.resize(NUM_CLUSTERS);
+    m_minZ.resize(NUM_CLUSTERS);
+    m_maxX.resize(NUM_CLUSTERS);
+    m_maxY.resize(NUM_CLUSTERS);
+    m_maxZ.resize(NUM_CLUSTERS);
+    m_boundingSpheres.resize(NUM_CLUSTERS);
+    for (int z = 0; z < GRID_SIZE.z; z++) {
+        // Exponential depth slices keep clusters roughly cube shaped
+        const float sliceNear = m_nearPlane * std::pow(m_farPlane / m_nearPlane, float(z) / float(GRID_SIZE.z));
+        const float sliceFar = m_nearPlane * std::pow(m_farPlane / m_nearPlane, float(z + 1) / float(GRID_SIZE.z));
+        for (int y = 0; y < GRID_SIZE.y; y++) {
+            const float ndcY0 = -1.0f + 2.0f * float(y) / float(GRID_SIZE.y);
+            const float ndcY1 = -1.0f + 2.0f * float(y + 1) / float(GRID_SIZE.y);
+            for (int x = 0; x < GRID_SIZE.x; x++) {
+                const float ndcX0 = -1.0f + 2.0f * float(x) / float(GRID_SIZE.x);
+                const float ndcX1 = -1.0f + 2.0f * float(x + 1) / float(GRID_SIZE.x);
+
+                // The tile is widest at either the near or the far side of the slice
+                const size_t i = size_t(x + GRID_SIZE.x * (y + GRID_SIZE.y * z));
+                m_minX[i] = std::min(ndcX0 * sliceNear, ndcX0 * sliceFar) * tanHalfFovX;
+                m_maxX[i] = std::max(ndcX1 * sliceNear, ndcX1 * sliceFar) * tanHalfFovX;
+                m_minY[i] = std::min(ndcY0 * sliceNear, ndcY0 * sliceFar) * tanHalfFovY;
+                m_maxY[i] = std::max(ndcY1 * sliceNear, ndcY1 * sliceFar) * tanHalfFovY;
+                m_minZ[i] = -sliceFar;
+                m_maxZ[i] = -sliceNear;
+
+                const glm::vec3 minCorner { m_minX[i], m_minY[i], m_minZ[i] };
+                const glm::vec3 maxCorner { m_maxX[i], m_maxY[i], m_maxZ[i] };
+                m_boundingSpheres[i] = glm::vec4((minCorner + maxCorner) * 0.5f, glm::length(maxCorner - minCorner) * 0.5f);
+            }
+        }
+    }
+}
+
+int ClusteredLightList::depthSlice(float viewDepth) const
+{
+    if (viewDepth <= m_nearPlane)
+        return 0;
+    const int slice = int(std::log(viewDepth / m_nearPlane) / std::log(m_farPlane / m_nearPlane) * float(GRID_SIZE.z));
+    return std::min(slice, GRID_SIZE.z - 1);
+}
+
+void ClusteredLightList::assignLight(uint32_t lightIdx, const glm::vec3& viewPosition, float radius, const Cone* pCone)
+{
+    // The camera looks down the negative z-axis
+    const float depth = -viewPosition.z;
+    if (depth + radius < m_nearPlane || depth - radius > m_farPlane)
+        return;
+
+    // Sphere-AABB test against four clusters at a time: squared distance from the center to the box <= radius^2
+    const simd::Float4 centerX = simd::Float4::broadcast(viewPosition.x);
+    const simd::Float4 centerY = simd::Float4::broadcast(viewPosition.y);
+    const simd::Float4 centerZ = simd::Float4::broadcast(viewPosition.z);
+    const simd::Float4 radiusSquared = simd::Float4::broadcast(radius * radius);
+    const simd::Float4 zero = simd::Float4::broadcast(0.0f);
+    const auto axisDistance = [&](const std::vector<float>& minBound, const std::vector<float>& maxBound, size_t i, simd::Float4 center) {
+        const simd::Float4 distance = simd::max(simd::Float4::load(&minBound[i]) - center, center - simd::Float4::load(&maxBound[i]));
+        return simd::max(distance, zero);
+    };
+
+    const int lastSlice = depthSlice(depth + radius);
+    for (int z = depthSlice(depth - radius); z <= lastSlice; z++) {
+        for (int y = 0; y < GRID_SIZE.y; y++) {
+            for (int x = 0; x < GRID_SIZE.x; x += 4) {
+                const size_t firstCluster = size_t(x + GRID_SIZE.x * (y + GRID_SIZE.y * z));
+                const simd::Float4 dx = axisDistance(m_minX, m_maxX, firstCluster, centerX);
+                const simd::Float4 dy = axisDistance(m_minY, m_maxY, firstCluster, centerY);
+                const simd::Float4 dz = axisDistance(m_minZ, m_maxZ, firstCluster, centerZ);
+                unsigned overlapMask = unsigned(simd::bitMask(simd::lessEqual(dx * dx + dy * dy + dz * dz, radiusSquared)));
+
+                while (overlapMask) {
+                    const uint32_t cluster = uint32_t(firstCluster) + uint32_t(std::countr_zero(overlapMask));
+                    overlapMask &= overlapMask - 1;
+
+                    if (pCone) {
+                        // Cone against the bounding sphere of the cluster (tested on the few clusters that pass the sphere test)
+                        const glm::vec4& sphere = m_boundingSpheres[cluster];
+                        const glm::vec3 toCluster = glm::vec3(sphere) - pCone->apex;
+                        const float alongAxis = glm::dot(toCluster, pCone->direction);
+                        const float fromAxis = std::sqrt(std::max(glm::dot(toCluster, toCluster) - alongAxis * alongAxis, 0.0f));
+                        const float closestDistance = pCone->cosAngle * fromAxis - alongAxis * pCone->sinAngle;
+                        if (closestDistance > sphere.w || alongAxis < -sphere.w || alongAxis > sphere.w + radius)
+                            continue;
+                    }
+                    m_clusterLightPairs.emplace_back(cluster, lightIdx);
+                }
+            }
+        }
+    }
+}
+
+void ClusteredLightList::freeGpuMemory()
+{
+    if (m_buffers[0] != INVALID)
+        glDeleteBuffers(static_cast<GLsizei>(m_buffers.size()), m_buffers.data());
+    if (m_textures[0] != INVALID)
+        glDeleteTextures(static_cast<GLsizei>(m_textures.size()), m_textures.data());
+    m_buffers.fill(INVALID);
+    m_textures.fill(INVALID);
+}
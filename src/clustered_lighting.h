@@ -0,0 +1,95 @@
+#pragma once
+
+#include "light.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/opengl_includes.h>
+#include <framework/shader.h>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// GPU representation of a light in the clustered light data buffer: four RGBA32F texels per light. Point lights
+// are stored as spot lights with a cone that covers the whole sphere, directional lights only use the direction
+// and colors. Must match shadeLight() in blinn_or_phong_clustered_frag.glsl.
+struct GPUClusteredLight {
+    glm::vec4 positionAndOuterCutoff;
+    glm::vec4 directionAndInnerCutoff;
+    glm::vec4 diffuseColorAndLinearAttenuation;
+    glm::vec4 specularColorAndQuadraticAttenuation;
+};
+
+// Light lists of the clustered forward path. The view frustum of the camera is split into GRID_SIZE clusters
+// (screen-space tiles times exponentially spaced depth slices). Every frame the point and spot lights are assigned
+// to the clusters that their attenuation radius overlaps and the per-cluster index lists are uploaded to texture
+// buffers (GL 4.1 has no shader storage buffers), such that each fragment only loops over the lights of its cluster.
+class ClusteredLightList {
+public:
+    static constexpr glm::ivec3 GRID_SIZE { 16, 16, 24 }; // The x dimension must be a multiple of 4 (SIMD width)
+    // Texture units 0 and 1 are used by the diffuse and normal maps
+    static constexpr GLint LIGHT_DATA_TEXTURE_UNIT = 2;
+    static constexpr GLint CLUSTER_TEXTURE_UNIT = 3;
+    static constexpr GLint LIGHT_INDEX_TEXTURE_UNIT = 4;
+
+    ClusteredLightList();
+    ClusteredLightList(const ClusteredLightList&) = delete;
+    ClusteredLightList(ClusteredLightList&&) = delete;
+    ~ClusteredLightList();
+
+    ClusteredLightList& operator=(const ClusteredLightList&) = delete;
+    ClusteredLightList& operator=(ClusteredLightList&&) = delete;
+
+    // Assign the lights to the clusters of the (perspective) camera and upload the result.
+    void update(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
+        std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights, std::span<const DirectionalLight> directionalLights);
+
+    // Bind the buffers to their texture units and set the uniforms with which the shader finds the cluster of a fragment.
+    void bind(const Shader& shader, const glm::ivec2& framebufferSize) const;
+
+    // Total length of all per-cluster light lists of the last update.
+    size_t numLightIndices() const;
+
+private:
+    struct Cone {
+        glm::vec3 apex; // View space
+        glm::vec3 direction; // View space
+        float cosAngle;
+        float sinAngle;
+    };
+
+    void updateClusterBounds(const glm::mat4& projectionMatrix);
+    int depthSlice(float viewDepth) const;
+    void assignLight(uint32_t lightIdx, const glm::vec3& viewPosition, float radius, const Cone* pCone);
+    void freeGpuMemory();
+
+private:
+    static constexpr GLuint INVALID = 0xFFFFFFFF;
+    static constexpr size_t NUM_CLUSTERS = size_t(GRID_SIZE.x * GRID_SIZE.y * GRID_SIZE.z);
+
+    glm::mat4 m_cachedProjectionMatrix { 0.0f }; // Cluster bounds are only recomputed when the projection changes
+    float m_nearPlane { 0.0f };
+    float m_farPlane { 0.0f };
+    // View-space bounds of every cluster as structure of arrays, indexed by x + GRID_SIZE.x * (y + GRID_SIZE.y * z)
+    std::vector<float> m_minX, m_minY, m_minZ, m_maxX, m_maxY, m_maxZ;
+    std::vector<glm::vec4> m_boundingSpheres; // Used for the spot light cone test
+
+    glm::vec4 m_depthPlane { 0.0f }; // View-space depth of a world-space point p is dot(plane, vec4(p, 1))
+    std::vector<std::pair<uint32_t, uint32_t>> m_clusterLightPairs; // (cluster, light) overlaps found this frame
+    std::vector<GPUClusteredLight> m_lights;
+    std::vector<glm::uvec2> m_clusters; // (offset, count) into m_lightIndices
+    std::vector<uint32_t> m_lightIndices;
+    int m_numPointAndSpotLights { 0 };
+    int m_numDirectionalLights { 0 };
+
+    // Light data, clusters and light indices; each buffer is exposed to the shader through a buffer texture
+    std::array<GLuint, 3> m_buffers { INVALID, INVALID, INVALID };
+    std::array<GLuint, 3> m_textures { INVALID, INVALID, INVALID };
+};
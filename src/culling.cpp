@@ -0,0 +1,99 @@
+#include "culling.h"
+#include "simd.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/matrix.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+
+Frustum::Frustum(const glm::mat4& viewProjectionMatrix)
+{
+    // Gribb-Hartmann: the planes are sums and differences of the rows of the matrix (glm is column-major)
+    const glm::mat4 rows = glm::transpose(viewProjectionMatrix);
+    planes = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+    for (glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+}
+
+AxisAlignedBox transformBounds(const AxisAlignedBox& bounds, const glm::mat4& modelMatrix)
+{
+    const glm::mat3 linear { modelMatrix };
+    const glm::mat3 absLinear { glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]) };
+    const glm::vec3 center = modelMatrix * glm::vec4(0.5f * (bounds.lower + bounds.upper), 1.0f);
+    const glm::vec3 extent = absLinear * (0.5f * (bounds.upper - bounds.lower));
+    return AxisAlignedBox { center - extent, center + extent };
+}
+
+void CullingBounds::clear()
+{
+    m_size = 0;
+    for (std::vector<float>* pArray : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ, &m_sphereX, &m_sphereY, &m_sphereZ, &m_sphereRadius })
+        pArray->clear();
+}
+
+void CullingBounds::add(const AxisAlignedBox& bounds, const BoundingSphere& boundingSphere, const glm::mat4& modelMatrix)
+{
+    // Grow by a whole SIMD group at a time; unused lanes are never written to the visibility list
+    if (m_size % 4 == 0) {
+        for (std::vector<float>* pArray : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ, &m_sphereX, &m_sphereY, &m_sphereZ, &m_sphereRadius })
+            pArray->resize(m_size + 4, 0.0f);
+    }
+
+    const AxisAlignedBox worldBounds = transformBounds(bounds, modelMatrix);
+    const glm::vec3 center = 0.5f * (worldBounds.lower + worldBounds.upper);
+    const glm::vec3 extent = 0.5f * (worldBounds.upper - worldBounds.lower);
+
+    // Sphere radius scaled by the largest axis scale, which is conservative for non-uniform scaling
+    const glm::mat3 linear { modelMatrix };
+    const glm::vec3 sphereCenter = modelMatrix * glm::vec4(boundingSphere.center, 1.0f);
+    const float maxScale = std::max({ glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2]) });
+
+    m_centerX[m_size] = center.x;
+    m_centerY[m_size] = center.y;
+    m_centerZ[m_size] = center.z;
+    m_extentX[m_size] = extent.x;
+    m_extentY[m_size] = extent.y;
+    m_extentZ[m_size] = extent.z;
+    m_sphereX[m_size] = sphereCenter.x;
+    m_sphereY[m_size] = sphereCenter.y;
+    m_sphereZ[m_size] = sphereCenter.z;
+    m_sphereRadius[m_size] = boundingSphere.radius * maxScale;
+    m_size++;
+}
+
+size_t CullingBounds::size() const
+{
+    return m_size;
+}
+
+void CullingBounds::cull(const Frustum& frustum, std::vector<uint8_t>& visible) const
+{
+    visible.resize(m_size);
+
+    using simd::Float4;
+    const Float4 zero = Float4::broadcast(0.0f);
+    for (size_t first = 0; first < m_size; first += 4) {
+        const Float4 centerX = Float4::load(&m_centerX[first]), centerY = Float4::load(&m_centerY[first]), centerZ = Float4::load(&m_centerZ[first]);
+        const Float4 extentX = Float4::load(&m_extentX[first]), extentY = Float4::load(&m_extentY[first]), extentZ = Float4::load(&m_extentZ[first]);
+        const Float4 sphereX = Float4::load(&m_sphereX[first]), sphereY = Float4::load(&m_sphereY[first]), sphereZ = Float4::load(&m_sphereZ[first]);
+        const Float4 negativeRadius = zero - Float4::load(&m_sphereRadius[first]);
+
+        // An object is culled as soon as either its sphere or its box lies completely outside of one of the planes
+        Float4 inside = simd::lessEqual(zero, zero); // All lanes set
+        for (const glm::vec4& plane : frustum.planes) {
+            const Float4 planeX = Float4::broadcast(plane.x), planeY = Float4::broadcast(plane.y), planeZ = Float4::broadcast(plane.z), planeW = Float4::broadcast(plane.w);
+
+            const Float4 sphereDistance = planeX * sphereX + planeY * sphereY + planeZ * sphereZ + planeW;
+            // Signed distance of the box corner furthest along the plane normal
+            const Float4 boxDistance = planeX * centerX + planeY * centerY + planeZ * centerZ + planeW
+                + simd::abs(planeX) * extentX + simd::abs(planeY) * extentY + simd::abs(planeZ) * extentZ;
+            inside = simd::maskAnd(inside, simd::maskAnd(simd::greaterEqual(sphereDistance, negativeRadius), simd::greaterEqual(boxDistance, zero)));
+        }
+
+        const int insideMask = simd::bitMask(inside);
+        for (size_t lane = 0; lane < 4 && first + lane < m_size; lane++)
+            visible[first + lane] = (insideMask >> lane) & 1;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <framework/disable_all_warnings.h>
+#include <framework/mesh.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// The six planes of the view frustum of any view-projection matrix (camera, shadow map, cube map face, ...).
+// Planes are normalized and point inwards: a point p is inside if dot(plane, vec4(p, 1)) >= 0 for every plane.
+struct Frustum {
+    explicit Frustum(const glm::mat4& viewProjectionMatrix);
+
+    std::array<glm::vec4, 6> planes;
+};
+
+// Bounds of the transformed box: the transformed center with the extent projected onto the world axes (Arvo).
+AxisAlignedBox transformBounds(const AxisAlignedBox& bounds, const glm::mat4& modelMatrix);
+
+// World-space bounds of a set of objects, stored as structure of arrays (padded to a multiple of four)
+// such that they can be tested against a frustum four at a time.
+class CullingBounds {
+public:
+    void clear();
+    // Transform the object-space bounds of a mesh to world space and append them.
+    void add(const AxisAlignedBox& bounds, const BoundingSphere& boundingSphere, const glm::mat4& modelMatrix);
+    size_t size() const;
+
+    // Set visible[i] to 1 if object i (conservatively) intersects the frustum and to 0 otherwise.
+    // The visibility list is resized to size().
+    void cull(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+
+private:
+    size_t m_size { 0 };
+    // Box center and (positive) half extent
+    std::vector<float> m_centerX, m_centerY, m_centerZ;
+    std::vector<float> m_extentX, m_extentY, m_extentZ;
+    std::vector<float> m_sphereX, m_sphereY, m_sphereZ, m_sphereRadius;
+};
@@ -0,0 +1,222 @@
+#include "deferred_shading.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/gtc/constants.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+// Resolution of the light volume sphere
+static constexpr int SPHERE_SLICES = 16;
+static constexpr int SPHERE_STACKS = 12;
+
+// Cone that covers the whole sphere, such that point lights can be shaded as spot lights
+static constexpr float POINT_LIGHT_INNER_CUTOFF = -1.0f;
+static constexpr float POINT_LIGHT_OUTER_CUTOFF = -2.0f;
+
+GBuffer::~GBuffer()
+{
+    freeGpuMemory();
+}
+
+void GBuffer::bindForGeometryPass(const glm::ivec2& size)
+{
+    if (size != m_size)
+        resize(size);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClearDepth(1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::blitDepthToDefaultFramebuffer() const
+{
+    // Requires the default framebuffer to have a matching depth format (24-bit depth, 8-bit stencil on common drivers)
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, m_size.x, m_size.y, 0, 0, m_size.x, m_size.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::bindTextures(const Shader& shader) const
+{
+    constexpr std::array<GLint, 4> textureUnits { POSITION_TEXTURE_UNIT, NORMAL_TEXTURE_UNIT, ALBEDO_TEXTURE_UNIT, SPECULAR_TEXTURE_UNIT };
+    for (size_t i = 0; i < m_textures.size(); i++) {
+        glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(textureUnits[i]));
+        glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+    }
+    shader.setUniform("gPosition", POSITION_TEXTURE_UNIT);
+    shader.setUniform("gNormal", NORMAL_TEXTURE_UNIT);
+    shader.setUniform("gAlbedo", ALBEDO_TEXTURE_UNIT);
+    shader.setUniform("gSpecular", SPECULAR_TEXTURE_UNIT);
+}
+
+void GBuffer::resize(const glm::ivec2& size)
+{
+    freeGpuMemory();
+    m_size = size;
+
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+
+    // Positions need full precision, shininess does not fit in an 8-bit channel
+    constexpr std::array<GLenum, 4> internalFormats { GL_RGBA32F, GL_RGBA16F, GL_RGBA8, GL_RGBA16F };
+    glGenTextures(static_cast<GLsizei>(m_textures.size()), m_textures.data());
+    for (size_t i = 0; i < m_textures.size(); i++) {
+        glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(internalFormats[i]), size.x, size.y, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i), GL_TEXTURE_2D, m_textures[i], 0);
+    }
+    constexpr std::array<GLenum, 4> drawBuffers { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+    glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+
+    glGenRenderbuffers(1, &m_depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.x, size.y);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("G-buffer framebuffer is incomplete");
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::freeGpuMemory()
+{
+    if (m_fbo != INVALID)
+        glDeleteFramebuffers(1, &m_fbo);
+    if (m_textures[0] != INVALID)
+        glDeleteTextures(static_cast<GLsizei>(m_textures.size()), m_textures.data());
+    if (m_depthRenderbuffer != INVALID)
+        glDeleteRenderbuffers(1, &m_depthRenderbuffer);
+    m_fbo = INVALID;
+    m_textures.fill(INVALID);
+    m_depthRenderbuffer = INVALID;
+}
+
+LightVolumes::LightVolumes()
+{
+    // UV sphere whose faces lie outside of the unit sphere, such that the volume never cuts off any lit pixels
+    const float inflation = 1.0f / (std::cos(glm::pi<float>() / SPHERE_SLICES) * std::cos(glm::pi<float>() / (2 * SPHERE_STACKS)));
+    std::vector<glm::vec3> vertices;
+    for (int stack = 0; stack <= SPHERE_STACKS; stack++) {
+        const float theta = glm::pi<float>() * float(stack) / float(SPHERE_STACKS);
+        for (int slice = 0; slice <= SPHERE_SLICES; slice++) {
+            const float phi = 2.0f * glm::pi<float>() * float(slice) / float(SPHERE_SLICES);
+            vertices.push_back(inflation * glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+        }
+    }
+    std::vector<uint32_t> indices;
+    for (int stack = 0; stack < SPHERE_STACKS; stack++) {
+        for (int slice = 0; slice < SPHERE_SLICES; slice++) {
+            const uint32_t topLeft = uint32_t(stack * (SPHERE_SLICES + 1) + slice);
+            const uint32_t bottomLeft = topLeft + SPHERE_SLICES + 1;
+            indices.insert(std::end(indices), { topLeft, topLeft + 1, bottomLeft, bottomLeft, topLeft + 1, bottomLeft + 1 });
+        }
+    }
+    m_numSphereIndices = static_cast<GLsizei>(indices.size());
+
+    glGenBuffers(1, &m_instanceVbo);
+    glGenVertexArrays(1, &m_fullscreenVao);
+
+    glGenVertexArrays(1, &m_volumeVao);
+    glBindVertexArray(m_volumeVao);
+    glGenBuffers(1, &m_sphereVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_sphereVbo);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3)), vertices.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &m_sphereIbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_sphereIbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(uint32_t)), indices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+    glVertexAttribDivisor(0, 0);
+    glBindVertexArray(0);
+}
+
+LightVolumes::~LightVolumes()
+{
+    freeGpuMemory();
+}
+
+void LightVolumes::update(std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights, std::span<const DirectionalLight> directionalLights)
+{
+    // Volumes first, then the directional lights
+    m_instances.clear();
+    for (const PointLight& light : pointLights) {
+        const float radius = utils::math::getAttenuationRadius(light.attenuationCoefficients, maxIntensity(light));
+        m_instances.push_back({ glm::vec4(light.position, radius), glm::vec3(0, 0, 1), light.diffuseColor, light.specularColor,
+            glm::vec4(light.attenuationCoefficients, POINT_LIGHT_INNER_CUTOFF, POINT_LIGHT_OUTER_CUTOFF) });
+    }
+    for (const SpotLight& light : spotLights) {
+        const float radius = utils::math::getAttenuationRadius(light.attenuationCoefficients, maxIntensity(light));
+        m_instances.push_back({ glm::vec4(light.position, radius), light.direction, light.diffuseColor, light.specularColor,
+            glm::vec4(light.attenuationCoefficients, glm::cos(light.innerCutoffAngle), glm::cos(light.outerCutoffAngle)) });
+    }
+    for (const DirectionalLight& light : directionalLights) {
+        m_instances.push_back({ glm::vec4(0.0f), light.direction, light.diffuseColor, light.specularColor, glm::vec4(0.0f) });
+    }
+    m_numVolumeInstances = static_cast<GLsizei>(pointLights.size() + spotLights.size());
+    m_numDirectionalInstances = static_cast<GLsizei>(directionalLights.size());
+
+    // Re-specifying the whole buffer lets the driver orphan last frame's storage instead of stalling on it.
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_instances.size() * sizeof(GPULightVolume)), m_instances.data(), GL_STREAM_DRAW);
+
+    // GL 4.1 has no base instance, so the directional lights are reached by offsetting their attribute pointers
+    glBindVertexArray(m_volumeVao);
+    setupInstanceAttributes(0);
+    glBindVertexArray(m_fullscreenVao);
+    setupInstanceAttributes(static_cast<GLintptr>(m_numVolumeInstances) * static_cast<GLintptr>(sizeof(GPULightVolume)));
+    glBindVertexArray(0);
+}
+
+void LightVolumes::drawPointAndSpotLights() const
+{
+    if (m_numVolumeInstances == 0)
+        return;
+    glBindVertexArray(m_volumeVao);
+    glDrawElementsInstanced(GL_TRIANGLES, m_numSphereIndices, GL_UNSIGNED_INT, nullptr, m_numVolumeInstances);
+}
+
+void LightVolumes::drawDirectionalLights() const
+{
+    if (m_numDirectionalInstances == 0)
+        return;
+    // One triangle covering the screen, positions are generated from gl_VertexID
+    glBindVertexArray(m_fullscreenVao);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 3, m_numDirectionalInstances);
+}
+
+void LightVolumes::setupInstanceAttributes(GLintptr baseOffset) const
+{
+    // Locations 1 to 5, advanced once per instance
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+    const auto attribute = [&](GLuint location, GLint size, size_t offset) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, sizeof(GPULightVolume), (void*)(baseOffset + static_cast<GLintptr>(offset)));
+        glVertexAttribDivisor(location, 1);
+    };
+    attribute(1, 4, offsetof(GPULightVolume, positionAndRadius));
+    attribute(2, 3, offsetof(GPULightVolume, direction));
+    attribute(3, 3, offsetof(GPULightVolume, diffuseColor));
+    attribute(4, 3, offsetof(GPULightVolume, specularColor));
+    attribute(5, 4, offsetof(GPULightVolume, attenuationAndCutoffs));
+}
+
+void LightVolumes::freeGpuMemory()
+{
+    if (m_volumeVao != INVALID)
+        glDeleteVertexArrays(1, &m_volumeVao);
+    if (m_fullscreenVao != INVALID)
+        glDeleteVertexArrays(1, &m_fullscreenVao);
+    if (m_sphereVbo != INVALID)
+        glDeleteBuffers(1, &m_sphereVbo);
+    if (m_sphereIbo != INVALID)
+        glDeleteBuffers(1, &m_sphereIbo);
+    if (m_instanceVbo != INVALID)
+        glDeleteBuffers(1, &m_instanceVbo);
+}
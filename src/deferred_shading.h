@@ -0,0 +1,101 @@
+#pragma once
+
+#include "light.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/opengl_includes.h>
+#include <framework/shader.h>
+
+#include <array>
+#include <span>
+#include <vector>
+
+// Render targets of the deferred path: world-space position, world-space normal, albedo and specular color with
+// shininess, plus a depth buffer that is copied to the default framebuffer for the forward passes that follow.
+class GBuffer {
+public:
+    // Texture units of the render targets while they are read by the lighting passes
+    static constexpr GLint POSITION_TEXTURE_UNIT = 0;
+    static constexpr GLint NORMAL_TEXTURE_UNIT = 1;
+    static constexpr GLint ALBEDO_TEXTURE_UNIT = 2;
+    static constexpr GLint SPECULAR_TEXTURE_UNIT = 3;
+
+    GBuffer() = default;
+    GBuffer(const GBuffer&) = delete;
+    GBuffer(GBuffer&&) = delete;
+    ~GBuffer();
+
+    GBuffer& operator=(const GBuffer&) = delete;
+    GBuffer& operator=(GBuffer&&) = delete;
+
+    // Bind the G-buffer as draw framebuffer and clear it; (re)creates the render targets when the size changed.
+    void bindForGeometryPass(const glm::ivec2& size);
+    // Copy the depth buffer into the default framebuffer and bind that again for the lighting passes.
+    void blitDepthToDefaultFramebuffer() const;
+    // Bind the render targets to their texture units and set the sampler uniforms of a lighting shader.
+    void bindTextures(const Shader& shader) const;
+
+private:
+    void resize(const glm::ivec2& size);
+    void freeGpuMemory();
+
+private:
+    static constexpr GLuint INVALID = 0xFFFFFFFF;
+
+    glm::ivec2 m_size { 0 };
+    GLuint m_fbo { INVALID };
+    std::array<GLuint, 4> m_textures { INVALID, INVALID, INVALID, INVALID }; // Position, normal, albedo and specular
+    GLuint m_depthRenderbuffer { INVALID };
+};
+
+// Per-instance attributes of a light volume, must match the inputs of deferred_light_vert.glsl.
+struct GPULightVolume {
+    glm::vec4 positionAndRadius;
+    glm::vec3 direction;
+    glm::vec3 diffuseColor;
+    glm::vec3 specularColor;
+    glm::vec4 attenuationAndCutoffs; // Linear and quadratic attenuation, cosine of the inner and outer cutoff angle
+};
+
+// Light geometry of the deferred lighting passes. Point and spot lights are drawn as instanced spheres sized by their
+// attenuation radius, so each light only shades the pixels it can reach. Directional lights reach every pixel and
+// are drawn as instanced full-screen triangles.
+class LightVolumes {
+public:
+    LightVolumes();
+    LightVolumes(const LightVolumes&) = delete;
+    LightVolumes(LightVolumes&&) = delete;
+    ~LightVolumes();
+
+    LightVolumes& operator=(const LightVolumes&) = delete;
+    LightVolumes& operator=(LightVolumes&&) = delete;
+
+    void update(std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights, std::span<const DirectionalLight> directionalLights);
+
+    // Bind the vertex arrays and draw every light of the kind once.
+    void drawPointAndSpotLights() const;
+    void drawDirectionalLights() const;
+
+private:
+    void setupInstanceAttributes(GLintptr baseOffset) const;
+    void freeGpuMemory();
+
+private:
+    static constexpr GLuint INVALID = 0xFFFFFFFF;
+
+    std::vector<GPULightVolume> m_instances;
+    GLsizei m_numVolumeInstances { 0 };
+    GLsizei m_numDirectionalInstances { 0 };
+    GLsizei m_numSphereIndices { 0 };
+
+    GLuint m_sphereVbo { INVALID };
+    GLuint m_sphereIbo { INVALID };
+    GLuint m_instanceVbo { INVALID };
+    GLuint m_volumeVao { INVALID };
+    GLuint m_fullscreenVao { INVALID };
+};
@@ -0,0 +1,148 @@
+#include "gpu_driven.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <GLFW/glfw3.h>
+#include <glm/gtc/type_ptr.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+#ifndef GL_PARAMETER_BUFFER
+#define GL_PARAMETER_BUFFER 0x80EE
+#endif
+
+// Layouts of the std430 storage buffers of gpu_cull_comp.glsl
+struct GPUCullObject {
+    glm::vec4 boundingSphere; // Object space center and radius
+    GLuint mesh;
+    GLuint bucket;
+    GLuint padding[2];
+};
+struct GPUCullMesh {
+    GLuint numIndices;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint padding;
+};
+static_assert(sizeof(GPUCullObject) == 32 && sizeof(GPUCullMesh) == 16 && sizeof(DrawElementsIndirectCommand) == 20);
+
+GpuDrivenScene::GpuDrivenScene()
+{
+    // Only available when the driver supports it; otherwise every bucket draws its full command range, in which
+    // the commands of culled renderables are left zeroed (zero instances)
+    m_multiDrawElementsIndirectCount = reinterpret_cast<PFNMultiDrawElementsIndirectCount>(glfwGetProcAddress("glMultiDrawElementsIndirectCount"));
+    if (!m_multiDrawElementsIndirectCount)
+        m_multiDrawElementsIndirectCount = reinterpret_cast<PFNMultiDrawElementsIndirectCount>(glfwGetProcAddress("glMultiDrawElementsIndirectCountARB"));
+}
+
+GpuDrivenScene::~GpuDrivenScene()
+{
+    freeGpuMemory();
+}
+
+void GpuDrivenScene::build(std::span<const Renderable> renderables)
+{
+    // Renderables with the same pass, textures and mesh (which owns the material) can share a bucket
+    using BucketKey = std::tuple<RenderPass, const Texture*, const Texture*, const GPUMesh*>;
+    std::map<BucketKey, GLuint> bucketIndices;
+    std::map<const GPUMesh*, GLuint> meshIndices;
+    std::vector<GPUCullObject> objects;
+    std::vector<GPUCullMesh> meshes;
+    m_buckets.clear();
+    for (const Renderable& renderable : renderables) {
+        const RenderPass pass = renderable.drawMode == DrawingMode::Reflective ? RenderPass::Reflective : RenderPass::Opaque;
+        const BucketKey key { pass, renderable.diffuseMap ? &renderable.diffuseMap.value() : nullptr,
+            renderable.normalMap ? &renderable.normalMap.value() : nullptr, renderable.mesh.get() };
+        const auto [bucketIter, newBucket] = bucketIndices.try_emplace(key, static_cast<GLuint>(m_buckets.size()));
+        if (newBucket)
+            m_buckets.push_back({ pass, &renderable, 0, 0 });
+        m_buckets[bucketIter->second].numRenderables++;
+
+        const auto [meshIter, newMesh] = meshIndices.try_emplace(renderable.mesh.get(), static_cast<GLuint>(meshes.size()));
+        if (newMesh) {
+            const MeshArena::Allocation& allocation = renderable.mesh->allocation();
+            meshes.push_back({ allocation.numIndices, allocation.firstIndex, static_cast<GLint>(allocation.firstVertex), 0 });
+        }
+
+        const BoundingSphere& sphere = renderable.mesh->boundingSphere();
+        objects.push_back({ glm::vec4(sphere.center, sphere.radius), meshIter->second, bucketIter->second, { 0, 0 } });
+    }
+
+    // Every bucket gets a command range large enough for all of its renderables
+    std::vector<GLuint> firstCommands;
+    GLuint numCommands = 0;
+    for (Bucket& bucket : m_buckets) {
+        bucket.firstCommand = numCommands;
+        firstCommands.push_back(numCommands);
+        numCommands += bucket.numRenderables;
+    }
+    m_numRenderables = renderables.size();
+
+    freeGpuMemory();
+    const auto createBuffer = [](GLuint& buffer, size_t size, const void* pData) {
+        glCreateBuffers(1, &buffer);
+        // Zero sized buffers cannot be bound
+        glNamedBufferStorage(buffer, static_cast<GLsizeiptr>(std::max(size, size_t(4))), size ? pData : nullptr, 0);
+    };
+    createBuffer(m_objectBuffer, objects.size() * sizeof(GPUCullObject), objects.data());
+    createBuffer(m_meshBuffer, meshes.size() * sizeof(GPUCullMesh), meshes.data());
+    createBuffer(m_bucketBuffer, firstCommands.size() * sizeof(GLuint), firstCommands.data());
+    createBuffer(m_drawCountBuffer, m_buckets.size() * sizeof(GLuint), nullptr);
+    createBuffer(m_commandBuffer, numCommands * sizeof(DrawElementsIndirectCommand), nullptr);
+}
+
+void GpuDrivenScene::cull(const Shader& cullShader, const Frustum& frustum, std::span<const glm::mat4> modelMatrices, std::span<const glm::mat3> normalModelMatrices)
+{
+    m_instanceBuffer.update(modelMatrices, normalModelMatrices);
+
+    glClearNamedBufferData(m_drawCountBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    if (!m_multiDrawElementsIndirectCount)
+        glClearNamedBufferData(m_commandBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    cullShader.bind();
+    cullShader.setUniform("numObjects", static_cast<int>(m_numRenderables));
+    glUniform4fv(cullShader.getUniformLocation("frustumPlanes"), static_cast<GLsizei>(frustum.planes.size()), glm::value_ptr(frustum.planes[0]));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ObjectsBinding, m_objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MeshesBinding, m_meshBuffer);
+    m_instanceBuffer.bindStorageBuffer(InstancesBinding);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BucketsBinding, m_bucketBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawCountsBinding, m_drawCountBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandsBinding, m_commandBuffer);
+    glDispatchCompute(static_cast<GLuint>((m_numRenderables + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE), 1, 1);
+    // The draws below read the commands and counts as indirect arguments
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+std::span<const GpuDrivenScene::Bucket> GpuDrivenScene::buckets() const
+{
+    return m_buckets;
+}
+
+void GpuDrivenScene::drawBucket(size_t bucketIdx) const
+{
+    const Bucket& bucket = m_buckets[bucketIdx];
+    // All renderables of a bucket share their mesh, and thus its index type
+    const GLenum indexType = bucket.pRenderable->mesh->allocation().indexType;
+    // Each command selects its renderable's matrices with its base instance
+    m_instanceBuffer.enableAttributes(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+    const void* pFirstCommand = (const void*)(bucket.firstCommand * sizeof(DrawElementsIndirectCommand));
+    if (m_multiDrawElementsIndirectCount) {
+        glBindBuffer(GL_PARAMETER_BUFFER, m_drawCountBuffer);
+        m_multiDrawElementsIndirectCount(GL_TRIANGLES, indexType, pFirstCommand, static_cast<GLintptr>(bucketIdx * sizeof(GLuint)),
+            static_cast<GLsizei>(bucket.numRenderables), 0);
+    } else {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, pFirstCommand, static_cast<GLsizei>(bucket.numRenderables), 0);
+    }
+    m_instanceBuffer.disableAttributes();
+}
+
+void GpuDrivenScene::freeGpuMemory()
+{
+    for (GLuint* pBuffer : { &m_objectBuffer, &m_meshBuffer, &m_bucketBuffer, &m_drawCountBuffer, &m_commandBuffer }) {
+        if (*pBuffer != INVALID)
+            glDeleteBuffers(1, pBuffer);
+        *pBuffer = INVALID;
+    }
+}
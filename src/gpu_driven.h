@@ -0,0 +1,89 @@
+#pragma once
+
+#include "culling.h"
+#include "instancing.h"
+#include "render_queue.h"
+#include "renderable.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/opengl_includes.h>
+#include <framework/shader.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Matches "DrawElementsIndirectCommand" of the GL spec and of gpu_cull_comp.glsl.
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// GPU-driven submission (requires an OpenGL 4.5 context). Every renderable is uploaded once when the scene changes;
+// each frame a compute shader frustum culls all of them and appends a draw command for every visible one to the
+// command range of its bucket. A bucket holds the renderables that share a pass, textures and material, and is
+// drawn with a single multi-draw indirect call whose draw count is read from GPU memory. The CPU cost per frame
+// thus depends on the number of buckets instead of the number of renderables.
+class GpuDrivenScene {
+public:
+    struct Bucket {
+        RenderPass pass;
+        const Renderable* pRenderable; // Any renderable of the bucket, for its textures and material
+        GLuint firstCommand;
+        GLuint numRenderables;
+    };
+
+    GpuDrivenScene();
+    GpuDrivenScene(const GpuDrivenScene&) = delete;
+    GpuDrivenScene(GpuDrivenScene&&) = delete;
+    ~GpuDrivenScene();
+
+    GpuDrivenScene& operator=(const GpuDrivenScene&) = delete;
+    GpuDrivenScene& operator=(GpuDrivenScene&&) = delete;
+
+    // Upload bounds, meshes and bucket layout; has to be called again whenever renderables are added or removed.
+    void build(std::span<const Renderable> renderables);
+    // Upload this frame's matrices (indexed by draw ID) and generate the draw commands of the visible renderables.
+    void cull(const Shader& cullShader, const Frustum& frustum, std::span<const glm::mat4> modelMatrices, std::span<const glm::mat3> normalModelMatrices);
+
+    std::span<const Bucket> buckets() const;
+    // Draw the visible renderables of a bucket with the bound program and vertex array.
+    void drawBucket(size_t bucket) const;
+
+private:
+    void freeGpuMemory();
+
+private:
+    // glMultiDrawElementsIndirectCount is core in OpenGL 4.6 (or ARB_indirect_parameters), beyond what GLAD loads
+    using PFNMultiDrawElementsIndirectCount = void(APIENTRYP)(GLenum mode, GLenum type, const void* indirect, GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride);
+
+    // Storage buffer bindings of gpu_cull_comp.glsl
+    enum StorageBinding : GLuint {
+        ObjectsBinding = 0,
+        MeshesBinding,
+        InstancesBinding,
+        BucketsBinding,
+        DrawCountsBinding,
+        CommandsBinding
+    };
+    static constexpr GLuint WORKGROUP_SIZE = 64;
+    static constexpr GLuint INVALID = 0xFFFFFFFF;
+
+    PFNMultiDrawElementsIndirectCount m_multiDrawElementsIndirectCount { nullptr };
+
+    std::vector<Bucket> m_buckets;
+    size_t m_numRenderables { 0 };
+    InstanceBuffer m_instanceBuffer;
+    GLuint m_objectBuffer { INVALID };
+    GLuint m_meshBuffer { INVALID };
+    GLuint m_bucketBuffer { INVALID };
+    GLuint m_drawCountBuffer { INVALID };
+    GLuint m_commandBuffer { INVALID };
+};
@@ -0,0 +1,71 @@
+#include "instancing.h"
+#include <cstddef>
+
+static_assert(sizeof(GPUInstanceData) == 100);
+
+InstanceBuffer::InstanceBuffer()
+{
+    glGenBuffers(1, &m_vbo);
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+    freeGpuMemory();
+}
+
+void InstanceBuffer::update(std::span<const DrawItem> items, std::span<const glm::mat4> modelMatrices, std::span<const glm::mat3> normalModelMatrices)
+{
+    m_instances.resize(items.size());
+    for (size_t i = 0; i < items.size(); i++)
+        m_instances[i] = { modelMatrices[items[i].drawID], normalModelMatrices[items[i].drawID] };
+    upload();
+}
+
+void InstanceBuffer::update(std::span<const glm::mat4> modelMatrices, std::span<const glm::mat3> normalModelMatrices)
+{
+    m_instances.resize(modelMatrices.size());
+    for (size_t i = 0; i < modelMatrices.size(); i++)
+        m_instances[i] = { modelMatrices[i], normalModelMatrices[i] };
+    upload();
+}
+
+void InstanceBuffer::bindStorageBuffer(GLuint binding) const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_vbo);
+}
+
+void InstanceBuffer::upload()
+{
+    // Re-specifying the whole buffer lets the driver orphan last frame's storage instead of stalling on it.
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_instances.size() * sizeof(GPUInstanceData)), m_instances.data(), GL_STREAM_DRAW);
+}
+
+void InstanceBuffer::enableAttributes(size_t firstInstance) const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    const size_t baseOffset = firstInstance * sizeof(GPUInstanceData);
+    const auto attribute = [&](GLuint location, GLint size, size_t offset) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, sizeof(GPUInstanceData), (void*)(baseOffset + offset));
+        glVertexAttribDivisor(location, 1);
+    };
+    // Matrix attributes take one location per column
+    for (GLuint column = 0; column < 4; column++)
+        attribute(FIRST_ATTRIBUTE_LOCATION + column, 4, offsetof(GPUInstanceData, modelMatrix) + column * sizeof(glm::vec4));
+    for (GLuint column = 0; column < 3; column++)
+        attribute(FIRST_ATTRIBUTE_LOCATION + 4 + column, 3, offsetof(GPUInstanceData, normalModelMatrix) + column * sizeof(glm::vec3));
+}
+
+void InstanceBuffer::disableAttributes() const
+{
+    // Non-instanced draws of the same vertex array must not read from the instance buffer
+    for (GLuint location = FIRST_ATTRIBUTE_LOCATION; location < FIRST_ATTRIBUTE_LOCATION + NUM_ATTRIBUTE_LOCATIONS; location++)
+        glDisableVertexAttribArray(location);
+}
+
+void InstanceBuffer::freeGpuMemory()
+{
+    if (m_vbo != INVALID)
+        glDeleteBuffers(1, &m_vbo);
+}
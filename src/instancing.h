@@ -0,0 +1,55 @@
+#pragma once
+
+#include "render_queue.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/opengl_includes.h>
+
+#include <span>
+#include <vector>
+
+// Per-instance vertex attributes, must match the instance inputs of the vertex shaders.
+struct GPUInstanceData {
+    glm::mat4 modelMatrix; // Locations 3 to 6
+    glm::mat3 normalModelMatrix; // Locations 7 to 9
+};
+
+// Vertex buffer with the matrices of every draw of the frame, in render queue order. Consecutive queue items that
+// share their mesh and textures are drawn as one instanced draw reading a contiguous range of this buffer.
+class InstanceBuffer {
+public:
+    static constexpr GLuint FIRST_ATTRIBUTE_LOCATION = 3; // After position, normal and texture coordinates
+
+    InstanceBuffer();
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer(InstanceBuffer&&) = delete;
+    ~InstanceBuffer();
+
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(InstanceBuffer&&) = delete;
+
+    // Matrices are indexed by the draw IDs of the items.
+    void update(std::span<const DrawItem> items, std::span<const glm::mat4> modelMatrices, std::span<const glm::mat3> normalModelMatrices);
+    // One instance per draw ID instead, for draws that select their instance by base instance (OpenGL 4.2+).
+    void update(std::span<const glm::mat4> modelMatrices, std::span<const glm::mat3> normalModelMatrices);
+    // Bind the instances as a shader storage buffer of floats (OpenGL 4.3+).
+    void bindStorageBuffer(GLuint binding) const;
+
+    // Point the instance attributes of the bound vertex array at the given instance (GL 4.1 has no base instance).
+    void enableAttributes(size_t firstInstance) const;
+    void disableAttributes() const;
+
+private:
+    void upload();
+    void freeGpuMemory();
+
+private:
+    static constexpr GLuint INVALID = 0xFFFFFFFF;
+    static constexpr GLuint NUM_ATTRIBUTE_LOCATIONS = 7;
+
+    std::vector<GPUInstanceData> m_instances;
+    GLuint m_vbo { INVALID };
+};
@@ -0,0 +1,52 @@
+#include "level_of_detail.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+
+void LodSelection::update(std::span<const Renderable> renderables, std::span<const uint8_t> visibleRenderables,
+    std::span<const glm::mat4> modelMatrices, const glm::vec3& cameraPosition, float pixelsPerUnit, float maxErrorPixels)
+{
+    m_levels.assign(renderables.size(), 0);
+    m_numTriangles = m_numFullDetailTriangles = 0;
+
+    for (size_t drawID = 0; drawID < renderables.size(); drawID++) {
+        if (!visibleRenderables[drawID])
+            continue;
+        const GPUMesh& mesh = *renderables[drawID].mesh;
+        m_numFullDetailTriangles += mesh.numTriangles();
+
+        // The error and bounding sphere scale with the largest axis of the model matrix
+        const glm::mat4& modelMatrix = modelMatrices[drawID];
+        const float scale = std::max({ glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2])) });
+        const glm::vec3 center = modelMatrix * glm::vec4(mesh.boundingSphere().center, 1.0f);
+        const float distance = glm::length(center - cameraPosition) - scale * mesh.boundingSphere().radius;
+
+        uint32_t lod = 0;
+        if (distance > 0.0f) {
+            const float pixelsPerObjectUnit = scale * pixelsPerUnit / distance;
+            // The errors grow with the level, so the first level that is too coarse ends the search
+            while (lod + 1 < mesh.numLods() && mesh.lodError(lod + 1) * pixelsPerObjectUnit <= maxErrorPixels)
+                lod++;
+        }
+        m_levels[drawID] = lod;
+        m_numTriangles += mesh.numTriangles(lod);
+    }
+}
+
+uint32_t LodSelection::level(uint32_t drawID) const
+{
+    return drawID < m_levels.size() ? m_levels[drawID] : 0;
+}
+
+size_t LodSelection::numTriangles() const
+{
+    return m_numTriangles;
+}
+
+size_t LodSelection::numFullDetailTriangles() const
+{
+    return m_numFullDetailTriangles;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "renderable.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Per-frame selection of the level of detail of every visible renderable (see GPUMesh::numLods()): the coarsest level
+// whose object space error, projected onto the screen at the point of the bounding sphere closest to the camera, is at
+// most the given number of pixels. Renderables whose mesh has no simplified levels always use level 0.
+class LodSelection {
+public:
+    // pixelsPerUnit is the size in pixels of one unit at distance one along the view direction:
+    // 0.5 * viewportHeight * projectionMatrix[1][1] for a perspective projection.
+    void update(std::span<const Renderable> renderables, std::span<const uint8_t> visibleRenderables,
+        std::span<const glm::mat4> modelMatrices, const glm::vec3& cameraPosition, float pixelsPerUnit, float maxErrorPixels);
+
+    uint32_t level(uint32_t drawID) const;
+
+    // Of the visible renderables, at the selected levels and at full detail.
+    size_t numTriangles() const;
+    size_t numFullDetailTriangles() const;
+
+private:
+    std::vector<uint32_t> m_levels;
+    size_t m_numTriangles { 0 };
+    size_t m_numFullDetailTriangles { 0 };
+};
@@ -0,0 +1,161 @@
+#include "light.h"
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(GPUPointLight) == 48 && offsetof(GPUPointLight, quadraticAttenuationCoeff) == 28);
+static_assert(sizeof(GPUSpotLight) == 80 && offsetof(GPUSpotLight, diffuseColor) == 48);
+static_assert(sizeof(GPUDirectionalLight) == 48);
+static_assert(sizeof(GPUAllLights) <= 16384, "GL only guarantees uniform blocks of 16KB");
+
+GPUPointLight::GPUPointLight(const PointLight& light)
+    : position(light.position)
+    , linearAttenuationCoeff(light.attenuationCoefficients.x)
+    , diffuseColor(light.diffuseColor)
+    , quadraticAttenuationCoeff(light.attenuationCoefficients.y)
+    , specularColor(light.specularColor)
+{
+}
+
+GPUSpotLight::GPUSpotLight(const SpotLight& light)
+    : position(light.position)
+    , innerCutoff(glm::cos(light.innerCutoffAngle))
+    , direction(light.direction)
+    , outerCutoff(glm::cos(light.outerCutoffAngle))
+    , linearAttenuationCoeff(light.attenuationCoefficients.x)
+    , quadraticAttenuationCoeff(light.attenuationCoefficients.y)
+    , diffuseColor(light.diffuseColor)
+    , specularColor(light.specularColor)
+{
+}
+
+GPUDirectionalLight::GPUDirectionalLight(const DirectionalLight& light)
+    : direction(light.direction)
+    , diffuseColor(light.diffuseColor)
+    , specularColor(light.specularColor)
+{
+}
+
+LightBuffer::LightBuffer()
+{
+    GLint offsetAlignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    const GLsizeiptr maxBatchSize = static_cast<GLsizeiptr>(std::max({ sizeof(PointLightBatch), sizeof(SpotLightBatch), sizeof(DirectionalLightBatch) }));
+    m_batchStride = (maxBatchSize + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+
+    glGenBuffers(1, &m_ubo);
+}
+
+LightBuffer::LightBuffer(LightBuffer&& other)
+    : m_ubo(other.m_ubo)
+    , m_batchStride(other.m_batchStride)
+    , m_staging(std::move(other.m_staging))
+    , m_pointRegion(other.m_pointRegion)
+    , m_spotRegion(other.m_spotRegion)
+    , m_directionalRegion(other.m_directionalRegion)
+    , m_allLightsOffset(other.m_allLightsOffset)
+{
+    other.m_ubo = INVALID;
+}
+
+LightBuffer::~LightBuffer()
+{
+    freeGpuMemory();
+}
+
+LightBuffer& LightBuffer::operator=(LightBuffer&& other)
+{
+    freeGpuMemory();
+    m_ubo = other.m_ubo;
+    m_batchStride = other.m_batchStride;
+    m_staging = std::move(other.m_staging);
+    m_pointRegion = other.m_pointRegion;
+    m_spotRegion = other.m_spotRegion;
+    m_directionalRegion = other.m_directionalRegion;
+    m_allLightsOffset = other.m_allLightsOffset;
+    other.m_ubo = INVALID;
+    return *this;
+}
+
+void LightBuffer::update(std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights, std::span<const DirectionalLight> directionalLights)
+{
+    m_staging.clear();
+    m_pointRegion = appendBatches<GPUPointLight, utils::globals::shader_preprocessor_params::MAX_NUM_POINT_LIGHT>(pointLights);
+    m_spotRegion = appendBatches<GPUSpotLight, utils::globals::shader_preprocessor_params::MAX_NUM_SPOT_LIGHT>(spotLights);
+    m_directionalRegion = appendBatches<GPUDirectionalLight, utils::globals::shader_preprocessor_params::MAX_NUM_DIR_LIGHT>(directionalLights);
+
+    GPUAllLights allLights;
+    for (const PointLight& light : pointLights.first(std::min<size_t>(pointLights.size(), std::size(allLights.pointLights))))
+        allLights.pointLights[allLights.numPointLights++] = light;
+    for (const SpotLight& light : spotLights.first(std::min<size_t>(spotLights.size(), std::size(allLights.spotLights))))
+        allLights.spotLights[allLights.numSpotLights++] = light;
+    for (const DirectionalLight& light : directionalLights.first(std::min<size_t>(directionalLights.size(), std::size(allLights.dirLights))))
+        allLights.dirLights[allLights.numDirLights++] = light;
+    m_allLightsOffset = static_cast<GLintptr>(m_staging.size());
+    m_staging.resize(m_staging.size() + sizeof(allLights));
+    std::memcpy(m_staging.data() + m_allLightsOffset, &allLights, sizeof(allLights));
+
+    // Re-specifying the whole buffer lets the driver orphan last frame's storage instead of stalling on it.
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(m_staging.size()), m_staging.data(), GL_STREAM_DRAW);
+}
+
+size_t LightBuffer::numPointLightBatches() const
+{
+    return m_pointRegion.numBatches;
+}
+
+size_t LightBuffer::numSpotLightBatches() const
+{
+    return m_spotRegion.numBatches;
+}
+
+size_t LightBuffer::numDirectionalLightBatches() const
+{
+    return m_directionalRegion.numBatches;
+}
+
+void LightBuffer::bindPointLightBatch(const Shader& shader, size_t batch) const
+{
+    bindBatch(shader, m_pointRegion, batch, sizeof(PointLightBatch));
+}
+
+void LightBuffer::bindSpotLightBatch(const Shader& shader, size_t batch) const
+{
+    bindBatch(shader, m_spotRegion, batch, sizeof(SpotLightBatch));
+}
+
+void LightBuffer::bindDirectionalLightBatch(const Shader& shader, size_t batch) const
+{
+    bindBatch(shader, m_directionalRegion, batch, sizeof(DirectionalLightBatch));
+}
+
+void LightBuffer::bindAllLights(const Shader& shader) const
+{
+    shader.bindUniformBlock("AllLights", BINDING, m_ubo, m_allLightsOffset, sizeof(GPUAllLights));
+}
+
+template <typename GPULight, size_t MaxLights, typename CPULight>
+LightBuffer::Region LightBuffer::appendBatches(std::span<const CPULight> lights)
+{
+    Region region { static_cast<GLintptr>(m_staging.size()), (lights.size() + MaxLights - 1) / MaxLights };
+    m_staging.resize(m_staging.size() + region.numBatches * static_cast<size_t>(m_batchStride));
+
+    for (size_t batchIdx = 0; batchIdx < region.numBatches; batchIdx++) {
+        GPULightBatch<GPULight, MaxLights> batch;
+        for (size_t i = batchIdx * MaxLights; i < std::min(lights.size(), (batchIdx + 1) * MaxLights); i++)
+            batch.lights[batch.numLights++] = GPULight(lights[i]);
+        std::memcpy(m_staging.data() + static_cast<size_t>(region.offset) + batchIdx * static_cast<size_t>(m_batchStride), &batch, sizeof(batch));
+    }
+    return region;
+}
+
+void LightBuffer::bindBatch(const Shader& shader, const Region& region, size_t batch, GLsizeiptr batchSize) const
+{
+    shader.bindUniformBlock("Lights", BINDING, m_ubo, region.offset + static_cast<GLintptr>(batch) * m_batchStride, batchSize);
+}
+
+void LightBuffer::freeGpuMemory()
+{
+    if (m_ubo != INVALID)
+        glDeleteBuffers(1, &m_ubo);
+}
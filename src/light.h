@@ -0,0 +1,203 @@
+#pragma once
+
+#include "utils.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/opengl_includes.h>
+#include <framework/shader.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// Light types that are shaded in batches by the multi-pass forward path
+enum class LightType {
+    Point,
+    Spot
+};
+
+struct Light {
+    glm::vec3 diffuseColor;
+    glm::vec3 specularColor;
+    StateType lightType;
+};
+
+// Brightest color channel of a light, which determines how far its attenuated contribution remains visible
+inline float maxIntensity(const Light& light)
+{
+    return std::max({ light.diffuseColor.r, light.diffuseColor.g, light.diffuseColor.b,
+        light.specularColor.r, light.specularColor.g, light.specularColor.b });
+}
+
+struct DirectionalLight : Light {
+    glm::vec3 direction;
+
+    DirectionalLight(const glm::vec3& dir,
+        const glm::vec3& diffuse,
+        const glm::vec3& specular,
+        StateType type = StateType::Static)
+        : direction(glm::normalize(dir))
+    {
+        diffuseColor = diffuse;
+        specularColor = specular;
+        lightType = type;
+    }
+};
+
+// vec2 attenuation coefficients: first component is linear coefficient, second is quadratic coefficient, constant coefficient is 1.0
+struct PointLight : Light {
+    glm::vec3 position;
+    glm::vec2 attenuationCoefficients;
+
+    PointLight(const glm::vec3& pos,
+        const glm::vec3& diffuse,
+        const glm::vec3& specular,
+        const float& maxDistance,
+        StateType type = StateType::Static)
+        : position(pos)
+        , attenuationCoefficients(utils::math::getAttenuationCoefficient(maxDistance))
+    {
+        diffuseColor = diffuse;
+        specularColor = specular;
+        lightType = type;
+    }
+};
+
+struct SpotLight : Light {
+    glm::vec3 position;
+    glm::vec3 direction;
+    glm::vec2 attenuationCoefficients;
+    float innerCutoffAngle;
+    float outerCutoffAngle;
+
+    SpotLight(const glm::vec3& pos,
+        const glm::vec3& dir,
+        const float& innerCutoff,
+        const float& outerCutoff,
+        const glm::vec3& diffuse,
+        const glm::vec3& specular,
+        const float& maxDistance,
+        StateType type = StateType::Static)
+        : position(pos)
+        , direction(glm::normalize(dir))
+        , attenuationCoefficients(utils::math::getAttenuationCoefficient(maxDistance))
+        , innerCutoffAngle(innerCutoff)
+        , outerCutoffAngle(outerCutoff)
+    {
+        diffuseColor = diffuse;
+        specularColor = specular;
+        lightType = type;
+    }
+};
+
+// GPU representations of the lights. Alignment directives are to comply with std140 alignment requirements,
+// they must match the Light structs in blinn_or_phong_frag.glsl and blinn_or_phong_spot_frag.glsl.
+struct GPUPointLight {
+    GPUPointLight() = default;
+    GPUPointLight(const PointLight& light);
+
+    alignas(16) glm::vec3 position { 0.0f };
+    float linearAttenuationCoeff { 0.0f };
+    alignas(16) glm::vec3 diffuseColor { 0.0f };
+    float quadraticAttenuationCoeff { 0.0f };
+    alignas(16) glm::vec3 specularColor { 0.0f };
+};
+
+struct GPUSpotLight {
+    GPUSpotLight() = default;
+    GPUSpotLight(const SpotLight& light);
+
+    alignas(16) glm::vec3 position { 0.0f };
+    float innerCutoff { 0.0f }; // Cosine of the inner cutoff angle
+    alignas(16) glm::vec3 direction { 0.0f };
+    float outerCutoff { 0.0f }; // Cosine of the outer cutoff angle
+    float linearAttenuationCoeff { 0.0f };
+    float quadraticAttenuationCoeff { 0.0f };
+    alignas(16) glm::vec3 diffuseColor { 0.0f };
+    alignas(16) glm::vec3 specularColor { 0.0f };
+};
+
+struct GPUDirectionalLight {
+    GPUDirectionalLight() = default;
+    GPUDirectionalLight(const DirectionalLight& light);
+
+    alignas(16) glm::vec3 direction { 0.0f };
+    alignas(16) glm::vec3 diffuseColor { 0.0f };
+    alignas(16) glm::vec3 specularColor { 0.0f };
+};
+
+// Contents of the "Lights" uniform block: one batch of lights that is shaded in a single pass.
+template <typename GPULight, size_t MaxLights>
+struct GPULightBatch {
+    GPULight lights[MaxLights];
+    int numLights { 0 };
+};
+
+using PointLightBatch = GPULightBatch<GPUPointLight, utils::globals::shader_preprocessor_params::MAX_NUM_POINT_LIGHT>;
+using SpotLightBatch = GPULightBatch<GPUSpotLight, utils::globals::shader_preprocessor_params::MAX_NUM_SPOT_LIGHT>;
+using DirectionalLightBatch = GPULightBatch<GPUDirectionalLight, utils::globals::shader_preprocessor_params::MAX_NUM_DIR_LIGHT>;
+
+// Contents of the "AllLights" uniform block: every light of the frame, shaded by the single-pass shader.
+struct GPUAllLights {
+    GPUPointLight pointLights[utils::globals::shader_preprocessor_params::MAX_NUM_UBER_POINT_LIGHT];
+    GPUSpotLight spotLights[utils::globals::shader_preprocessor_params::MAX_NUM_UBER_SPOT_LIGHT];
+    GPUDirectionalLight dirLights[utils::globals::shader_preprocessor_params::MAX_NUM_UBER_DIR_LIGHT];
+    int numPointLights { 0 };
+    int numSpotLights { 0 };
+    int numDirLights { 0 };
+};
+
+// Uniform buffer holding all lights of a frame, split into batches of at most MAX_NUM_*_LIGHT lights.
+// The buffer is written once per frame; each lighting pass binds the range of its batch to the "Lights" block.
+// The same buffer also holds all lights in one "AllLights" block for the single-pass shader.
+class LightBuffer {
+public:
+    static constexpr GLuint BINDING = 1; // Binding point 0 is used by the "Material" block
+
+    LightBuffer();
+    LightBuffer(const LightBuffer&) = delete;
+    LightBuffer(LightBuffer&&);
+    ~LightBuffer();
+
+    LightBuffer& operator=(const LightBuffer&) = delete;
+    LightBuffer& operator=(LightBuffer&&);
+
+    void update(std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights, std::span<const DirectionalLight> directionalLights);
+
+    size_t numPointLightBatches() const;
+    size_t numSpotLightBatches() const;
+    size_t numDirectionalLightBatches() const;
+
+    // Bind a batch to the "Lights" uniform block of the given shader.
+    void bindPointLightBatch(const Shader& shader, size_t batch) const;
+    void bindSpotLightBatch(const Shader& shader, size_t batch) const;
+    void bindDirectionalLightBatch(const Shader& shader, size_t batch) const;
+    // Bind all lights to the "AllLights" uniform block (lights beyond MAX_NUM_UBER_*_LIGHT are left out).
+    void bindAllLights(const Shader& shader) const;
+
+private:
+    struct Region {
+        GLintptr offset { 0 };
+        size_t numBatches { 0 };
+    };
+
+    template <typename GPULight, size_t MaxLights, typename CPULight>
+    Region appendBatches(std::span<const CPULight> lights);
+    void bindBatch(const Shader& shader, const Region& region, size_t batch, GLsizeiptr batchSize) const;
+    void freeGpuMemory();
+
+private:
+    static constexpr GLuint INVALID = 0xFFFFFFFF;
+
+    GLuint m_ubo { INVALID };
+    GLsizeiptr m_batchStride { 0 }; // Batch size rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    std::vector<std::byte> m_staging;
+    Region m_pointRegion;
+    Region m_spotRegion;
+    Region m_directionalRegion;
+    GLintptr m_allLightsOffset { 0 };
+};
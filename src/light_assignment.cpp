@@ -0,0 +1,140 @@
+#include "light_assignment.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+// FNV-1a over the light indices of a batch
+template <size_t N>
+struct BatchKeyHash {
+    size_t operator()(const std::array<uint32_t, N>& key) const
+    {
+        uint64_t hash = 0xcbf29ce484222325;
+        for (uint32_t lightIdx : key)
+            hash = (hash ^ lightIdx) * 0x100000001b3;
+        return hash;
+    }
+};
+
+ObjectLightLists::ObjectLightLists()
+{
+    GLint offsetAlignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    m_offsetAlignment = offsetAlignment;
+
+    glGenBuffers(1, &m_ubo);
+}
+
+ObjectLightLists::~ObjectLightLists()
+{
+    freeGpuMemory();
+}
+
+void ObjectLightLists::update(const SceneBvh& sceneBvh, size_t numRenderables, std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights)
+{
+    m_staging.clear();
+    m_numAssignments = 0;
+    assign<GPUPointLight, utils::globals::shader_preprocessor_params::MAX_NUM_POINT_LIGHT>(m_lists[size_t(LightType::Point)], sceneBvh, numRenderables, pointLights);
+    assign<GPUSpotLight, utils::globals::shader_preprocessor_params::MAX_NUM_SPOT_LIGHT>(m_lists[size_t(LightType::Spot)], sceneBvh, numRenderables, spotLights);
+
+    // Re-specifying the whole buffer lets the driver orphan last frame's storage instead of stalling on it.
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(m_staging.size()), m_staging.data(), GL_STREAM_DRAW);
+}
+
+size_t ObjectLightLists::numPasses(LightType type) const
+{
+    return m_lists[size_t(type)].numPasses;
+}
+
+std::optional<uint32_t> ObjectLightLists::batchOf(LightType type, uint32_t drawID, size_t pass) const
+{
+    const TypeLists& lists = m_lists[size_t(type)];
+    const size_t batchIdx = lists.firstBatch[drawID] + pass;
+    if (batchIdx >= lists.firstBatch[drawID + 1])
+        return {};
+    return lists.batches[batchIdx];
+}
+
+void ObjectLightLists::bindBatch(const Shader& shader, LightType type, uint32_t batch) const
+{
+    const TypeLists& lists = m_lists[size_t(type)];
+    shader.bindUniformBlock("Lights", LightBuffer::BINDING, m_ubo, lists.offset + static_cast<GLintptr>(batch) * lists.batchStride, lists.batchSize);
+}
+
+std::span<const uint32_t> ObjectLightLists::lightsOf(LightType type, uint32_t batch) const
+{
+    const TypeLists& lists = m_lists[size_t(type)];
+    const auto first = std::begin(lists.batchLights) + batch * lists.maxLights;
+    return { first, std::find(first, first + lists.maxLights, NO_LIGHT) };
+}
+
+size_t ObjectLightLists::numAssignments() const
+{
+    return m_numAssignments;
+}
+
+template <typename GPULight, size_t MaxLights, typename CPULight>
+void ObjectLightLists::assign(TypeLists& lists, const SceneBvh& sceneBvh, size_t numRenderables, std::span<const CPULight> lights)
+{
+    using Batch = GPULightBatch<GPULight, MaxLights>;
+    using BatchKey = std::array<uint32_t, MaxLights>;
+    lists.maxLights = static_cast<uint32_t>(MaxLights);
+    lists.batchLights.clear();
+    lists.batchSize = sizeof(Batch);
+    lists.batchStride = (lists.batchSize + m_offsetAlignment - 1) / m_offsetAlignment * m_offsetAlignment;
+    lists.offset = (static_cast<GLintptr>(m_staging.size()) + m_offsetAlignment - 1) / m_offsetAlignment * m_offsetAlignment;
+    m_staging.resize(static_cast<size_t>(lists.offset));
+
+    // Renderables whose bounds overlap the sphere in which a light is not negligible, sorted by draw ID and then light
+    m_assignments.clear();
+    for (uint32_t lightIdx = 0; lightIdx < lights.size(); lightIdx++) {
+        const CPULight& light = lights[lightIdx];
+        m_overlaps.clear();
+        sceneBvh.overlapSphere(light.position, utils::math::getAttenuationRadius(light.attenuationCoefficients, maxIntensity(light)), m_overlaps);
+        for (uint32_t drawID : m_overlaps)
+            m_assignments.emplace_back(drawID, lightIdx);
+    }
+    std::sort(std::begin(m_assignments), std::end(m_assignments));
+    m_numAssignments += m_assignments.size();
+
+    std::unordered_map<BatchKey, uint32_t, BatchKeyHash<MaxLights>> batchIndices;
+    const auto batchIndexOf = [&](const BatchKey& key) {
+        const auto [iter, inserted] = batchIndices.try_emplace(key, static_cast<uint32_t>(batchIndices.size()));
+        if (inserted) {
+            lists.batchLights.insert(std::end(lists.batchLights), std::begin(key), std::end(key));
+            Batch batch;
+            for (uint32_t lightIdx : key) {
+                if (lightIdx != NO_LIGHT)
+                    batch.lights[batch.numLights++] = GPULight(lights[lightIdx]);
+            }
+            const size_t batchOffset = m_staging.size();
+            m_staging.resize(batchOffset + static_cast<size_t>(lists.batchStride));
+            std::memcpy(m_staging.data() + batchOffset, &batch, sizeof(batch));
+        }
+        return iter->second;
+    };
+
+    lists.firstBatch.resize(numRenderables + 1);
+    lists.batches.clear();
+    lists.numPasses = 0;
+    auto iter = std::begin(m_assignments);
+    for (uint32_t drawID = 0; drawID < numRenderables; drawID++) {
+        lists.firstBatch[drawID] = static_cast<uint32_t>(lists.batches.size());
+        const auto end = std::find_if(iter, std::end(m_assignments), [&](const auto& assignment) { return assignment.first != drawID; });
+        for (; iter != end;) {
+            BatchKey key;
+            key.fill(NO_LIGHT);
+            for (size_t i = 0; i < MaxLights && iter != end; i++, iter++)
+                key[i] = iter->second;
+            lists.batches.push_back(batchIndexOf(key));
+        }
+        lists.numPasses = std::max<size_t>(lists.numPasses, lists.batches.size() - lists.firstBatch[drawID]);
+    }
+    lists.firstBatch[numRenderables] = static_cast<uint32_t>(lists.batches.size());
+}
+
+void ObjectLightLists::freeGpuMemory()
+{
+    if (m_ubo != INVALID)
+        glDeleteBuffers(1, &m_ubo);
+}
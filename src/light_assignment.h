@@ -0,0 +1,75 @@
+#pragma once
+
+#include "light.h"
+#include "scene_bvh.h"
+#include <framework/opengl_includes.h>
+#include <framework/shader.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Per-object light lists for the multi-pass forward path. Every point and spot light is intersected with the renderable
+// bounds in the scene BVH, using the distance at which its attenuation becomes negligible, and every renderable gets
+// only the lights that reach it. A renderable's list is split into batches of MAX_NUM_*_LIGHT lights; pass i shades
+// batch i, so the number of passes follows the local light density. Identical batches are stored once, such that
+// renderables that are lit by the same lights still share their draws.
+class ObjectLightLists {
+public:
+    ObjectLightLists();
+    ObjectLightLists(const ObjectLightLists&) = delete;
+    ObjectLightLists(ObjectLightLists&&) = delete;
+    ~ObjectLightLists();
+
+    ObjectLightLists& operator=(const ObjectLightLists&) = delete;
+    ObjectLightLists& operator=(ObjectLightLists&&) = delete;
+
+    void update(const SceneBvh& sceneBvh, size_t numRenderables, std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights);
+
+    // Largest number of batches of any renderable. Renderables without lights of a type are not drawn in its passes,
+    // which leaves them black just like shading them with zero lights would.
+    size_t numPasses(LightType type) const;
+    // Batch shading the renderable in the given pass, or nothing when it has no more lights of this type.
+    std::optional<uint32_t> batchOf(LightType type, uint32_t drawID, size_t pass) const;
+    // Bind a batch to the "Lights" uniform block of the given shader.
+    void bindBatch(const Shader& shader, LightType type, uint32_t batch) const;
+    // Indices of the lights in a batch.
+    std::span<const uint32_t> lightsOf(LightType type, uint32_t batch) const;
+
+    // Sum over all renderables of the number of lights assigned to them.
+    size_t numAssignments() const;
+
+private:
+    static constexpr uint32_t NO_LIGHT = 0xFFFFFFFF;
+
+    struct TypeLists {
+        std::vector<uint32_t> firstBatch; // Per renderable, into batches, plus one past the end
+        std::vector<uint32_t> batches; // Batch indices of all renderables, one per pass
+        std::vector<uint32_t> batchLights; // Light indices of every batch, padded with NO_LIGHT to maxLights
+        uint32_t maxLights { 0 };
+        size_t numPasses { 0 };
+        GLintptr offset { 0 }; // Of the first batch in the uniform buffer
+        GLsizeiptr batchSize { 0 };
+        GLsizeiptr batchStride { 0 }; // Batch size rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    };
+
+    template <typename GPULight, size_t MaxLights, typename CPULight>
+    void assign(TypeLists& lists, const SceneBvh& sceneBvh, size_t numRenderables, std::span<const CPULight> lights);
+    void freeGpuMemory();
+
+private:
+    static constexpr GLuint INVALID = 0xFFFFFFFF;
+
+    GLuint m_ubo { INVALID };
+    GLsizeiptr m_offsetAlignment { 1 };
+    std::array<TypeLists, 2> m_lists;
+    size_t m_numAssignments { 0 };
+    std::vector<std::byte> m_staging;
+    // Scratch space, kept to avoid reallocating every frame
+    std::vector<uint32_t> m_overlaps;
+    std::vector<std::pair<uint32_t, uint32_t>> m_assignments; // (draw ID, light index)
+};
@@ -0,0 +1,132 @@
+#include "light_clipping.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <GLFW/glfw3.h>
+#include <glm/common.hpp>
+#include <glm/trigonometric.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cmath>
+
+LightClipping::LightClipping()
+{
+    // Not part of core OpenGL; without it only the scissor rectangles are used
+    if (glfwExtensionSupported("GL_EXT_depth_bounds_test"))
+        m_depthBounds = reinterpret_cast<PFNDepthBounds>(glfwGetProcAddress("glDepthBoundsEXT"));
+}
+
+void LightClipping::update(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, const glm::ivec2& framebufferSize,
+    std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights)
+{
+    m_viewMatrix = viewMatrix;
+    m_projectionMatrix = projectionMatrix;
+    m_framebufferSize = framebufferSize;
+
+    std::vector<ScreenBounds>& pointBounds = m_bounds[size_t(LightType::Point)];
+    pointBounds.clear();
+    for (const PointLight& light : pointLights)
+        pointBounds.push_back(sphereBounds(light.position, utils::math::getAttenuationRadius(light.attenuationCoefficients, maxIntensity(light))));
+
+    std::vector<ScreenBounds>& spotBounds = m_bounds[size_t(LightType::Spot)];
+    spotBounds.clear();
+    for (const SpotLight& light : spotLights) {
+        const float radius = utils::math::getAttenuationRadius(light.attenuationCoefficients, maxIntensity(light));
+        if (light.outerCutoffAngle < glm::radians(90.0f)) {
+            // Sphere around the lit cone: centered on its base circle, reaching both the apex and the rim
+            const float cosAngle = std::cos(light.outerCutoffAngle), sinAngle = std::sin(light.outerCutoffAngle);
+            spotBounds.push_back(sphereBounds(light.position + light.direction * (radius * cosAngle), radius * std::max(cosAngle, sinAngle)));
+        } else {
+            spotBounds.push_back(sphereBounds(light.position, radius));
+        }
+    }
+}
+
+void LightClipping::begin()
+{
+    m_scissoredArea = 0.0f;
+    glEnable(GL_SCISSOR_TEST);
+    if (m_depthBounds)
+        glEnable(DEPTH_BOUNDS_TEST);
+}
+
+void LightClipping::end() const
+{
+    // The scissor rectangle also applies to glClear()
+    glDisable(GL_SCISSOR_TEST);
+    if (m_depthBounds)
+        glDisable(DEPTH_BOUNDS_TEST);
+}
+
+void LightClipping::clipTo(LightType type, std::span<const uint32_t> lights)
+{
+    // Starts out empty, such that a batch without any light on screen draws nothing
+    ScreenBounds bounds { m_framebufferSize, glm::ivec2(0), 1.0f, 0.0f };
+    for (uint32_t lightIdx : lights) {
+        const ScreenBounds& lightBounds = m_bounds[size_t(type)][lightIdx];
+        bounds.lower = glm::min(bounds.lower, lightBounds.lower);
+        bounds.upper = glm::max(bounds.upper, lightBounds.upper);
+        bounds.minDepth = std::min(bounds.minDepth, lightBounds.minDepth);
+        bounds.maxDepth = std::max(bounds.maxDepth, lightBounds.maxDepth);
+    }
+    apply(bounds);
+}
+
+void LightClipping::clipTo(LightType type, size_t firstLight, size_t numLights)
+{
+    std::vector<uint32_t> lights(numLights);
+    for (size_t i = 0; i < numLights; i++)
+        lights[i] = static_cast<uint32_t>(firstLight + i);
+    clipTo(type, lights);
+}
+
+bool LightClipping::hasDepthBounds() const
+{
+    return m_depthBounds != nullptr;
+}
+
+float LightClipping::scissoredArea() const
+{
+    return m_scissoredArea;
+}
+
+LightClipping::ScreenBounds LightClipping::sphereBounds(const glm::vec3& center, float radius) const
+{
+    // The camera looks down the negative z-axis of view space
+    const glm::vec3 viewCenter = m_viewMatrix * glm::vec4(center, 1.0f);
+    const float nearestDepth = -viewCenter.z - radius, farthestDepth = -viewCenter.z + radius;
+    // Near plane distance of a perspective projection matrix
+    const float nearPlane = m_projectionMatrix[3][2] / (m_projectionMatrix[2][2] - 1.0f);
+    if (farthestDepth < nearPlane)
+        return { m_framebufferSize, glm::ivec2(0), 1.0f, 0.0f }; // Behind the camera
+    if (nearestDepth <= nearPlane)
+        return { glm::ivec2(0), m_framebufferSize, 0.0f, windowDepth(farthestDepth) }; // Around the camera
+
+    // Project the corners of the view space bounding box of the sphere, which all lie in front of the camera
+    glm::vec2 ndcLower { 1.0f }, ndcUpper { -1.0f };
+    for (int corner = 0; corner < 8; corner++) {
+        const glm::vec3 offset { corner & 1 ? radius : -radius, corner & 2 ? radius : -radius, corner & 4 ? radius : -radius };
+        const glm::vec4 clip = m_projectionMatrix * glm::vec4(viewCenter + offset, 1.0f);
+        const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+        ndcLower = glm::min(ndcLower, ndc);
+        ndcUpper = glm::max(ndcUpper, ndc);
+    }
+    const glm::vec2 size { m_framebufferSize };
+    const glm::ivec2 lower = glm::clamp(glm::ivec2(glm::floor((ndcLower * 0.5f + 0.5f) * size)), glm::ivec2(0), m_framebufferSize);
+    const glm::ivec2 upper = glm::clamp(glm::ivec2(glm::ceil((ndcUpper * 0.5f + 0.5f) * size)), glm::ivec2(0), m_framebufferSize);
+    return { lower, upper, windowDepth(nearestDepth), windowDepth(farthestDepth) };
+}
+
+float LightClipping::windowDepth(float viewDepth) const
+{
+    const glm::vec4 clip = m_projectionMatrix * glm::vec4(0.0f, 0.0f, -viewDepth, 1.0f);
+    return glm::clamp(clip.z / clip.w * 0.5f + 0.5f, 0.0f, 1.0f);
+}
+
+void LightClipping::apply(const ScreenBounds& bounds)
+{
+    const glm::ivec2 size = glm::max(bounds.upper - bounds.lower, glm::ivec2(0));
+    glScissor(bounds.lower.x, bounds.lower.y, size.x, size.y);
+    if (m_depthBounds && bounds.minDepth <= bounds.maxDepth)
+        m_depthBounds(bounds.minDepth, bounds.maxDepth);
+    m_scissoredArea += float(size.x * size.y) / float(m_framebufferSize.x * m_framebufferSize.y);
+}
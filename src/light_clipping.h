@@ -0,0 +1,61 @@
+#pragma once
+
+#include "light.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/opengl_includes.h>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Restricts the additive light passes to the pixels that a batch of lights can reach: a scissor rectangle around the
+// projected bounding spheres of its lights and, with GL_EXT_depth_bounds_test, the window depth range they cover.
+// Fragments whose stored depth (written by the depth prepass) lies outside of that range are rejected before shading.
+class LightClipping {
+public:
+    LightClipping();
+
+    // Compute the screen bounds of every light for this frame.
+    void update(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, const glm::ivec2& framebufferSize,
+        std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights);
+
+    // Enable scissoring (and depth bounds testing) for the passes between begin() and end().
+    void begin();
+    void end() const;
+    // Clip to the union of the bounds of the given lights, or of the lights [firstLight, firstLight + numLights).
+    void clipTo(LightType type, std::span<const uint32_t> lights);
+    void clipTo(LightType type, size_t firstLight, size_t numLights);
+
+    bool hasDepthBounds() const;
+    // Fraction of the screen covered by the scissor rectangles set since begin(), summed over all passes.
+    float scissoredArea() const;
+
+private:
+    struct ScreenBounds {
+        glm::ivec2 lower { 0 }; // Inclusive pixel
+        glm::ivec2 upper { 0 }; // Exclusive pixel
+        float minDepth { 0.0f };
+        float maxDepth { 1.0f };
+    };
+
+    ScreenBounds sphereBounds(const glm::vec3& center, float radius) const;
+    float windowDepth(float viewDepth) const;
+    void apply(const ScreenBounds& bounds);
+
+private:
+    using PFNDepthBounds = void(APIENTRYP)(GLclampd zmin, GLclampd zmax);
+    static constexpr GLenum DEPTH_BOUNDS_TEST = 0x8890; // GL_DEPTH_BOUNDS_TEST_EXT
+
+    PFNDepthBounds m_depthBounds { nullptr };
+    glm::mat4 m_viewMatrix { 1.0f };
+    glm::mat4 m_projectionMatrix { 1.0f };
+    glm::ivec2 m_framebufferSize { 0 };
+    std::array<std::vector<ScreenBounds>, 2> m_bounds; // By light type
+    float m_scissoredArea { 0.0f };
+};
@@ -1,8 +1,6 @@
 #include "mesh.h"
 #include <framework/disable_all_warnings.h>
-DISABLE_WARNINGS_PUSH()
-#include <fmt/format.h>
-DISABLE_WARNINGS_POP()
+#include <framework/mesh_simplifier.h>
 #include <iostream>
 #include <vector>
 
@@ -13,46 +11,46 @@ GPUMaterial::GPUMaterial(const Material& material) :
     transparency(material.transparency)
 {}
 
-GPUMesh::GPUMesh(const Mesh& cpuMesh)
+GPUMesh::GPUMesh(MeshArena& arena, const Mesh& cpuMesh, bool buildMeshlets, std::span<const float> lodRatios)
+    : m_pArena(&arena)
 {
-    // Create uniform buffer to store mesh material (https://learnopengl.com/Advanced-OpenGL/Advanced-GLSL)
-    GPUMaterial gpuMaterial(cpuMesh.material);
-    glGenBuffers(1, &m_uboMaterial);
-    glBindBuffer(GL_UNIFORM_BUFFER, m_uboMaterial);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(GPUMaterial), &gpuMaterial, GL_STATIC_READ);
+    uploadMaterial(cpuMesh.material);
+    m_bounds = cpuMesh.bounds;
+    m_boundingSphere = cpuMesh.boundingSphere;
+
+    // Vertices and indices are stored in the arena's shared buffers
+    if (arena.format() == VertexFormat::Quantized) {
+        m_quantization = VertexQuantization::fromVertices(cpuMesh.vertices);
+        m_quantizationError = m_quantization.measureError(cpuMesh.vertices);
+    }
+    if (buildMeshlets) {
+        // Meshlets are runs of consecutive triangles, so the triangles are reordered before uploading them
+        Mesh meshletMesh = cpuMesh;
+        m_meshlets = ::buildMeshlets(meshletMesh);
+        m_allocation = arena.allocate(meshletMesh.vertices, meshletMesh.triangles, m_quantization);
+    } else {
+        m_allocation = arena.allocate(cpuMesh.vertices, cpuMesh.triangles, m_quantization);
+    }
+    // The vertices of every level are a subset of the original ones, so they share its quantization
+    for (const MeshLod& lod : buildLodChain(cpuMesh, lodRatios)) {
+        m_lodAllocations.push_back(arena.allocate(lod.mesh.vertices, lod.mesh.triangles, m_quantization));
+        m_lodErrors.push_back(lod.error);
+    }
+}
 
-    // Figure out if this mesh has texture coordinates
-    m_hasTextureCoords = static_cast<bool>(cpuMesh.material.kdTexture);
-
-    // Create VAO and bind it so subsequent creations of VBO and IBO are bound to this VAO
-    glGenVertexArrays(1, &m_vao);
-    glBindVertexArray(m_vao);
-
-    // Create vertex buffer object (VBO)
-    glGenBuffers(1, &m_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(cpuMesh.vertices.size() * sizeof(decltype(cpuMesh.vertices)::value_type)), cpuMesh.vertices.data(), GL_STATIC_DRAW);
-
-    // Create index buffer object (IBO)
-    glGenBuffers(1, &m_ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(cpuMesh.triangles.size() * sizeof(decltype(cpuMesh.triangles)::value_type)), cpuMesh.triangles.data(), GL_STATIC_DRAW);
-
-    // Tell OpenGL that we will be using vertex attributes 0, 1 and 2.
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-    // We tell OpenGL what each vertex looks like and how they are mapped to the shader (location = ...).
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
-    // Reuse all attributes for each instance
-    glVertexAttribDivisor(0, 0);
-    glVertexAttribDivisor(1, 0);
-    glVertexAttribDivisor(2, 0);
-
-    // Each triangle has 3 vertices.
-    m_numIndices = static_cast<GLsizei>(3 * cpuMesh.triangles.size());
+GPUMesh::GPUMesh(MeshArena& arena, const MeshCache::SubMesh& cachedMesh)
+    : m_pArena(&arena)
+{
+    uploadMaterial(cachedMesh.material);
+    m_bounds = cachedMesh.bounds;
+    m_boundingSphere = cachedMesh.boundingSphere;
+
+    // Full float arenas copy the mapped vertices into their vertex buffer as they are
+    if (arena.format() == VertexFormat::Quantized) {
+        m_quantization = VertexQuantization::fromVertices(cachedMesh.vertices);
+        m_quantizationError = m_quantization.measureError(cachedMesh.vertices);
+    }
+    m_allocation = arena.allocate(cachedMesh.vertices, cachedMesh.triangles, m_quantization);
 }
 
 GPUMesh::GPUMesh(GPUMesh&& other)
@@ -71,60 +69,135 @@ GPUMesh& GPUMesh::operator=(GPUMesh&& other)
     return *this;
 }
 
-std::vector<GPUMesh> GPUMesh::loadMeshGPU(std::filesystem::path filePath, bool normalize) {
-    if (!std::filesystem::exists(filePath))
-        throw MeshLoadingException(fmt::format("File {} does not exist", filePath.string().c_str()));
+bool GPUMesh::hasTextureCoords() const
+{
+    return m_hasTextureCoords;
+}
 
-    // Generate GPU-side meshes for all sub-meshes
-    std::vector<Mesh> subMeshes = loadMesh(filePath, normalize);
-    std::vector<GPUMesh> gpuMeshes;
-    for (const Mesh& mesh : subMeshes) { gpuMeshes.emplace_back(mesh); }
-    
-    return gpuMeshes;
+const AxisAlignedBox& GPUMesh::bounds() const
+{
+    return m_bounds;
 }
 
-bool GPUMesh::hasTextureCoords() const
+const BoundingSphere& GPUMesh::boundingSphere() const
 {
-    return m_hasTextureCoords;
+    return m_boundingSphere;
+}
+
+const MeshArena& GPUMesh::arena() const
+{
+    return *m_pArena;
+}
+
+const MeshArena::Allocation& GPUMesh::allocation() const
+{
+    return m_allocation;
+}
+
+const QuantizationError& GPUMesh::quantizationError() const
+{
+    return m_quantizationError;
 }
 
-void GPUMesh::draw(const Shader& drawingShader)
+std::span<const Meshlet> GPUMesh::meshlets() const
+{
+    return m_meshlets;
+}
+
+size_t GPUMesh::numLods() const
+{
+    return m_lodAllocations.size() + 1;
+}
+
+float GPUMesh::lodError(size_t lod) const
+{
+    return lod == 0 ? 0.0f : m_lodErrors[lod - 1];
+}
+
+size_t GPUMesh::numTriangles(size_t lod) const
+{
+    return (lod == 0 ? m_allocation : m_lodAllocations[lod - 1]).numIndices / 3;
+}
+
+void GPUMesh::draw(const Shader& drawingShader) const
+{
+    bindMaterial(drawingShader);
+    bindVertexArray();
+    drawElements();
+}
+
+void GPUMesh::bindMaterial(const Shader& drawingShader) const
 {
     // Bind material data uniform (we assume that the uniform buffer objects is always called 'Material')
     // Yes, we could define the binding inside the shader itself, but that would break on OpenGL versions below 4.2
     drawingShader.bindUniformBlock("Material", 0, m_uboMaterial);
-    
+    // Identity for full float vertices
+    drawingShader.setUniform("positionOffset", m_quantization.positionOffset);
+    drawingShader.setUniform("positionScale", m_quantization.positionScale);
+    drawingShader.setUniform("octahedralNormals", m_pArena->format() == VertexFormat::Quantized);
+}
+
+void GPUMesh::bindVertexArray(VertexStream stream) const
+{
+    m_pArena->bindVertexArray(stream);
+}
+
+void GPUMesh::drawElements(size_t lod) const
+{
     // Draw the mesh's triangles
-    glBindVertexArray(m_vao);
-    glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, nullptr);
+    m_pArena->drawElements(lod == 0 ? m_allocation : m_lodAllocations[lod - 1]);
+}
+
+void GPUMesh::drawElementsInstanced(GLsizei numInstances, size_t lod) const
+{
+    m_pArena->drawElementsInstanced(lod == 0 ? m_allocation : m_lodAllocations[lod - 1], numInstances);
+}
+
+void GPUMesh::drawElementRanges(std::span<const MeshArena::IndexRange> ranges) const
+{
+    m_pArena->multiDrawElements(m_allocation, ranges);
+}
+
+void GPUMesh::uploadMaterial(const Material& material)
+{
+    // Create uniform buffer to store mesh material (https://learnopengl.com/Advanced-OpenGL/Advanced-GLSL)
+    GPUMaterial gpuMaterial(material);
+    glGenBuffers(1, &m_uboMaterial);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_uboMaterial);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(GPUMaterial), &gpuMaterial, GL_STATIC_READ);
+
+    // Figure out if this mesh has texture coordinates
+    m_hasTextureCoords = static_cast<bool>(material.kdTexture);
 }
 
 void GPUMesh::moveInto(GPUMesh&& other)
 {
     freeGpuMemory();
-    m_numIndices = other.m_numIndices;
+    m_pArena = other.m_pArena;
+    m_allocation = other.m_allocation;
     m_hasTextureCoords = other.m_hasTextureCoords;
-    m_ibo = other.m_ibo;
-    m_vbo = other.m_vbo;
-    m_vao = other.m_vao;
+    m_bounds = other.m_bounds;
+    m_boundingSphere = other.m_boundingSphere;
+    m_quantization = other.m_quantization;
+    m_quantizationError = other.m_quantizationError;
+    m_meshlets = std::move(other.m_meshlets);
+    m_lodAllocations = std::move(other.m_lodAllocations);
+    m_lodErrors = std::move(other.m_lodErrors);
     m_uboMaterial = other.m_uboMaterial;
 
-    other.m_numIndices = 0;
-    other.m_hasTextureCoords = other.m_hasTextureCoords;
-    other.m_ibo = INVALID;
-    other.m_vbo = INVALID;
-    other.m_vao = INVALID;
+    other.m_pArena = nullptr;
+    other.m_allocation = {};
+    other.m_lodAllocations.clear();
     other.m_uboMaterial = INVALID;
 }
 
 void GPUMesh::freeGpuMemory()
 {
-    if (m_vao != INVALID)
-        glDeleteVertexArrays(1, &m_vao);
-    if (m_vbo != INVALID)
-        glDeleteBuffers(1, &m_vbo);
-    if (m_ibo != INVALID)
-        glDeleteBuffers(1, &m_ibo);
+    if (m_pArena) {
+        m_pArena->free(m_allocation);
+        for (const MeshArena::Allocation& lodAllocation : m_lodAllocations)
+            m_pArena->free(lodAllocation);
+    }
     if (m_uboMaterial != INVALID)
         glDeleteBuffers(1, &m_uboMaterial);
 }
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "mesh_arena.h"
 #include <framework/disable_all_warnings.h>
 #include <framework/mesh.h>
+#include <framework/mesh_cache.h>
+#include <framework/meshlet.h>
 #include <framework/shader.h>
 DISABLE_WARNINGS_PUSH()
 #include <glm/vec3.hpp>
@@ -9,6 +12,7 @@ DISABLE_WARNINGS_POP()
 
 #include <exception>
 #include <filesystem>
+#include <span>
 #include <framework/opengl_includes.h>
 
 struct MeshLoadingException : public std::runtime_error {
@@ -25,38 +29,69 @@ struct GPUMaterial {
 	float transparency{ 1.0f };
 };
 
+// A mesh uploaded to a MeshArena: the ranges of its vertices and indices, plus its material.
 class GPUMesh {
 public:
-    GPUMesh(const Mesh& cpuMesh);
+    // With buildMeshlets, the triangles are also partitioned into meshlets, for MeshletCulling. Only use this for closed
+    // meshes: back-facing meshlets are skipped even though face culling is disabled.
+    // Every entry of lodRatios adds a simplified level of detail with that fraction of the triangles (see buildLodChain()).
+    GPUMesh(MeshArena& arena, const Mesh& cpuMesh, bool buildMeshlets = false, std::span<const float> lodRatios = {});
+    // Upload a sub-mesh of a mapped mesh cache straight from the mapping, without meshlets or levels of detail.
+    GPUMesh(MeshArena& arena, const MeshCache::SubMesh& cachedMesh);
     // Cannot copy a GPU mesh because it would require reference counting of GPU resources.
     GPUMesh(const GPUMesh&) = delete;
     GPUMesh(GPUMesh&&);
     ~GPUMesh();
 
-    // Generate a number of GPU meshes from a particular model file.
-    // Multiple meshes may be generated if there are multiple sub-meshes in the file
-    static std::vector<GPUMesh> loadMeshGPU(std::filesystem::path filePath, bool normalize = false);
-
     // Cannot copy a GPU mesh because it would require reference counting of GPU resources.
     GPUMesh& operator=(const GPUMesh&) = delete;
     GPUMesh& operator=(GPUMesh&&);
 
     bool hasTextureCoords() const;
+    // Object-space bounds of the mesh, as computed by loadMesh()
+    const AxisAlignedBox& bounds() const;
+    const BoundingSphere& boundingSphere() const;
+    // All meshes of an arena share its vertex array
+    const MeshArena& arena() const;
+    const MeshArena::Allocation& allocation() const;
+    // Largest error introduced by the vertex format of the arena (zero for VertexFormat::Float)
+    const QuantizationError& quantizationError() const;
+    // In object space; empty unless built with meshlets. Meshlets only cover the full detail mesh (LOD 0).
+    std::span<const Meshlet> meshlets() const;
+    // Level 0 is the full detail mesh; the error of a level is in object space (see MeshLod).
+    size_t numLods() const;
+    float lodError(size_t lod) const;
+    size_t numTriangles(size_t lod = 0) const;
 
     // Bind VAO and call glDrawElements.
-    void draw(const Shader& drawingShader);
+    void draw(const Shader& drawingShader) const;
+
+    // The steps of draw(), for callers that skip redundant binds (see RenderStateCache). The material includes the
+    // uniforms that decode quantized vertices.
+    void bindMaterial(const Shader& drawingShader) const;
+    void bindVertexArray(VertexStream stream = VertexStream::Interleaved) const;
+    void drawElements(size_t lod = 0) const;
+    void drawElementsInstanced(GLsizei numInstances, size_t lod = 0) const;
+    void drawElementRanges(std::span<const MeshArena::IndexRange> ranges) const;
 
 private:
+    void uploadMaterial(const Material& material);
     void moveInto(GPUMesh&&);
     void freeGpuMemory();
 
 private:
     static constexpr GLuint INVALID = 0xFFFFFFFF;
 
-    GLsizei m_numIndices { 0 };
+    MeshArena* m_pArena { nullptr };
+    MeshArena::Allocation m_allocation;
     bool m_hasTextureCoords { false };
-    GLuint m_ibo { INVALID };
-    GLuint m_vbo { INVALID };
-    GLuint m_vao { INVALID };
+    AxisAlignedBox m_bounds;
+    BoundingSphere m_boundingSphere;
+    VertexQuantization m_quantization;
+    QuantizationError m_quantizationError;
+    std::vector<Meshlet> m_meshlets;
+    // Levels of detail after the first, which is m_allocation
+    std::vector<MeshArena::Allocation> m_lodAllocations;
+    std::vector<float> m_lodErrors;
     GLuint m_uboMaterial { INVALID };
 };
@@ -0,0 +1,327 @@
+#include "mesh_arena.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+RangeAllocator::RangeAllocator(size_t capacity)
+    : m_capacity(0)
+{
+    grow(capacity);
+}
+
+std::optional<size_t> RangeAllocator::allocate(size_t size)
+{
+    for (auto iter = std::begin(m_freeRanges); iter != std::end(m_freeRanges); iter++) {
+        const auto [offset, rangeSize] = *iter;
+        if (rangeSize < size)
+            continue;
+
+        m_freeRanges.erase(iter);
+        if (rangeSize > size)
+            m_freeRanges.emplace(offset + size, rangeSize - size);
+        return offset;
+    }
+    return {};
+}
+
+void RangeAllocator::free(size_t offset, size_t size)
+{
+    if (size == 0)
+        return;
+
+    auto next = m_freeRanges.lower_bound(offset);
+    // Merge with the free range that ends where this one starts
+    if (next != std::begin(m_freeRanges)) {
+        const auto previous = std::prev(next);
+        assert(previous->first + previous->second <= offset);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            m_freeRanges.erase(previous);
+        }
+    }
+    // And with the free range that starts where this one ends
+    if (next != std::end(m_freeRanges) && offset + size == next->first) {
+        size += next->second;
+        m_freeRanges.erase(next);
+    }
+    m_freeRanges.emplace(offset, size);
+}
+
+void RangeAllocator::grow(size_t newCapacity)
+{
+    assert(newCapacity >= m_capacity);
+    const size_t oldCapacity = m_capacity;
+    m_capacity = newCapacity;
+    free(oldCapacity, newCapacity - oldCapacity);
+}
+
+size_t RangeAllocator::capacity() const
+{
+    return m_capacity;
+}
+
+const void* MeshArena::Allocation::indexOffset() const
+{
+    return (const void*)(firstIndex * (indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)));
+}
+
+MeshArena::MeshArena(VertexFormat format, bool keepPositionStream)
+    : m_format(format)
+{
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(INITIAL_VERTEX_CAPACITY * vertexSize()), nullptr, GL_STATIC_DRAW);
+    glGenBuffers(1, &m_ibo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(INITIAL_INDEX_CAPACITY * sizeof(GLuint)), nullptr, GL_STATIC_DRAW);
+    glGenVertexArrays(1, &m_vao);
+
+    if (keepPositionStream) {
+        glGenBuffers(1, &m_positionVbo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_positionVbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(INITIAL_VERTEX_CAPACITY * positionSize()), nullptr, GL_STATIC_DRAW);
+        glGenVertexArrays(1, &m_positionVao);
+    }
+    setupVertexArray();
+}
+
+MeshArena::~MeshArena()
+{
+    freeGpuMemory();
+}
+
+MeshArena::Allocation MeshArena::allocate(std::span<const Vertex> vertices, std::span<const glm::uvec3> triangles, const VertexQuantization& quantization)
+{
+    const size_t numIndices = 3 * triangles.size();
+    const GLenum indexType = vertices.size() <= MAX_16BIT_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    const size_t numSlots = numIndexSlots(numIndices, indexType);
+    std::optional<size_t> firstVertex = m_vertexRanges.allocate(vertices.size());
+    if (!firstVertex) {
+        const size_t oldCapacity = m_vertexRanges.capacity();
+        m_vertexRanges.grow(std::max(2 * oldCapacity, oldCapacity + vertices.size()));
+        reallocateBuffer(m_vbo, oldCapacity * vertexSize(), m_vertexRanges.capacity() * vertexSize());
+        if (hasPositionStream())
+            reallocateBuffer(m_positionVbo, oldCapacity * positionSize(), m_vertexRanges.capacity() * positionSize());
+        firstVertex = m_vertexRanges.allocate(vertices.size());
+    }
+    std::optional<size_t> firstSlot = m_indexRanges.allocate(numSlots);
+    if (!firstSlot) {
+        const size_t oldCapacity = m_indexRanges.capacity();
+        m_indexRanges.grow(std::max(2 * oldCapacity, oldCapacity + numSlots));
+        reallocateBuffer(m_ibo, oldCapacity * sizeof(GLuint), m_indexRanges.capacity() * sizeof(GLuint));
+        firstSlot = m_indexRanges.allocate(numSlots);
+    }
+    m_numIndices += numIndices;
+    m_numIndexSlots += numSlots;
+    // The vertex array refers to the buffer objects, which are replaced when growing
+    setupVertexArray();
+
+    // GL_COPY_WRITE_BUFFER has no side effects on the bound vertex array, unlike GL_ELEMENT_ARRAY_BUFFER
+    const void* pVertexData = vertices.data();
+    const void* pPositionData = nullptr;
+    if (m_format == VertexFormat::Quantized) {
+        m_quantizedStaging.clear();
+        m_quantizedPositionStaging.clear();
+        for (const Vertex& vertex : vertices) {
+            const QuantizedVertex& quantized = m_quantizedStaging.emplace_back(quantization.encode(vertex));
+            m_quantizedPositionStaging.push_back({ { quantized.position[0], quantized.position[1], quantized.position[2] }, 0 });
+        }
+        pVertexData = m_quantizedStaging.data();
+        pPositionData = m_quantizedPositionStaging.data();
+    } else if (hasPositionStream()) {
+        m_positionStaging.clear();
+        for (const Vertex& vertex : vertices)
+            m_positionStaging.push_back(vertex.position);
+        pPositionData = m_positionStaging.data();
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(*firstVertex * vertexSize()), static_cast<GLsizeiptr>(vertices.size() * vertexSize()), pVertexData);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+    if (indexType == GL_UNSIGNED_SHORT) {
+        m_shortIndexStaging.clear();
+        for (const glm::uvec3& triangle : triangles) {
+            for (int corner = 0; corner < 3; corner++)
+                m_shortIndexStaging.push_back(static_cast<GLushort>(triangle[corner]));
+        }
+        glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(*firstSlot * sizeof(GLuint)),
+            static_cast<GLsizeiptr>(m_shortIndexStaging.size() * sizeof(GLushort)), m_shortIndexStaging.data());
+    } else {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(*firstSlot * sizeof(GLuint)), static_cast<GLsizeiptr>(triangles.size_bytes()), triangles.data());
+    }
+    if (hasPositionStream()) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_positionVbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(*firstVertex * positionSize()),
+            static_cast<GLsizeiptr>(vertices.size() * positionSize()), pPositionData);
+    }
+
+    const size_t firstIndex = indexType == GL_UNSIGNED_SHORT ? 2 * *firstSlot : *firstSlot;
+    return { static_cast<uint32_t>(*firstVertex), static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(firstIndex), static_cast<uint32_t>(numIndices), indexType };
+}
+
+void MeshArena::free(const Allocation& allocation)
+{
+    m_vertexRanges.free(allocation.firstVertex, allocation.numVertices);
+    const size_t numSlots = numIndexSlots(allocation.numIndices, allocation.indexType);
+    m_indexRanges.free(allocation.indexType == GL_UNSIGNED_SHORT ? allocation.firstIndex / 2 : allocation.firstIndex, numSlots);
+    m_numIndices -= allocation.numIndices;
+    m_numIndexSlots -= numSlots;
+}
+
+VertexFormat MeshArena::format() const
+{
+    return m_format;
+}
+
+size_t MeshArena::bytesPerVertex() const
+{
+    return vertexSize() + (hasPositionStream() ? positionSize() : 0);
+}
+
+size_t MeshArena::indexMemory() const
+{
+    return m_numIndexSlots * sizeof(GLuint);
+}
+
+size_t MeshArena::indexMemory32Bit() const
+{
+    return m_numIndices * sizeof(GLuint);
+}
+
+bool MeshArena::hasPositionStream() const
+{
+    return m_positionVao != INVALID;
+}
+
+void MeshArena::bindVertexArray(VertexStream stream) const
+{
+    glBindVertexArray(stream == VertexStream::Position && hasPositionStream() ? m_positionVao : m_vao);
+}
+
+void MeshArena::drawElements(const Allocation& allocation) const
+{
+    glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(allocation.numIndices), allocation.indexType,
+        allocation.indexOffset(), static_cast<GLint>(allocation.firstVertex));
+}
+
+void MeshArena::drawElementsInstanced(const Allocation& allocation, GLsizei numInstances) const
+{
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(allocation.numIndices), allocation.indexType,
+        allocation.indexOffset(), numInstances, static_cast<GLint>(allocation.firstVertex));
+}
+
+void MeshArena::multiDrawElements(std::span<const Allocation> allocations)
+{
+    m_drawCounts.clear();
+    m_drawIndexOffsets.clear();
+    m_drawBaseVertices.clear();
+    if (allocations.empty())
+        return;
+    for (const Allocation& allocation : allocations) {
+        assert(allocation.indexType == allocations[0].indexType);
+        m_drawCounts.push_back(static_cast<GLsizei>(allocation.numIndices));
+        m_drawIndexOffsets.push_back(allocation.indexOffset());
+        m_drawBaseVertices.push_back(static_cast<GLint>(allocation.firstVertex));
+    }
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_drawCounts.data(), allocations[0].indexType, m_drawIndexOffsets.data(),
+        static_cast<GLsizei>(allocations.size()), m_drawBaseVertices.data());
+}
+
+size_t MeshArena::numIndexSlots(size_t numIndices, GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? (numIndices + 1) / 2 : numIndices;
+}
+
+size_t MeshArena::vertexSize() const
+{
+    return m_format == VertexFormat::Quantized ? sizeof(QuantizedVertex) : sizeof(Vertex);
+}
+
+size_t MeshArena::positionSize() const
+{
+    return m_format == VertexFormat::Quantized ? sizeof(QuantizedPosition) : sizeof(glm::vec3);
+}
+
+void MeshArena::multiDrawElements(const Allocation& allocation, std::span<const IndexRange> ranges)
+{
+    const size_t indexSize = allocation.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    m_drawCounts.clear();
+    m_drawIndexOffsets.clear();
+    m_drawBaseVertices.clear();
+    for (const IndexRange& range : ranges) {
+        assert(range.firstIndex + range.numIndices <= allocation.numIndices);
+        m_drawCounts.push_back(static_cast<GLsizei>(range.numIndices));
+        m_drawIndexOffsets.push_back((const void*)((allocation.firstIndex + range.firstIndex) * indexSize));
+        m_drawBaseVertices.push_back(static_cast<GLint>(allocation.firstVertex));
+    }
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_drawCounts.data(), allocation.indexType, m_drawIndexOffsets.data(),
+        static_cast<GLsizei>(ranges.size()), m_drawBaseVertices.data());
+}
+
+// Replace the buffer by a larger one holding the same contents
+void MeshArena::reallocateBuffer(GLuint& buffer, size_t oldSize, size_t newSize)
+{
+    GLuint newBuffer;
+    glGenBuffers(1, &newBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(newSize), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(oldSize));
+    glDeleteBuffers(1, &buffer);
+    buffer = newBuffer;
+}
+
+void MeshArena::setupVertexArray()
+{
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+
+    // Tell OpenGL that we will be using vertex attributes 0, 1 and 2.
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    // We tell OpenGL what each vertex looks like and how they are mapped to the shader (location = ...).
+    if (m_format == VertexFormat::Quantized) {
+        // Positions are normalized to [0, 1]. Normals are passed unnormalized: the conversion of normalized signed
+        // integers differs between OpenGL 4.1 and 4.2, so the shader divides by 32767 itself.
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, position));
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_FALSE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, normal));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, texCoord));
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+    }
+    // Reuse all attributes for each instance
+    glVertexAttribDivisor(0, 0);
+    glVertexAttribDivisor(1, 0);
+    glVertexAttribDivisor(2, 0);
+
+    if (hasPositionStream()) {
+        glBindVertexArray(m_positionVao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_positionVbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+        glEnableVertexAttribArray(0);
+        if (m_format == VertexFormat::Quantized)
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(QuantizedPosition), nullptr);
+        else
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+        glVertexAttribDivisor(0, 0);
+    }
+}
+
+void MeshArena::freeGpuMemory()
+{
+    if (m_vao != INVALID)
+        glDeleteVertexArrays(1, &m_vao);
+    if (m_vbo != INVALID)
+        glDeleteBuffers(1, &m_vbo);
+    if (m_ibo != INVALID)
+        glDeleteBuffers(1, &m_ibo);
+    if (m_positionVao != INVALID)
+        glDeleteVertexArrays(1, &m_positionVao);
+    if (m_positionVbo != INVALID)
+        glDeleteBuffers(1, &m_positionVbo);
+}
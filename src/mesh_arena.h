@@ -0,0 +1,139 @@
+#pragma once
+
+#include "vertex_quantization.h"
+#include <framework/disable_all_warnings.h>
+#include <framework/mesh.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/opengl_includes.h>
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <span>
+#include <vector>
+
+// First-fit allocator of ranges in [0, capacity). Free ranges are kept sorted by offset so neighbours merge on free.
+class RangeAllocator {
+public:
+    explicit RangeAllocator(size_t capacity);
+
+    std::optional<size_t> allocate(size_t size);
+    void free(size_t offset, size_t size);
+    // Append [capacity, newCapacity) to the free ranges.
+    void grow(size_t newCapacity);
+
+    size_t capacity() const;
+
+private:
+    std::map<size_t, size_t> m_freeRanges; // Offset to size
+    size_t m_capacity;
+};
+
+// Vertex streams of a MeshArena: all attributes interleaved, or a tightly packed copy of only the positions
+enum class VertexStream {
+    Interleaved,
+    Position
+};
+
+// Layout of the vertices in a MeshArena: the full float Vertex (32 bytes), or QuantizedVertex (16 bytes)
+enum class VertexFormat {
+    Float,
+    Quantized
+};
+
+// One vertex buffer and one index buffer (with a single VAO) shared by all meshes of the "Vertex" format. A mesh is
+// a range of vertices and a range of indices in these buffers, drawn with a base vertex, so drawing different meshes
+// does not require binding a different vertex array. The buffers grow (by copying) when they run out of space.
+// Optionally the arena also keeps the positions in a separate buffer, with a second VAO that only has attribute 0:
+// depth-only passes fetch 12 instead of 32 bytes per vertex. Both streams use the same vertex and index ranges.
+// With VertexFormat::Quantized the vertices are encoded on upload and the position stream holds 8 byte positions;
+// shaders decode them with the VertexQuantization of the mesh (see GPUMesh::bindMaterial()).
+// Indices are relative to the base vertex, so meshes with at most 65536 vertices are stored with 16 bit indices. The
+// index buffer is allocated in 32 bit slots; a 16 bit mesh takes half as many, starting at an even index.
+class MeshArena {
+public:
+    struct Allocation {
+        uint32_t firstVertex { 0 };
+        uint32_t numVertices { 0 };
+        uint32_t firstIndex { 0 }; // In units of the index type
+        uint32_t numIndices { 0 };
+        GLenum indexType { GL_UNSIGNED_INT };
+
+        // Byte offset of the first index in the index buffer, as passed to glDrawElements
+        const void* indexOffset() const;
+    };
+
+    // Part of the indices of an allocation, relative to its first index
+    struct IndexRange {
+        uint32_t firstIndex { 0 };
+        uint32_t numIndices { 0 };
+    };
+
+    static constexpr size_t MAX_16BIT_VERTICES = 1 << 16;
+
+    explicit MeshArena(VertexFormat format = VertexFormat::Float, bool keepPositionStream = true);
+    MeshArena(const MeshArena&) = delete;
+    MeshArena(MeshArena&&) = delete;
+    ~MeshArena();
+
+    MeshArena& operator=(const MeshArena&) = delete;
+    MeshArena& operator=(MeshArena&&) = delete;
+
+    // Upload a mesh; triangle indices are relative to its own first vertex. Quantized arenas encode the vertices
+    // with the given quantization. Meshes with more than MAX_16BIT_VERTICES vertices fall back to 32 bit indices.
+    Allocation allocate(std::span<const Vertex> vertices, std::span<const glm::uvec3> triangles, const VertexQuantization& quantization = {});
+    void free(const Allocation& allocation);
+
+    VertexFormat format() const;
+    // GPU memory per vertex, summed over both streams.
+    size_t bytesPerVertex() const;
+    // Bytes of index data of all live allocations, and what they would take with only 32 bit indices.
+    size_t indexMemory() const;
+    size_t indexMemory32Bit() const;
+    bool hasPositionStream() const;
+    // The position stream falls back to the interleaved vertex array when the arena does not keep one.
+    void bindVertexArray(VertexStream stream = VertexStream::Interleaved) const;
+    void drawElements(const Allocation& allocation) const;
+    void drawElementsInstanced(const Allocation& allocation, GLsizei numInstances) const;
+    // Draw several meshes with one call; they have to share all other state, including uniforms and the index type.
+    void multiDrawElements(std::span<const Allocation> allocations);
+    // Draw some index ranges of one mesh with one call.
+    void multiDrawElements(const Allocation& allocation, std::span<const IndexRange> ranges);
+
+private:
+    size_t vertexSize() const;
+    size_t positionSize() const;
+    static size_t numIndexSlots(size_t numIndices, GLenum indexType);
+    void reallocateBuffer(GLuint& buffer, size_t oldSize, size_t newSize);
+    void setupVertexArray();
+    void freeGpuMemory();
+
+private:
+    static constexpr GLuint INVALID = 0xFFFFFFFF;
+    static constexpr size_t INITIAL_VERTEX_CAPACITY = 1 << 16;
+    static constexpr size_t INITIAL_INDEX_CAPACITY = 3 << 16; // 32 bit slots
+
+    VertexFormat m_format;
+    RangeAllocator m_vertexRanges { INITIAL_VERTEX_CAPACITY };
+    RangeAllocator m_indexRanges { INITIAL_INDEX_CAPACITY };
+    size_t m_numIndices { 0 };
+    size_t m_numIndexSlots { 0 };
+    GLuint m_vao { INVALID };
+    GLuint m_vbo { INVALID };
+    GLuint m_ibo { INVALID };
+    // Position stream, if kept
+    GLuint m_positionVao { INVALID };
+    GLuint m_positionVbo { INVALID };
+    // Encoded vertices and positions of the mesh being uploaded, kept to avoid allocating every call
+    std::vector<QuantizedVertex> m_quantizedStaging;
+    std::vector<QuantizedPosition> m_quantizedPositionStaging;
+    std::vector<glm::vec3> m_positionStaging;
+    std::vector<GLushort> m_shortIndexStaging;
+
+    // Argument arrays of multiDrawElements(), kept to avoid allocating every call
+    std::vector<GLsizei> m_drawCounts;
+    std::vector<const void*> m_drawIndexOffsets;
+    std::vector<GLint> m_drawBaseVertices;
+};
@@ -0,0 +1,88 @@
+#include "meshlet_culling.h"
+#include "culling.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+DISABLE_WARNINGS_POP()
+
+void MeshletCulling::update(std::span<const Renderable> renderables, std::span<const uint8_t> visibleRenderables,
+    std::span<const glm::mat4> modelMatrices, std::span<const glm::mat4> mvpMatrices, const glm::vec3& cameraPosition)
+{
+    m_firstRange.assign(renderables.size(), NO_MESHLETS);
+    m_numRanges.assign(renderables.size(), 0);
+    m_ranges.clear();
+    m_numMeshlets = m_numVisibleMeshlets = m_numTriangles = m_numVisibleTriangles = 0;
+
+    for (size_t drawID = 0; drawID < renderables.size(); drawID++) {
+        const std::span<const Meshlet> meshlets = renderables[drawID].mesh->meshlets();
+        if (meshlets.empty() || !visibleRenderables[drawID])
+            continue;
+
+        // The planes of the model-view-projection matrix are the frustum planes in object space
+        const Frustum frustum(mvpMatrices[drawID]);
+        const glm::vec3 objectCameraPosition = glm::inverse(modelMatrices[drawID]) * glm::vec4(cameraPosition, 1.0f);
+        // Mirroring turns front faces into back faces
+        const bool coneCulling = glm::determinant(glm::mat3(modelMatrices[drawID])) > 0.0f;
+
+        m_firstRange[drawID] = static_cast<uint32_t>(m_ranges.size());
+        for (const Meshlet& meshlet : meshlets) {
+            m_numMeshlets++;
+            m_numTriangles += meshlet.numTriangles;
+
+            bool visible = true;
+            for (const glm::vec4& plane : frustum.planes)
+                visible &= glm::dot(glm::vec3(plane), meshlet.boundingSphere.center) + plane.w >= -meshlet.boundingSphere.radius;
+            if (visible && coneCulling) {
+                const glm::vec3 toApex = meshlet.coneApex - objectCameraPosition;
+                const float distance = glm::length(toApex);
+                visible = distance == 0.0f || glm::dot(toApex, meshlet.coneAxis) < meshlet.coneCutoff * distance;
+            }
+            if (!visible)
+                continue;
+
+            m_numVisibleMeshlets++;
+            m_numVisibleTriangles += meshlet.numTriangles;
+            // Meshlets are consecutive runs of triangles, so neighbours merge into one range
+            const MeshArena::IndexRange range { 3 * meshlet.firstTriangle, 3 * meshlet.numTriangles };
+            if (m_numRanges[drawID] > 0 && m_ranges.back().firstIndex + m_ranges.back().numIndices == range.firstIndex) {
+                m_ranges.back().numIndices += range.numIndices;
+            } else {
+                m_ranges.push_back(range);
+                m_numRanges[drawID]++;
+            }
+        }
+    }
+}
+
+bool MeshletCulling::hasMeshlets(uint32_t drawID) const
+{
+    return drawID < m_firstRange.size() && m_firstRange[drawID] != NO_MESHLETS;
+}
+
+std::span<const MeshArena::IndexRange> MeshletCulling::visibleRanges(uint32_t drawID) const
+{
+    if (!hasMeshlets(drawID))
+        return {};
+    return std::span(m_ranges).subspan(m_firstRange[drawID], m_numRanges[drawID]);
+}
+
+size_t MeshletCulling::numMeshlets() const
+{
+    return m_numMeshlets;
+}
+
+size_t MeshletCulling::numVisibleMeshlets() const
+{
+    return m_numVisibleMeshlets;
+}
+
+size_t MeshletCulling::numTriangles() const
+{
+    return m_numTriangles;
+}
+
+size_t MeshletCulling::numVisibleTriangles() const
+{
+    return m_numVisibleTriangles;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "mesh_arena.h"
+#include "renderable.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Per-frame culling of the meshlets of visible renderables whose mesh has them (see GPUMesh::meshlets()). Meshlets
+// outside of the view frustum or facing away from the camera are dropped, and the index ranges of the remaining
+// ones, merged where they are adjacent, are drawn with one multi-draw per renderable. All tests run in object space,
+// where the meshlet bounds and cones were computed.
+class MeshletCulling {
+public:
+    void update(std::span<const Renderable> renderables, std::span<const uint8_t> visibleRenderables,
+        std::span<const glm::mat4> modelMatrices, std::span<const glm::mat4> mvpMatrices, const glm::vec3& cameraPosition);
+
+    // Whether the renderable is drawn with the ranges below instead of its whole mesh.
+    bool hasMeshlets(uint32_t drawID) const;
+    // Index ranges of the visible meshlets of the renderable; empty when all of them were culled.
+    std::span<const MeshArena::IndexRange> visibleRanges(uint32_t drawID) const;
+
+    size_t numMeshlets() const;
+    size_t numVisibleMeshlets() const;
+    size_t numTriangles() const;
+    size_t numVisibleTriangles() const;
+
+private:
+    static constexpr uint32_t NO_MESHLETS = 0xFFFFFFFF;
+
+    std::vector<uint32_t> m_firstRange; // Per renderable, or NO_MESHLETS
+    std::vector<uint32_t> m_numRanges;
+    std::vector<MeshArena::IndexRange> m_ranges;
+    size_t m_numMeshlets { 0 };
+    size_t m_numVisibleMeshlets { 0 };
+    size_t m_numTriangles { 0 };
+    size_t m_numVisibleTriangles { 0 };
+};
@@ -0,0 +1,115 @@
+#include "object_constants.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/gtc/matrix_inverse.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(GPUObjectConstants) == 176);
+
+ObjectConstantsBuffer::ObjectConstantsBuffer()
+{
+    GLint offsetAlignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    m_stride = (static_cast<GLsizeiptr>(sizeof(GPUObjectConstants)) + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+}
+
+ObjectConstantsBuffer::~ObjectConstantsBuffer()
+{
+    freeGpuMemory();
+}
+
+void ObjectConstantsBuffer::update(std::span<const Renderable> renderables, const glm::mat4& viewProjectionMatrix)
+{
+    // ======== COMPUTE STAGE ========
+    // Every iteration is independent, so this loop can be split over threads as the scene grows.
+    const size_t numObjects = renderables.size();
+    m_modelMatrices.resize(numObjects);
+    m_mvpMatrices.resize(numObjects);
+    m_normalModelMatrices.resize(numObjects);
+    for (size_t i = 0; i < numObjects; i++) {
+        m_modelMatrices[i] = renderables[i].modelMat;
+        m_mvpMatrices[i] = viewProjectionMatrix * m_modelMatrices[i];
+        m_normalModelMatrices[i] = glm::inverseTranspose(glm::mat3(m_modelMatrices[i]));
+    }
+    if (numObjects == 0)
+        return;
+
+    // ======== UPLOAD STAGE ========
+    // Fence the region that the draws of the previous frame read from, then move on to the next region.
+    // Before overwriting that region wait until the GPU is done with the frame that last used it.
+    if (m_ubo != INVALID)
+        m_fences[m_currentRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_currentRegion = (m_currentRegion + 1) % NUM_REGIONS;
+    reserve(numObjects);
+    if (m_fences[m_currentRegion]) {
+        glClientWaitSync(m_fences[m_currentRegion], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(m_fences[m_currentRegion]);
+        m_fences[m_currentRegion] = nullptr;
+    }
+
+    const GLintptr regionOffset = static_cast<GLintptr>(m_currentRegion * m_capacity) * m_stride;
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    std::byte* pMapped = static_cast<std::byte*>(glMapBufferRange(GL_UNIFORM_BUFFER, regionOffset, static_cast<GLsizeiptr>(numObjects) * m_stride,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    for (size_t i = 0; i < numObjects; i++) {
+        const GPUObjectConstants constants { m_mvpMatrices[i], m_modelMatrices[i], glm::mat3x4(m_normalModelMatrices[i]) };
+        std::memcpy(pMapped + static_cast<GLsizeiptr>(i) * m_stride, &constants, sizeof(constants));
+    }
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+}
+
+void ObjectConstantsBuffer::bind(const Shader& shader, size_t drawID) const
+{
+    const GLintptr offset = static_cast<GLintptr>(m_currentRegion * m_capacity + drawID) * m_stride;
+    shader.bindUniformBlock("ObjectConstants", BINDING, m_ubo, offset, sizeof(GPUObjectConstants));
+}
+
+std::span<const glm::mat4> ObjectConstantsBuffer::modelMatrices() const
+{
+    return m_modelMatrices;
+}
+
+std::span<const glm::mat4> ObjectConstantsBuffer::mvpMatrices() const
+{
+    return m_mvpMatrices;
+}
+
+std::span<const glm::mat3> ObjectConstantsBuffer::normalModelMatrices() const
+{
+    return m_normalModelMatrices;
+}
+
+void ObjectConstantsBuffer::reserve(size_t numObjects)
+{
+    if (numObjects <= m_capacity)
+        return;
+
+    // Growing re-creates the buffer, so all regions must be idle first.
+    for (GLsync& fence : m_fences) {
+        if (fence) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    freeGpuMemory();
+
+    m_capacity = std::max(numObjects, 2 * m_capacity);
+    glGenBuffers(1, &m_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(NUM_REGIONS * m_capacity) * m_stride, nullptr, GL_DYNAMIC_DRAW);
+}
+
+void ObjectConstantsBuffer::freeGpuMemory()
+{
+    for (GLsync fence : m_fences) {
+        if (fence)
+            glDeleteSync(fence);
+    }
+    m_fences = {};
+    if (m_ubo != INVALID)
+        glDeleteBuffers(1, &m_ubo);
+    m_ubo = INVALID;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "renderable.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat3x3.hpp>
+#include <glm/mat3x4.hpp>
+#include <glm/mat4x4.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/opengl_includes.h>
+#include <framework/shader.h>
+
+#include <array>
+#include <span>
+#include <vector>
+
+// GPU representation of the "ObjectConstants" block in the vertex shaders (std140).
+struct GPUObjectConstants {
+    glm::mat4 mvpMatrix;
+    glm::mat4 modelMatrix;
+    glm::mat3x4 normalModelMatrix; // std140 stores each mat3 column as a vec4
+};
+
+// Per-frame object constants stage: the matrices of every renderable are computed exactly once per frame and
+// uploaded to a ring-buffered uniform buffer. Every pass then binds the constants of a draw by its draw ID (the
+// index of the renderable) instead of recomputing and re-uploading them.
+class ObjectConstantsBuffer {
+public:
+    static constexpr GLuint BINDING = 2; // Binding points 0 and 1 are used by the "Material" and "Lights" blocks
+
+    ObjectConstantsBuffer();
+    ObjectConstantsBuffer(const ObjectConstantsBuffer&) = delete;
+    ObjectConstantsBuffer(ObjectConstantsBuffer&&) = delete;
+    ~ObjectConstantsBuffer();
+
+    ObjectConstantsBuffer& operator=(const ObjectConstantsBuffer&) = delete;
+    ObjectConstantsBuffer& operator=(ObjectConstantsBuffer&&) = delete;
+
+    void update(std::span<const Renderable> renderables, const glm::mat4& viewProjectionMatrix);
+
+    // Bind the constants of the given draw to the "ObjectConstants" block of the shader.
+    void bind(const Shader& shader, size_t drawID) const;
+
+    // Matrices as computed this frame, stored as structure of arrays and indexed by draw ID.
+    std::span<const glm::mat4> modelMatrices() const;
+    std::span<const glm::mat4> mvpMatrices() const;
+    std::span<const glm::mat3> normalModelMatrices() const;
+
+private:
+    void reserve(size_t numObjects);
+    void freeGpuMemory();
+
+private:
+    // Number of frames that the CPU may run ahead of the GPU before it has to wait on a fence.
+    static constexpr size_t NUM_REGIONS = 3;
+    static constexpr GLuint INVALID = 0xFFFFFFFF;
+
+    std::vector<glm::mat4> m_modelMatrices;
+    std::vector<glm::mat4> m_mvpMatrices;
+    std::vector<glm::mat3> m_normalModelMatrices;
+
+    GLuint m_ubo { INVALID };
+    GLsizeiptr m_stride { 0 }; // sizeof(GPUObjectConstants) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    size_t m_capacity { 0 }; // Number of objects that fit in one region
+    size_t m_currentRegion { 0 };
+    std::array<GLsync, NUM_REGIONS> m_fences {};
+};
@@ -0,0 +1,220 @@
+#include "occlusion_culling.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+// Triangles with a vertex this close to (or behind) the eye are skipped instead of clipped, which only makes the
+// occluders smaller and thus keeps the test conservative
+static constexpr float MIN_CLIP_W = 1e-3f;
+// Below this many triangles starting threads costs more than it saves
+static constexpr size_t MIN_TRIANGLES_PER_THREAD = 64;
+
+OccluderMesh::OccluderMesh(const Mesh& mesh)
+    : triangles(mesh.triangles)
+{
+    positions.reserve(mesh.vertices.size());
+    for (const Vertex& vertex : mesh.vertices)
+        positions.push_back(vertex.position);
+}
+
+OccluderMesh::OccluderMesh(std::span<const MeshCache::SubMesh> subMeshes)
+{
+    for (const MeshCache::SubMesh& subMesh : subMeshes) {
+        const glm::uvec3 firstVertex { static_cast<unsigned>(positions.size()) };
+        for (const glm::uvec3& triangle : subMesh.triangles)
+            triangles.push_back(firstVertex + triangle);
+        for (const Vertex& vertex : subMesh.vertices)
+            positions.push_back(vertex.position);
+    }
+}
+
+void OcclusionCuller::clear()
+{
+    m_triangles.clear();
+}
+
+void OcclusionCuller::addOccluder(const OccluderMesh& occluder, const glm::mat4& mvpMatrix)
+{
+    std::vector<glm::vec4> clipPositions;
+    clipPositions.reserve(occluder.positions.size());
+    for (const glm::vec3& position : occluder.positions)
+        clipPositions.push_back(mvpMatrix * glm::vec4(position, 1.0f));
+
+    for (const glm::uvec3& triangle : occluder.triangles) {
+        const glm::vec4 clip[3] { clipPositions[triangle[0]], clipPositions[triangle[1]], clipPositions[triangle[2]] };
+        if (clip[0].w < MIN_CLIP_W || clip[1].w < MIN_CLIP_W || clip[2].w < MIN_CLIP_W)
+            continue;
+        // Completely outside of one of the side, top or bottom planes
+        bool outside = false;
+        for (int axis = 0; axis < 2; axis++) {
+            outside |= clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w;
+            outside |= clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w;
+        }
+        if (outside)
+            continue;
+
+        ScreenTriangle screenTriangle;
+        for (int i = 0; i < 3; i++) {
+            const glm::vec3 ndc = glm::vec3(clip[i]) / clip[i].w;
+            screenTriangle.vertices[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT, ndc.z * 0.5f + 0.5f);
+        }
+        m_triangles.push_back(screenTriangle);
+    }
+}
+
+void OcclusionCuller::rasterize()
+{
+    m_pyramid.resize(1);
+    m_pyramid[0].assign(WIDTH * HEIGHT, 1.0f);
+
+    // Every thread rasterizes all triangles, but only into its own band of rows
+    const size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    const int numBands = static_cast<int>(std::clamp(m_triangles.size() / MIN_TRIANGLES_PER_THREAD, size_t(1), std::min(maxThreads, size_t(8))));
+    const int rowsPerBand = (HEIGHT + numBands - 1) / numBands;
+    std::vector<std::thread> threads;
+    for (int band = 1; band < numBands; band++)
+        threads.emplace_back(&OcclusionCuller::rasterizeBand, this, band * rowsPerBand, std::min((band + 1) * rowsPerBand, HEIGHT));
+    rasterizeBand(0, std::min(rowsPerBand, HEIGHT));
+    for (std::thread& thread : threads)
+        thread.join();
+
+    buildPyramid();
+}
+
+bool OcclusionCuller::isVisible(const AxisAlignedBox& bounds, const glm::mat4& mvpMatrix) const
+{
+    if (m_pyramid.empty())
+        return true;
+
+    glm::vec3 ndcMin { std::numeric_limits<float>::max() }, ndcMax { std::numeric_limits<float>::lowest() };
+    for (int corner = 0; corner < 8; corner++) {
+        const glm::vec3 position { corner & 1 ? bounds.upper.x : bounds.lower.x, corner & 2 ? bounds.upper.y : bounds.lower.y, corner & 4 ? bounds.upper.z : bounds.lower.z };
+        const glm::vec4 clip = mvpMatrix * glm::vec4(position, 1.0f);
+        // Crossing the eye plane, the screen space bounds would be meaningless
+        if (clip.w < MIN_CLIP_W)
+            return true;
+        const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcMin = glm::min(ndcMin, ndc);
+        ndcMax = glm::max(ndcMax, ndc);
+    }
+    // Boxes outside of the screen are left to frustum culling
+    if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+        return true;
+
+    const float nearestDepth = ndcMin.z * 0.5f + 0.5f;
+    const int minX = std::clamp(static_cast<int>((ndcMin.x * 0.5f + 0.5f) * WIDTH), 0, WIDTH - 1);
+    const int maxX = std::clamp(static_cast<int>((ndcMax.x * 0.5f + 0.5f) * WIDTH), 0, WIDTH - 1);
+    const int minY = std::clamp(static_cast<int>((ndcMin.y * 0.5f + 0.5f) * HEIGHT), 0, HEIGHT - 1);
+    const int maxY = std::clamp(static_cast<int>((ndcMax.y * 0.5f + 0.5f) * HEIGHT), 0, HEIGHT - 1);
+
+    // Coarsest level at which the rectangle still covers at most 2x2 texels
+    size_t level = 0;
+    while (level + 1 < m_pyramid.size() && ((maxX >> level) - (minX >> level) > 1 || (maxY >> level) - (minY >> level) > 1))
+        level++;
+
+    const int levelWidth = std::max(WIDTH >> level, 1);
+    for (int y = minY >> level; y <= maxY >> level; y++) {
+        for (int x = minX >> level; x <= maxX >> level; x++) {
+            if (nearestDepth <= m_pyramid[level][static_cast<size_t>(y * levelWidth + x)])
+                return true;
+        }
+    }
+    return false;
+}
+
+size_t OcclusionCuller::numOccluderTriangles() const
+{
+    return m_triangles.size();
+}
+
+std::span<const float> OcclusionCuller::depthBuffer() const
+{
+    return m_pyramid.empty() ? std::span<const float>() : std::span<const float>(m_pyramid[0]);
+}
+
+size_t OcclusionCuller::numPyramidLevels() const
+{
+    return m_pyramid.size();
+}
+
+std::span<const float> OcclusionCuller::pyramidLevel(size_t level) const
+{
+    return m_pyramid[level];
+}
+
+void OcclusionCuller::rasterizeBand(int firstRow, int endRow)
+{
+    for (const ScreenTriangle& triangle : m_triangles)
+        rasterizeTriangle(triangle, firstRow, endRow);
+}
+
+void OcclusionCuller::rasterizeTriangle(const ScreenTriangle& triangle, int firstRow, int endRow)
+{
+    glm::vec3 v0 = triangle.vertices[0], v1 = triangle.vertices[1], v2 = triangle.vertices[2];
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (std::abs(area) < 1e-6f)
+        return;
+    // Counter-clockwise, such that the edge functions are positive inside; occluders are not backface culled
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    // Pixel centers inside the bounding box (clamped to this band), with the first column aligned to a SIMD group
+    const int minX = std::max(static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x }))), 0) & ~3;
+    const int maxX = std::min(static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x }))), WIDTH - 1);
+    const int minY = std::max(static_cast<int>(std::floor(std::min({ v0.y, v1.y, v2.y }))), firstRow);
+    const int maxY = std::min(static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y }))), endRow - 1);
+    if (minX > maxX || minY > maxY)
+        return;
+
+    // Edge function a * x + b * y + c of the edge opposite to each vertex; divided by the area they are the
+    // barycentric coordinates, which also interpolate the (screen space linear) depth
+    const auto edge = [](const glm::vec3& from, const glm::vec3& to) {
+        return glm::vec3(from.y - to.y, to.x - from.x, from.x * to.y - from.y * to.x);
+    };
+    const glm::vec3 edges[3] { edge(v1, v2), edge(v2, v0), edge(v0, v1) };
+    const glm::vec3 depthPlane = (edges[0] * v0.z + edges[1] * v1.z + edges[2] * v2.z) / area;
+
+    using simd::Float4;
+    const float pixelOffsets[4] { 0.5f, 1.5f, 2.5f, 3.5f };
+    const Float4 zero = Float4::broadcast(0.0f);
+    const Float4 edgeA[3] { Float4::broadcast(edges[0].x), Float4::broadcast(edges[1].x), Float4::broadcast(edges[2].x) };
+    const Float4 depthA = Float4::broadcast(depthPlane.x);
+    for (int y = minY; y <= maxY; y++) {
+        const float pixelY = float(y) + 0.5f;
+        const Float4 edgeRow[3] { Float4::broadcast(edges[0].y * pixelY + edges[0].z), Float4::broadcast(edges[1].y * pixelY + edges[1].z), Float4::broadcast(edges[2].y * pixelY + edges[2].z) };
+        const Float4 depthRow = Float4::broadcast(depthPlane.y * pixelY + depthPlane.z);
+        float* pRow = &m_pyramid[0][static_cast<size_t>(y * WIDTH)];
+
+        for (int x = minX; x <= maxX; x += 4) {
+            const Float4 pixelX = Float4::broadcast(float(x)) + Float4::load(pixelOffsets);
+            const Float4 inside = simd::maskAnd(simd::greaterEqual(edgeA[0] * pixelX + edgeRow[0], zero),
+                simd::maskAnd(simd::greaterEqual(edgeA[1] * pixelX + edgeRow[1], zero), simd::greaterEqual(edgeA[2] * pixelX + edgeRow[2], zero)));
+            if (simd::bitMask(inside) == 0)
+                continue;
+
+            const Float4 depth = depthA * pixelX + depthRow;
+            const Float4 previousDepth = Float4::load(pRow + x);
+            simd::select(inside, simd::min(depth, previousDepth), previousDepth).store(pRow + x);
+        }
+    }
+}
+
+void OcclusionCuller::buildPyramid()
+{
+    for (int levelWidth = WIDTH / 2, levelHeight = HEIGHT / 2; levelWidth >= 1 && levelHeight >= 1; levelWidth /= 2, levelHeight /= 2) {
+        const std::vector<float>& finer = m_pyramid.back();
+        const size_t finerWidth = static_cast<size_t>(levelWidth) * 2;
+        std::vector<float> coarser(static_cast<size_t>(levelWidth * levelHeight));
+        for (int y = 0; y < levelHeight; y++) {
+            for (int x = 0; x < levelWidth; x++) {
+                const size_t finerIdx = static_cast<size_t>(2 * y) * finerWidth + static_cast<size_t>(2 * x);
+                coarser[static_cast<size_t>(y * levelWidth + x)] = std::max({ finer[finerIdx], finer[finerIdx + 1], finer[finerIdx + finerWidth], finer[finerIdx + finerWidth + 1] });
+            }
+        }
+        m_pyramid.push_back(std::move(coarser));
+    }
+}
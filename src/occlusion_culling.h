@@ -0,0 +1,62 @@
+#pragma once
+
+#include <framework/disable_all_warnings.h>
+#include <framework/mesh.h>
+#include <framework/mesh_cache.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <span>
+#include <vector>
+
+// Object-space triangles of a mesh that hides other renderables, kept on the CPU for the occlusion rasterizer.
+struct OccluderMesh {
+    explicit OccluderMesh(const Mesh& mesh);
+    // All sub-meshes of a mapped mesh cache as one occluder.
+    explicit OccluderMesh(std::span<const MeshCache::SubMesh> subMeshes);
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::uvec3> triangles;
+};
+
+// Software occlusion culling: a few large occluders are rasterized into a low resolution depth buffer on the CPU
+// (multithreaded over horizontal bands, 4 pixels at a time), from which a pyramid of per-tile maximum depths is built.
+// A box is occluded when its nearest depth lies behind the farthest occluder depth of every pyramid texel it covers.
+// Does not use OpenGL.
+class OcclusionCuller {
+public:
+    static constexpr int WIDTH = 256;
+    static constexpr int HEIGHT = 256;
+
+    void clear();
+    void addOccluder(const OccluderMesh& occluder, const glm::mat4& mvpMatrix);
+    // Rasterize the occluders added since clear() and build the depth pyramid.
+    void rasterize();
+
+    // Conservative: returns true unless the object-space box is certainly hidden by the occluders.
+    bool isVisible(const AxisAlignedBox& bounds, const glm::mat4& mvpMatrix) const;
+
+    size_t numOccluderTriangles() const;
+    // Normalized [0, 1] depth of the full resolution level, row by row from the bottom of the screen.
+    std::span<const float> depthBuffer() const;
+    // Level 0 is depthBuffer(); level i is (WIDTH >> i) by (HEIGHT >> i) texels, each the maximum of 2x2 texels of level i - 1.
+    size_t numPyramidLevels() const;
+    std::span<const float> pyramidLevel(size_t level) const;
+
+private:
+    // Vertices in pixel coordinates with depth in [0, 1]
+    struct ScreenTriangle {
+        glm::vec3 vertices[3];
+    };
+
+    void rasterizeBand(int firstRow, int endRow);
+    void rasterizeTriangle(const ScreenTriangle& triangle, int firstRow, int endRow);
+    void buildPyramid();
+
+private:
+    std::vector<ScreenTriangle> m_triangles;
+    // Level 0 is the depth buffer itself, every next level holds the maximum of 2x2 texels of the previous one
+    std::vector<std::vector<float>> m_pyramid;
+};
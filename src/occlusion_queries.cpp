@@ -0,0 +1,133 @@
+#include "occlusion_queries.h"
+#include "culling.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+
+// Boxes are inflated by this distance before testing whether they contain the camera, such that boxes that are
+// cut by the near plane are not falsely reported as hidden
+static constexpr float CAMERA_MARGIN = 0.5f;
+
+OcclusionQueries::OcclusionQueries()
+{
+    // The conservative variant (OpenGL 4.3) may be answered from coarser depth data and is cheaper
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    m_queryTarget = major > 4 || (major == 4 && minor >= 3) ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+
+    // The box vertices are generated in the vertex shader, but a vertex array still has to be bound
+    glGenVertexArrays(1, &m_boxVao);
+}
+
+OcclusionQueries::~OcclusionQueries()
+{
+    freeGpuMemory();
+}
+
+void OcclusionQueries::beginFrame(size_t numRenderables)
+{
+    for (size_t drawID = numRenderables; drawID < m_states.size(); drawID++) {
+        if (m_states[drawID].query != INVALID)
+            glDeleteQueries(1, &m_states[drawID].query);
+    }
+    m_states.resize(numRenderables);
+    m_actions.resize(numRenderables);
+    m_frame++;
+
+    for (size_t drawID = 0; drawID < numRenderables; drawID++) {
+        RenderableState& state = m_states[drawID];
+        state.boundsQueried = false;
+        if (state.pending) {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint anySamplesPassed = GL_FALSE;
+                glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &anySamplesPassed);
+                state.visible = anySamplesPassed;
+                state.pending = false;
+            }
+        }
+
+        if (state.pending) {
+            // The previous query is still in flight and cannot be reissued; assume visible until it returns
+            m_actions[drawID] = Action::Draw;
+        } else if (!state.visible) {
+            m_actions[drawID] = Action::QueryBounds;
+        } else {
+            // Spread the queries of visible renderables evenly over the frames
+            m_actions[drawID] = (m_frame + drawID) % VISIBLE_QUERY_INTERVAL == 0 ? Action::DrawAndQuery : Action::Draw;
+        }
+    }
+}
+
+OcclusionQueries::Action OcclusionQueries::action(size_t drawID) const
+{
+    return m_actions[drawID];
+}
+
+void OcclusionQueries::beginQuery(size_t drawID)
+{
+    RenderableState& state = m_states[drawID];
+    if (state.query == INVALID)
+        glGenQueries(1, &state.query);
+    glBeginQuery(m_queryTarget, state.query);
+    state.pending = true;
+}
+
+void OcclusionQueries::endQuery()
+{
+    glEndQuery(m_queryTarget);
+}
+
+void OcclusionQueries::queryBounds(const Shader& boundingBoxShader, size_t drawID, const AxisAlignedBox& bounds, const glm::mat4& modelMatrix,
+    const glm::mat4& viewProjectionMatrix, const glm::vec3& cameraPosition)
+{
+    const AxisAlignedBox worldBounds = transformBounds(bounds, modelMatrix);
+    const glm::vec3 center = 0.5f * (worldBounds.lower + worldBounds.upper);
+    const glm::vec3 extent = 0.5f * (worldBounds.upper - worldBounds.lower) + CAMERA_MARGIN;
+    if (glm::all(glm::lessThanEqual(glm::abs(cameraPosition - center), extent))) {
+        // Not queried, so the conditional render calls are no-ops and the renderable is drawn unconditionally
+        m_states[drawID].visible = true;
+        return;
+    }
+
+    boundingBoxShader.setUniform("mvpMatrix", viewProjectionMatrix * modelMatrix);
+    boundingBoxShader.setUniform("boxLower", bounds.lower);
+    boundingBoxShader.setUniform("boxUpper", bounds.upper);
+    glBindVertexArray(m_boxVao);
+    beginQuery(drawID);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 14);
+    endQuery();
+    m_states[drawID].boundsQueried = true;
+}
+
+void OcclusionQueries::beginConditionalRender(size_t drawID) const
+{
+    // Let the GPU wait for the result rather than draw regardless, the query was issued just before
+    if (m_states[drawID].boundsQueried)
+        glBeginConditionalRender(m_states[drawID].query, GL_QUERY_WAIT);
+}
+
+void OcclusionQueries::endConditionalRender(size_t drawID) const
+{
+    if (m_states[drawID].boundsQueried)
+        glEndConditionalRender();
+}
+
+size_t OcclusionQueries::numHidden() const
+{
+    return static_cast<size_t>(std::count_if(std::begin(m_states), std::end(m_states), [](const RenderableState& state) { return !state.visible; }));
+}
+
+void OcclusionQueries::freeGpuMemory()
+{
+    for (RenderableState& state : m_states) {
+        if (state.query != INVALID)
+            glDeleteQueries(1, &state.query);
+    }
+    if (m_boxVao != INVALID)
+        glDeleteVertexArrays(1, &m_boxVao);
+}
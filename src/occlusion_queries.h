@@ -0,0 +1,73 @@
+#pragma once
+
+#include <framework/disable_all_warnings.h>
+#include <framework/mesh.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/opengl_includes.h>
+#include <framework/shader.h>
+
+#include <cstdint>
+#include <vector>
+
+// Hardware occlusion queries with temporal coherence (in the style of CHC++). Renderables that were visible in the
+// previous frame are drawn as usual and only re-queried every few frames, wrapped around their depth prepass draw.
+// Renderables that were hidden are skipped in the depth prepass; instead their bounding box is queried against the
+// prepass depth, and they are drawn with conditional rendering on that query. Results are only read once available,
+// so the CPU never waits on the GPU; the GPU itself resolves the conditional draws.
+class OcclusionQueries {
+public:
+    enum class Action {
+        Draw, // Visible, no query this frame
+        DrawAndQuery, // Visible, query the depth prepass draw to find out whether it still is
+        QueryBounds // Hidden, query its bounding box and draw it conditionally
+    };
+
+    static constexpr uint32_t VISIBLE_QUERY_INTERVAL = 4; // Frames between the queries of a visible renderable
+
+    OcclusionQueries();
+    OcclusionQueries(const OcclusionQueries&) = delete;
+    OcclusionQueries(OcclusionQueries&&) = delete;
+    ~OcclusionQueries();
+
+    OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+    OcclusionQueries& operator=(OcclusionQueries&&) = delete;
+
+    // Collect the results that became available and decide the action of every renderable for this frame.
+    void beginFrame(size_t numRenderables);
+    Action action(size_t drawID) const;
+
+    void beginQuery(size_t drawID);
+    void endQuery();
+    // Query the bounding box of a hidden renderable with the bound bounding box shader (bounding_box_vert.glsl).
+    // When the camera is inside the box the query is skipped and the renderable is drawn unconditionally.
+    void queryBounds(const Shader& boundingBoxShader, size_t drawID, const AxisAlignedBox& bounds, const glm::mat4& modelMatrix,
+        const glm::mat4& viewProjectionMatrix, const glm::vec3& cameraPosition);
+
+    // Draws between these two calls are discarded by the GPU if the bounding box query of this frame failed.
+    void beginConditionalRender(size_t drawID) const;
+    void endConditionalRender(size_t drawID) const;
+
+    size_t numHidden() const;
+
+private:
+    struct RenderableState {
+        GLuint query { INVALID };
+        bool visible { true }; // According to the latest available result
+        bool pending { false }; // Query issued, result not read back yet
+        bool boundsQueried { false }; // A bounding box query was issued this frame
+    };
+
+    void freeGpuMemory();
+
+private:
+    static constexpr GLuint INVALID = 0xFFFFFFFF;
+
+    GLenum m_queryTarget;
+    GLuint m_boxVao { INVALID };
+    uint32_t m_frame { 0 };
+    std::vector<RenderableState> m_states;
+    std::vector<Action> m_actions;
+};
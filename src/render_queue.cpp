@@ -0,0 +1,173 @@
+#include "render_queue.h"
+#include "gpu_driven.h"
+#include "instancing.h"
+#include <algorithm>
+#include <cassert>
+
+uint64_t RenderQueue::makeSortKey(RenderPass pass, uint32_t shader, uint32_t textureSet, uint32_t mesh, float normalizedDepth)
+{
+    assert(shader <= MAX_SHADER_ID && textureSet <= MAX_TEXTURE_SET_ID && mesh <= MAX_MESH_ID);
+    const uint64_t depth = static_cast<uint64_t>(std::clamp(normalizedDepth, 0.0f, 1.0f) * 65535.0f);
+    return (uint64_t(pass) & 0xF) << 60
+        | (uint64_t(shader) & MAX_SHADER_ID) << 52
+        | (uint64_t(textureSet) & MAX_TEXTURE_SET_ID) << 36
+        | (uint64_t(mesh) & MAX_MESH_ID) << 16
+        | depth;
+}
+
+void RenderQueue::clear()
+{
+    m_items.clear();
+}
+
+void RenderQueue::push(uint64_t sortKey, uint32_t drawID)
+{
+    m_items.push_back({ sortKey, drawID });
+}
+
+void RenderQueue::sort()
+{
+    m_scratch.resize(m_items.size());
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        std::array<size_t, 256> offsets {};
+        for (const DrawItem& item : m_items)
+            offsets[(item.sortKey >> shift) & 0xFF]++;
+        // All keys share this byte, the pass would not change the order
+        if (std::find(std::begin(offsets), std::end(offsets), m_items.size()) != std::end(offsets))
+            continue;
+
+        size_t offset = 0;
+        for (size_t& bucket : offsets) {
+            const size_t count = bucket;
+            bucket = offset;
+            offset += count;
+        }
+        for (const DrawItem& item : m_items)
+            m_scratch[offsets[(item.sortKey >> shift) & 0xFF]++] = item;
+        std::swap(m_items, m_scratch);
+    }
+}
+
+std::span<const DrawItem> RenderQueue::items() const
+{
+    return m_items;
+}
+
+std::span<const DrawItem> RenderQueue::items(RenderPass pass) const
+{
+    const auto passOf = [](const DrawItem& item) { return RenderPass(item.sortKey >> 60); };
+    const auto begin = std::partition_point(std::begin(m_items), std::end(m_items), [&](const DrawItem& item) { return passOf(item) < pass; });
+    const auto end = std::partition_point(begin, std::end(m_items), [&](const DrawItem& item) { return passOf(item) == pass; });
+    return { begin, end };
+}
+
+bool RenderQueue::sameState(const DrawItem& lhs, const DrawItem& rhs)
+{
+    return (lhs.sortKey >> 16) == (rhs.sortKey >> 16);
+}
+
+void RenderStateCache::reset()
+{
+    m_pProgram = nullptr;
+    m_textures.fill(nullptr);
+    m_pMaterial = nullptr;
+    m_pVertexArray = nullptr;
+}
+
+void RenderStateCache::resetCounters()
+{
+    m_counters = {};
+}
+
+const RenderStateCache::Counters& RenderStateCache::counters() const
+{
+    return m_counters;
+}
+
+void RenderStateCache::useProgram(const Shader& shader, VertexStream stream)
+{
+    m_vertexStream = stream;
+    if (m_pProgram == &shader) {
+        m_counters.skippedBinds++;
+        return;
+    }
+    shader.bind();
+    m_pProgram = &shader;
+    // Uniform block bindings are per program, so the material has to be bound again
+    m_pMaterial = nullptr;
+    m_counters.programBinds++;
+}
+
+void RenderStateCache::bindTexture(GLint textureUnit, const Texture& texture)
+{
+    assert(textureUnit >= 0 && size_t(textureUnit) < NUM_TEXTURE_UNITS);
+    if (m_textures[size_t(textureUnit)] == &texture) {
+        m_counters.skippedBinds++;
+        return;
+    }
+    texture.bind(GL_TEXTURE0 + textureUnit);
+    m_textures[size_t(textureUnit)] = &texture;
+    m_counters.textureBinds++;
+}
+
+void RenderStateCache::drawMesh(const GPUMesh& mesh, size_t lod)
+{
+    bindMeshState(mesh);
+    mesh.drawElements(lod);
+    m_counters.drawCalls++;
+}
+
+void RenderStateCache::drawMeshRanges(const GPUMesh& mesh, std::span<const MeshArena::IndexRange> ranges)
+{
+    bindMeshState(mesh);
+    mesh.drawElementRanges(ranges);
+    m_counters.drawCalls++;
+}
+
+void RenderStateCache::drawMeshRanges(const GPUMesh& mesh, const InstanceBuffer& instanceBuffer, size_t instance, std::span<const MeshArena::IndexRange> ranges)
+{
+    bindMeshState(mesh);
+    // A non-instanced draw reads the first instance of the divisor 1 attributes
+    instanceBuffer.enableAttributes(instance);
+    mesh.drawElementRanges(ranges);
+    m_counters.drawCalls++;
+    instanceBuffer.disableAttributes();
+}
+
+void RenderStateCache::drawMeshInstanced(const GPUMesh& mesh, const InstanceBuffer& instanceBuffer, size_t firstInstance, size_t numInstances, size_t lod)
+{
+    bindMeshState(mesh);
+    instanceBuffer.enableAttributes(firstInstance);
+    mesh.drawElementsInstanced(static_cast<GLsizei>(numInstances), lod);
+    m_counters.drawCalls++;
+    instanceBuffer.disableAttributes();
+}
+
+void RenderStateCache::drawBucketIndirect(const GPUMesh& mesh, const GpuDrivenScene& scene, size_t bucket)
+{
+    bindMeshState(mesh);
+    scene.drawBucket(bucket);
+    m_counters.drawCalls++;
+}
+
+void RenderStateCache::bindMeshState(const GPUMesh& mesh)
+{
+    assert(m_pProgram);
+    if (m_pMaterial == &mesh) {
+        m_counters.skippedBinds++;
+    } else {
+        mesh.bindMaterial(*m_pProgram);
+        m_pMaterial = &mesh;
+        m_counters.materialBinds++;
+    }
+
+    // Meshes of the same arena share one vertex array
+    if (m_pVertexArray == &mesh.arena() && m_boundVertexStream == m_vertexStream) {
+        m_counters.skippedBinds++;
+    } else {
+        mesh.bindVertexArray(m_vertexStream);
+        m_pVertexArray = &mesh.arena();
+        m_boundVertexStream = m_vertexStream;
+        m_counters.vertexArrayBinds++;
+    }
+}
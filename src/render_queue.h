@@ -0,0 +1,112 @@
+#pragma once
+
+#include "mesh.h"
+#include "texture.h"
+#include <framework/opengl_includes.h>
+#include <framework/shader.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <vector>
+
+class GpuDrivenScene;
+class InstanceBuffer;
+
+// Passes in submission order, stored in the most significant bits of the sort key
+enum class RenderPass : uint8_t {
+    Opaque,
+    Reflective
+};
+
+// A draw of one renderable, ordered by its packed sort key.
+struct DrawItem {
+    uint64_t sortKey;
+    uint32_t drawID;
+};
+
+// Per-frame list of draws, sorted such that draws sharing a shader, textures and mesh (which owns its material) are
+// adjacent. Key layout from the most to the least significant bit:
+//   pass (4) | shader (8) | texture set (16) | mesh (20) | depth (16)
+class RenderQueue {
+public:
+    static constexpr uint32_t MAX_SHADER_ID = 0xFF;
+    static constexpr uint32_t MAX_TEXTURE_SET_ID = 0xFFFF;
+    static constexpr uint32_t MAX_MESH_ID = 0xFFFFF;
+
+    // Pack the fields of a sort key; depth is clamped to [0, 1]. Ids must not exceed the maxima above: truncated ids
+    // would let sameState() merge draws of different meshes.
+    static uint64_t makeSortKey(RenderPass pass, uint32_t shader, uint32_t textureSet, uint32_t mesh, float normalizedDepth);
+
+    void clear();
+    void push(uint64_t sortKey, uint32_t drawID);
+    // LSD radix sort on the key bytes; bytes that are equal for all items are skipped.
+    void sort();
+
+    // Sorted items of all passes or of one pass (call after sort()).
+    std::span<const DrawItem> items() const;
+    std::span<const DrawItem> items(RenderPass pass) const;
+
+    // Whether two items only differ in depth, i.e. can be drawn as instances of one draw.
+    static bool sameState(const DrawItem& lhs, const DrawItem& rhs);
+
+private:
+    std::vector<DrawItem> m_items;
+    std::vector<DrawItem> m_scratch;
+};
+
+// Skips GL binds that would not change any state while a sorted queue is submitted. Code that binds through the
+// same state without going through the cache has to call reset() afterwards.
+class RenderStateCache {
+public:
+    struct Counters {
+        uint32_t programBinds { 0 };
+        uint32_t textureBinds { 0 };
+        uint32_t materialBinds { 0 };
+        uint32_t vertexArrayBinds { 0 };
+        uint32_t skippedBinds { 0 };
+        uint32_t drawCalls { 0 };
+    };
+
+    static constexpr size_t NUM_TEXTURE_UNITS = 2; // Units used by the diffuse and normal maps
+
+    void reset();
+    void resetCounters();
+    const Counters& counters() const;
+
+    // Depth-only programs, which only read the position attribute, pass VertexStream::Position such that the draws
+    // below fetch from the position stream of the mesh arenas.
+    void useProgram(const Shader& shader, VertexStream stream = VertexStream::Interleaved);
+    void bindTexture(GLint textureUnit, const Texture& texture);
+    // The material and vertex array of the mesh, followed by the draw call (of the given level of detail).
+    void drawMesh(const GPUMesh& mesh, size_t lod = 0);
+    void drawMeshRanges(const GPUMesh& mesh, std::span<const MeshArena::IndexRange> ranges);
+    // Same, with the matrices of one instance of the instance buffer, for programs that are set up for instancing.
+    void drawMeshRanges(const GPUMesh& mesh, const InstanceBuffer& instanceBuffer, size_t instance, std::span<const MeshArena::IndexRange> ranges);
+    void drawMeshInstanced(const GPUMesh& mesh, const InstanceBuffer& instanceBuffer, size_t firstInstance, size_t numInstances, size_t lod = 0);
+    void drawBucketIndirect(const GPUMesh& mesh, const GpuDrivenScene& scene, size_t bucket);
+
+private:
+    void bindMeshState(const GPUMesh& mesh);
+
+private:
+    const Shader* m_pProgram { nullptr };
+    std::array<const Texture*, NUM_TEXTURE_UNITS> m_textures {};
+    const GPUMesh* m_pMaterial { nullptr };
+    VertexStream m_vertexStream { VertexStream::Interleaved }; // Of the current program
+    const MeshArena* m_pVertexArray { nullptr };
+    VertexStream m_boundVertexStream { VertexStream::Interleaved };
+    Counters m_counters;
+};
+
+// Assigns small consecutive ids to the state objects (texture sets, meshes) of a frame, for use in sort keys.
+template <typename Key>
+class SortIdTable {
+public:
+    void clear() { m_ids.clear(); }
+    uint32_t idOf(const Key& key) { return m_ids.try_emplace(key, static_cast<uint32_t>(m_ids.size())).first->second; }
+
+private:
+    std::map<Key, uint32_t> m_ids;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "mesh.h"
+#include "texture.h"
+#include "utils.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <memory>
+#include <optional>
+
+enum class DrawingMode {
+    Opaque,
+    Reflective,
+};
+
+struct Transform {
+    glm::mat4 localModelMatrix;
+    Transform* parent; // nullptr when "this" transform is root
+
+    glm::mat4 getGlobalTransform(){
+        glm::mat4 globMatrix = localModelMatrix;
+        Transform* iter = parent;
+        while (iter != nullptr) {
+            globMatrix = iter->localModelMatrix * globMatrix;
+            iter = iter->parent;
+        }
+        return globMatrix;
+    }
+};
+
+struct Renderable {
+    std::shared_ptr<GPUMesh> mesh; // Shared by renderables that are instances of the same mesh
+    glm::mat4 modelMat;
+    std::optional<Texture> diffuseMap;
+    std::optional<Texture> normalMap;
+    StateType meshType;
+    DrawingMode drawMode;
+};
@@ -0,0 +1,340 @@
+#include "scene_bvh.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <array>
+#include <limits>
+
+static constexpr uint32_t NUM_BINS = 16;
+// Deeper than any binned SAH tree gets in practice; keeps the traversal stacks bounded
+static constexpr uint32_t MAX_DEPTH = 48;
+
+static void extend(AxisAlignedBox& box, const AxisAlignedBox& other)
+{
+    box.lower = glm::min(box.lower, other.lower);
+    box.upper = glm::max(box.upper, other.upper);
+}
+
+static float surfaceArea(const AxisAlignedBox& box)
+{
+    const glm::vec3 size = glm::max(box.upper - box.lower, glm::vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+void Bvh::build(std::span<const AxisAlignedBox> bounds, std::span<const uint32_t> ids)
+{
+    m_nodes.clear();
+    m_ids.assign(std::begin(ids), std::end(ids));
+    m_primitiveBounds.assign(std::begin(bounds), std::end(bounds));
+    m_primitives.resize(bounds.size());
+    for (uint32_t i = 0; i < m_primitives.size(); i++)
+        m_primitives[i] = i;
+    if (bounds.empty())
+        return;
+
+    std::vector<glm::vec3> centroids;
+    centroids.reserve(bounds.size());
+    for (const AxisAlignedBox& box : bounds)
+        centroids.push_back(0.5f * (box.lower + box.upper));
+
+    // A binary tree with at least one primitive per leaf has fewer than 2n nodes
+    m_nodes.reserve(2 * bounds.size());
+    m_nodes.push_back({ {}, 0, static_cast<uint32_t>(bounds.size()) });
+    subdivide(0, bounds, centroids, 0);
+}
+
+void Bvh::subdivide(uint32_t nodeIdx, std::span<const AxisAlignedBox> bounds, std::span<const glm::vec3> centroids, uint32_t depth)
+{
+    const uint32_t first = m_nodes[nodeIdx].first, count = m_nodes[nodeIdx].count;
+    AxisAlignedBox nodeBounds, centroidBounds;
+    for (uint32_t i = first; i < first + count; i++) {
+        extend(nodeBounds, bounds[m_primitives[i]]);
+        extend(centroidBounds, { centroids[m_primitives[i]], centroids[m_primitives[i]] });
+    }
+    m_nodes[nodeIdx].bounds = nodeBounds;
+    if (count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH)
+        return;
+
+    // Bin the centroids along every axis and evaluate the SAH at the bin boundaries
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    float bestCost = surfaceArea(nodeBounds) * float(count); // Cost of keeping this node a leaf
+    for (int axis = 0; axis < 3; axis++) {
+        const float axisLower = centroidBounds.lower[axis], axisExtent = centroidBounds.upper[axis] - axisLower;
+        if (axisExtent <= 0.0f)
+            continue;
+
+        std::array<AxisAlignedBox, NUM_BINS> binBounds;
+        std::array<uint32_t, NUM_BINS> binCounts {};
+        const float binScale = float(NUM_BINS) / axisExtent;
+        for (uint32_t i = first; i < first + count; i++) {
+            const uint32_t bin = std::min(static_cast<uint32_t>((centroids[m_primitives[i]][axis] - axisLower) * binScale), NUM_BINS - 1);
+            binCounts[bin]++;
+            extend(binBounds[bin], bounds[m_primitives[i]]);
+        }
+
+        // Sweep from the right to get the cost of the right side of every split, then from the left
+        std::array<float, NUM_BINS> rightCosts {};
+        AxisAlignedBox rightBounds;
+        uint32_t rightCount = 0;
+        for (uint32_t bin = NUM_BINS - 1; bin > 0; bin--) {
+            extend(rightBounds, binBounds[bin]);
+            rightCount += binCounts[bin];
+            rightCosts[bin] = rightCount ? surfaceArea(rightBounds) * float(rightCount) : 0.0f;
+        }
+        AxisAlignedBox leftBounds;
+        uint32_t leftCount = 0;
+        for (uint32_t split = 1; split < NUM_BINS; split++) {
+            extend(leftBounds, binBounds[split - 1]);
+            leftCount += binCounts[split - 1];
+            const float cost = (leftCount ? surfaceArea(leftBounds) * float(leftCount) : 0.0f) + rightCosts[split];
+            if (leftCount > 0 && leftCount < count && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    uint32_t mid;
+    if (bestAxis >= 0) {
+        const float axisLower = centroidBounds.lower[bestAxis];
+        const float binScale = float(NUM_BINS) / (centroidBounds.upper[bestAxis] - axisLower);
+        const auto pMid = std::partition(&m_primitives[first], &m_primitives[first] + count, [&](uint32_t primitive) {
+            return std::min(static_cast<uint32_t>((centroids[primitive][bestAxis] - axisLower) * binScale), NUM_BINS - 1) < bestSplit;
+        });
+        mid = static_cast<uint32_t>(pMid - m_primitives.data());
+    } else if (count > 4 * MAX_LEAF_SIZE) {
+        // No split beats a leaf (typically many coincident centroids), but a leaf this large would make queries linear
+        mid = first + count / 2;
+    } else {
+        return;
+    }
+
+    const uint32_t leftIdx = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back({ {}, first, mid - first });
+    m_nodes.push_back({ {}, mid, first + count - mid });
+    m_nodes[nodeIdx].first = leftIdx;
+    m_nodes[nodeIdx].count = 0;
+    subdivide(leftIdx, bounds, centroids, depth + 1);
+    subdivide(leftIdx + 1, bounds, centroids, depth + 1);
+}
+
+void Bvh::refit(std::span<const AxisAlignedBox> bounds)
+{
+    m_primitiveBounds.assign(std::begin(bounds), std::end(bounds));
+    // Children come after their parents, so a reverse sweep visits every child before its parent
+    for (size_t i = m_nodes.size(); i-- > 0;) {
+        Node& node = m_nodes[i];
+        node.bounds = AxisAlignedBox {};
+        if (node.count) {
+            for (uint32_t j = node.first; j < node.first + node.count; j++)
+                extend(node.bounds, bounds[m_primitives[j]]);
+        } else {
+            extend(node.bounds, m_nodes[node.first].bounds);
+            extend(node.bounds, m_nodes[node.first + 1].bounds);
+        }
+    }
+}
+
+bool Bvh::empty() const
+{
+    return m_nodes.empty();
+}
+
+float Bvh::rootArea() const
+{
+    return m_nodes.empty() ? 0.0f : surfaceArea(m_nodes[0].bounds);
+}
+
+void Bvh::cull(const Frustum& frustum, std::vector<uint8_t>& visible) const
+{
+    if (m_nodes.empty())
+        return;
+
+    enum class Overlap { Outside, Intersecting, Inside };
+    const auto classify = [&](const AxisAlignedBox& box) {
+        const glm::vec3 center = 0.5f * (box.lower + box.upper), extent = 0.5f * (box.upper - box.lower);
+        // Outside as soon as the box lies behind one plane, inside when it lies in front of all of them
+        Overlap overlap = Overlap::Inside;
+        for (const glm::vec4& plane : frustum.planes) {
+            const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            const float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+            if (distance + radius < 0.0f)
+                return Overlap::Outside;
+            if (distance - radius < 0.0f)
+                overlap = Overlap::Intersecting;
+        }
+        return overlap;
+    };
+
+    std::array<uint32_t, 2 * MAX_DEPTH + 2> stack;
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const uint32_t nodeIdx = stack[--stackSize];
+        const Node& node = m_nodes[nodeIdx];
+        const Overlap overlap = classify(node.bounds);
+        if (overlap == Overlap::Outside)
+            continue;
+
+        if (overlap == Overlap::Inside) {
+            markSubtree(nodeIdx, visible);
+        } else if (node.count) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                if (classify(m_primitiveBounds[m_primitives[i]]) != Overlap::Outside)
+                    visible[m_ids[m_primitives[i]]] = 1;
+            }
+        } else {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = node.first + 1;
+        }
+    }
+}
+
+void Bvh::markSubtree(uint32_t nodeIdx, std::vector<uint8_t>& visible) const
+{
+    // The primitives of a subtree are one contiguous range; find it from the leftmost and rightmost leaves
+    uint32_t leftmost = nodeIdx, rightmost = nodeIdx;
+    while (m_nodes[leftmost].count == 0)
+        leftmost = m_nodes[leftmost].first;
+    while (m_nodes[rightmost].count == 0)
+        rightmost = m_nodes[rightmost].first + 1;
+    for (uint32_t i = m_nodes[leftmost].first; i < m_nodes[rightmost].first + m_nodes[rightmost].count; i++)
+        visible[m_ids[m_primitives[i]]] = 1;
+}
+
+void Bvh::overlapSphere(const glm::vec3& center, float radius, std::vector<uint32_t>& ids) const
+{
+    if (m_nodes.empty())
+        return;
+
+    const auto overlaps = [&](const AxisAlignedBox& box) {
+        const glm::vec3 closest = glm::clamp(center, box.lower, box.upper);
+        return glm::dot(closest - center, closest - center) <= radius * radius;
+    };
+    std::array<uint32_t, 2 * MAX_DEPTH + 2> stack;
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = m_nodes[stack[--stackSize]];
+        if (!overlaps(node.bounds))
+            continue;
+        if (node.count) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                if (overlaps(m_primitiveBounds[m_primitives[i]]))
+                    ids.push_back(m_ids[m_primitives[i]]);
+            }
+        } else {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = node.first + 1;
+        }
+    }
+}
+
+std::optional<uint32_t> Bvh::intersect(Ray& ray) const
+{
+    if (m_nodes.empty())
+        return {};
+
+    const glm::vec3 invDirection = 1.0f / ray.direction;
+    // Entry distance of the ray into the box, or infinity when it misses the box within [0, ray.t]
+    const auto entry = [&](const AxisAlignedBox& box) {
+        const glm::vec3 t0 = (box.lower - ray.origin) * invDirection, t1 = (box.upper - ray.origin) * invDirection;
+        const glm::vec3 tMin = glm::min(t0, t1), tMax = glm::max(t0, t1);
+        const float tEnter = std::max({ tMin.x, tMin.y, tMin.z, 0.0f });
+        const float tExit = std::min({ tMax.x, tMax.y, tMax.z, ray.t });
+        return tEnter <= tExit ? tEnter : std::numeric_limits<float>::infinity();
+    };
+
+    std::optional<uint32_t> hit;
+    std::array<uint32_t, 2 * MAX_DEPTH + 2> stack;
+    size_t stackSize = 0;
+    if (entry(m_nodes[0].bounds) < std::numeric_limits<float>::infinity())
+        stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = m_nodes[stack[--stackSize]];
+        if (node.count) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                const float t = entry(m_primitiveBounds[m_primitives[i]]);
+                if (t < ray.t) {
+                    ray.t = t;
+                    hit = m_ids[m_primitives[i]];
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first, such that the farther one is more likely to be pruned by the shortened ray
+        float tLeft = entry(m_nodes[node.first].bounds), tRight = entry(m_nodes[node.first + 1].bounds);
+        uint32_t nearChild = node.first, farChild = node.first + 1;
+        if (tRight < tLeft) {
+            std::swap(tLeft, tRight);
+            std::swap(nearChild, farChild);
+        }
+        if (tRight < ray.t)
+            stack[stackSize++] = farChild;
+        if (tLeft < ray.t)
+            stack[stackSize++] = nearChild;
+    }
+    return hit;
+}
+
+void SceneBvh::invalidate()
+{
+    m_dirty = true;
+}
+
+void SceneBvh::update(std::span<const Renderable> renderables, std::span<const glm::mat4> modelMatrices)
+{
+    if (m_dirty) {
+        std::vector<AxisAlignedBox> staticBounds;
+        std::vector<uint32_t> staticDrawIDs;
+        m_dynamicDrawIDs.clear();
+        for (uint32_t drawID = 0; drawID < renderables.size(); drawID++) {
+            if (renderables[drawID].meshType == StateType::Dynamic) {
+                m_dynamicDrawIDs.push_back(drawID);
+            } else {
+                staticBounds.push_back(transformBounds(renderables[drawID].mesh->bounds(), modelMatrices[drawID]));
+                staticDrawIDs.push_back(drawID);
+            }
+        }
+        m_staticTree.build(staticBounds, staticDrawIDs);
+        m_numRenderables = renderables.size();
+    }
+
+    m_dynamicBounds.clear();
+    for (uint32_t drawID : m_dynamicDrawIDs)
+        m_dynamicBounds.push_back(transformBounds(renderables[drawID].mesh->bounds(), modelMatrices[drawID]));
+    if (!m_dirty)
+        m_dynamicTree.refit(m_dynamicBounds);
+    if (m_dirty || m_dynamicTree.rootArea() > MAX_REFIT_GROWTH * m_dynamicBuildArea) {
+        m_dynamicTree.build(m_dynamicBounds, m_dynamicDrawIDs);
+        m_dynamicBuildArea = m_dynamicTree.rootArea();
+    }
+    m_dirty = false;
+}
+
+void SceneBvh::cull(const Frustum& frustum, std::vector<uint8_t>& visible) const
+{
+    visible.assign(m_numRenderables, 0);
+    m_staticTree.cull(frustum, visible);
+    m_dynamicTree.cull(frustum, visible);
+}
+
+void SceneBvh::overlapSphere(const glm::vec3& center, float radius, std::vector<uint32_t>& drawIDs) const
+{
+    m_staticTree.overlapSphere(center, radius, drawIDs);
+    m_dynamicTree.overlapSphere(center, radius, drawIDs);
+}
+
+std::optional<uint32_t> SceneBvh::pick(Ray ray) const
+{
+    const std::optional<uint32_t> staticHit = m_staticTree.intersect(ray);
+    // The ray was shortened to the static hit, so any dynamic hit is closer
+    const std::optional<uint32_t> dynamicHit = m_dynamicTree.intersect(ray);
+    return dynamicHit ? dynamicHit : staticHit;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "culling.h"
+#include "renderable.h"
+#include <framework/disable_all_warnings.h>
+#include <framework/mesh.h>
+#include <framework/ray.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Bounding volume hierarchy over world-space boxes, built top down with binned SAH. Nodes are stored depth first
+// with the two children of a node next to each other, so every child comes after its parent.
+class Bvh {
+public:
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+
+    // Primitive i has bounds[i] and is reported by queries as ids[i].
+    void build(std::span<const AxisAlignedBox> bounds, std::span<const uint32_t> ids);
+    // Update the node bounds to new bounds of the same primitives (in the order of build()), keeping the topology.
+    void refit(std::span<const AxisAlignedBox> bounds);
+
+    bool empty() const;
+    // Surface area of the root, which grows as refitting degrades the tree.
+    float rootArea() const;
+
+    // Set visible[id] to 1 for every primitive whose box intersects the frustum.
+    void cull(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+    // Append the IDs of the primitives whose box intersects the sphere.
+    void overlapSphere(const glm::vec3& center, float radius, std::vector<uint32_t>& ids) const;
+    // Closest primitive box hit by the ray within ray.t, which is shortened to the hit distance.
+    std::optional<uint32_t> intersect(Ray& ray) const;
+
+private:
+    struct Node {
+        AxisAlignedBox bounds;
+        uint32_t first; // First primitive (leaf) or left child (interior node)
+        uint32_t count; // Number of primitives, 0 for interior nodes
+    };
+
+    void subdivide(uint32_t nodeIdx, std::span<const AxisAlignedBox> bounds, std::span<const glm::vec3> centroids, uint32_t depth);
+    void markSubtree(uint32_t nodeIdx, std::vector<uint8_t>& visible) const;
+
+private:
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_primitives; // Build indices, leaves refer to ranges of these
+    std::vector<AxisAlignedBox> m_primitiveBounds; // By build index
+    std::vector<uint32_t> m_ids;
+};
+
+// Spatial index over the world bounds of all renderables, shared by frustum culling, picking and light queries.
+// Static renderables are kept in a tree that is only rebuilt after invalidate(); dynamic ones in a second, small tree
+// that is refit every frame and only rebuilt once refitting has made it considerably worse.
+class SceneBvh {
+public:
+    // The set of renderables changed, rebuild both trees on the next update().
+    void invalidate();
+    void update(std::span<const Renderable> renderables, std::span<const glm::mat4> modelMatrices);
+
+    // Resize visible to the number of renderables and set it to 1 for those intersecting the frustum, 0 otherwise.
+    void cull(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+    // Draw IDs of the renderables whose bounds intersect the sphere (for example the range of a light).
+    void overlapSphere(const glm::vec3& center, float radius, std::vector<uint32_t>& drawIDs) const;
+    // Draw ID of the renderable whose bounds are hit first by the ray.
+    std::optional<uint32_t> pick(Ray ray) const;
+
+private:
+    // A refit dynamic tree is rebuilt when its root has grown this much relative to the rebuilt tree
+    static constexpr float MAX_REFIT_GROWTH = 2.0f;
+
+    bool m_dirty { true };
+    size_t m_numRenderables { 0 };
+    Bvh m_staticTree;
+    Bvh m_dynamicTree;
+    std::vector<uint32_t> m_dynamicDrawIDs;
+    std::vector<AxisAlignedBox> m_dynamicBounds;
+    float m_dynamicBuildArea { 0.0f };
+};
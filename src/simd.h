@@ -0,0 +1,82 @@
+#pragma once
+
+// Minimal 4-wide float vector used by the CPU culling, occlusion rasterizer and light assignment code.
+// Uses SSE2 when the target supports it (always the case on x86-64) and plain scalar code otherwise.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#endif
+
+namespace simd {
+
+#ifdef SIMD_USE_SSE2
+struct Float4 {
+    __m128 v;
+
+    static Float4 load(const float* pData) { return { _mm_loadu_ps(pData) }; }
+    static Float4 broadcast(float value) { return { _mm_set1_ps(value) }; }
+    void store(float* pData) const { _mm_storeu_ps(pData, v); }
+};
+
+inline Float4 operator+(Float4 lhs, Float4 rhs) { return { _mm_add_ps(lhs.v, rhs.v) }; }
+inline Float4 operator-(Float4 lhs, Float4 rhs) { return { _mm_sub_ps(lhs.v, rhs.v) }; }
+inline Float4 operator*(Float4 lhs, Float4 rhs) { return { _mm_mul_ps(lhs.v, rhs.v) }; }
+inline Float4 min(Float4 lhs, Float4 rhs) { return { _mm_min_ps(lhs.v, rhs.v) }; }
+inline Float4 max(Float4 lhs, Float4 rhs) { return { _mm_max_ps(lhs.v, rhs.v) }; }
+inline Float4 abs(Float4 value) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), value.v) }; }
+// Component-wise comparisons return a mask; use bitMask() to get one bit per lane.
+inline Float4 lessEqual(Float4 lhs, Float4 rhs) { return { _mm_cmple_ps(lhs.v, rhs.v) }; }
+inline Float4 greaterEqual(Float4 lhs, Float4 rhs) { return { _mm_cmpge_ps(lhs.v, rhs.v) }; }
+inline Float4 maskAnd(Float4 lhs, Float4 rhs) { return { _mm_and_ps(lhs.v, rhs.v) }; }
+inline Float4 maskOr(Float4 lhs, Float4 rhs) { return { _mm_or_ps(lhs.v, rhs.v) }; }
+inline int bitMask(Float4 mask) { return _mm_movemask_ps(mask.v); }
+// Lanes of ifTrue where the mask is set, lanes of ifFalse elsewhere.
+inline Float4 select(Float4 mask, Float4 ifTrue, Float4 ifFalse) { return { _mm_or_ps(_mm_and_ps(mask.v, ifTrue.v), _mm_andnot_ps(mask.v, ifFalse.v)) }; }
+#else
+struct Float4 {
+    std::array<float, 4> v;
+
+    static Float4 load(const float* pData)
+    {
+        Float4 out;
+        std::memcpy(out.v.data(), pData, sizeof(out.v));
+        return out;
+    }
+    static Float4 broadcast(float value) { return { { value, value, value, value } }; }
+    void store(float* pData) const { std::memcpy(pData, v.data(), sizeof(v)); }
+};
+
+template <typename F>
+inline Float4 perLane(Float4 lhs, Float4 rhs, F&& f)
+{
+    return { { f(lhs.v[0], rhs.v[0]), f(lhs.v[1], rhs.v[1]), f(lhs.v[2], rhs.v[2]), f(lhs.v[3], rhs.v[3]) } };
+}
+inline float laneMask(bool value) { return value ? -1.0f : 0.0f; } // Sign bit set for true
+
+inline Float4 operator+(Float4 lhs, Float4 rhs) { return perLane(lhs, rhs, [](float a, float b) { return a + b; }); }
+inline Float4 operator-(Float4 lhs, Float4 rhs) { return perLane(lhs, rhs, [](float a, float b) { return a - b; }); }
+inline Float4 operator*(Float4 lhs, Float4 rhs) { return perLane(lhs, rhs, [](float a, float b) { return a * b; }); }
+inline Float4 min(Float4 lhs, Float4 rhs) { return perLane(lhs, rhs, [](float a, float b) { return std::min(a, b); }); }
+inline Float4 max(Float4 lhs, Float4 rhs) { return perLane(lhs, rhs, [](float a, float b) { return std::max(a, b); }); }
+inline Float4 abs(Float4 value) { return perLane(value, value, [](float a, float) { return a < 0.0f ? -a : a; }); }
+inline Float4 lessEqual(Float4 lhs, Float4 rhs) { return perLane(lhs, rhs, [](float a, float b) { return laneMask(a <= b); }); }
+inline Float4 greaterEqual(Float4 lhs, Float4 rhs) { return perLane(lhs, rhs, [](float a, float b) { return laneMask(a >= b); }); }
+inline Float4 maskAnd(Float4 lhs, Float4 rhs) { return perLane(lhs, rhs, [](float a, float b) { return laneMask(a < 0.0f && b < 0.0f); }); }
+inline Float4 maskOr(Float4 lhs, Float4 rhs) { return perLane(lhs, rhs, [](float a, float b) { return laneMask(a < 0.0f || b < 0.0f); }); }
+inline int bitMask(Float4 mask)
+{
+    return (mask.v[0] < 0.0f ? 1 : 0) | (mask.v[1] < 0.0f ? 2 : 0) | (mask.v[2] < 0.0f ? 4 : 0) | (mask.v[3] < 0.0f ? 8 : 0);
+}
+inline Float4 select(Float4 mask, Float4 ifTrue, Float4 ifFalse)
+{
+    return { { mask.v[0] < 0.0f ? ifTrue.v[0] : ifFalse.v[0], mask.v[1] < 0.0f ? ifTrue.v[1] : ifFalse.v[1],
+        mask.v[2] < 0.0f ? ifTrue.v[2] : ifFalse.v[2], mask.v[3] < 0.0f ? ifTrue.v[3] : ifFalse.v[3] } };
+}
+#endif
+
+}
@@ -57,7 +57,7 @@ Texture::~Texture()
         glDeleteTextures(1, &m_texture);
 }
 
-void Texture::bind(GLint textureSlot)
+void Texture::bind(GLint textureSlot) const
 {
     glActiveTexture(textureSlot);
     glBindTexture(GL_TEXTURE_2D, m_texture);
@@ -21,7 +21,7 @@ public:
     Texture& operator=(const Texture&) = delete;
     Texture& operator=(Texture&&) = default;
 
-    void bind(GLint textureSlot);
+    void bind(GLint textureSlot) const;
 
 private:
     static constexpr GLuint INVALID = 0xFFFFFFFF;
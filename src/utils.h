@@ -1,12 +1,50 @@
 #pragma once
 
+#include <framework/disable_all_warnings.h>
+#include <framework/opengl_includes.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/glm.hpp>
+DISABLE_WARNINGS_POP()
+#include <array>
+#include <cmath>
 #include <filesystem>
+#include <limits>
+#include <vector>
 
 enum class ShadingModel {
     BLINN_OR_PHONG
 };
 
+enum class RenderPath {
+    MultiPassForward, // One additive pass per batch of lights per light type
+    SinglePassForward, // One pass evaluating all lights in a single shader
+    ClusteredForward, // One pass, each fragment only evaluates the lights assigned to its view frustum cluster
+    Deferred // Geometry into a G-buffer once, then one light volume per light
+};
+
+enum class StateType {
+    Static,
+    Dynamic
+};
+
 namespace utils {
+    inline const char* renderPathName(RenderPath renderPath) {
+        switch (renderPath) {
+        case RenderPath::MultiPassForward:
+            return "Multi-pass forward";
+        case RenderPath::SinglePassForward:
+            return "Single-pass forward";
+        case RenderPath::ClusteredForward:
+            return "Clustered forward";
+        case RenderPath::Deferred:
+            return "Deferred";
+        }
+        return "";
+    }
+
+    // All render paths, in the order in which they are listed in the UI
+    inline constexpr std::array allRenderPaths { RenderPath::MultiPassForward, RenderPath::SinglePassForward, RenderPath::ClusteredForward, RenderPath::Deferred };
+
     namespace globals {
         const int WINDOW_WIDTH = 1024;
         const int WINDOW_HEIGHT = 1024;
@@ -26,19 +64,37 @@ namespace utils {
             const int MAX_NUM_POINT_LIGHT = 4;
             const int MAX_NUM_DIR_LIGHT = 1;
             const int MAX_NUM_SPOT_LIGHT = 4;
+
+            // Limits of the single-pass shader, all lights have to fit in one uniform block (at least 16KB)
+            const int MAX_NUM_UBER_POINT_LIGHT = 128;
+            const int MAX_NUM_UBER_SPOT_LIGHT = 64;
+            const int MAX_NUM_UBER_DIR_LIGHT = 4;
         }
 
         const float lightPointSize = 15.0f;
-        glm::vec3 inactiveCameraColor = glm::vec3(0.902, 0.043, 0.831);
-        ShadingModel currentShadingModel = ShadingModel::BLINN_OR_PHONG;
-        bool showLightsAsPoints = true;
-        bool useBlinnCorrection = false;
-        bool useDiffuseMap = true;
-        bool useNormalMap = true;
-        bool sunlight = false;
-        glm::vec3 sunlightDirection = glm::vec3(1, -1, 0);
-        bool pauseBezierPath = false;
-        bool pauseHierarchyTransform = false;
+        inline glm::vec3 inactiveCameraColor = glm::vec3(0.902, 0.043, 0.831);
+        inline ShadingModel currentShadingModel = ShadingModel::BLINN_OR_PHONG;
+        inline RenderPath currentRenderPath = RenderPath::MultiPassForward;
+        inline bool showLightsAsPoints = true;
+        inline bool useBlinnCorrection = false;
+        inline bool useDiffuseMap = true;
+        inline bool useNormalMap = true;
+        inline bool sunlight = false;
+        inline glm::vec3 sunlightDirection = glm::vec3(1, -1, 0);
+        inline bool pauseBezierPath = false;
+        inline bool pauseHierarchyTransform = false;
+        inline bool pauseGeneratedLights = false;
+        inline bool frustumCulling = true;
+        inline bool sceneBvhCulling = true;
+        inline bool objectLightLists = true;
+        inline bool lightClipping = true;
+        inline bool occlusionCulling = false;
+        inline bool occlusionQueries = false;
+        inline bool meshletCulling = true;
+        inline bool levelOfDetail = true;
+        inline float lodErrorPixels = 1.0f; // Largest projected error of a selected level of detail
+        inline bool useInstancing = true;
+        inline bool gpuDrivenSubmission = false; // Only available in OpenGL 4.5 builds (TECHDEMO_GL45)
 
         namespace bezier_path {
             const int frameCount = 120; // How many frames taken to do one full cubic bezier curve
@@ -74,17 +130,24 @@ namespace utils {
             //const glm::vec3 control_point11{ -4, 1, 5 };
             //const glm::vec3 control_point12{ 0, 1, 5 }; // overlap curve 4 and 1
 
-            float timestep = 0;
+            inline float timestep = 0;
         }
 
         namespace hierarchy_transform {
-            float planetOrbitSpeed = 1.0f;
-            float moonOrbitSpeed = 1.0f;
+            inline float planetOrbitSpeed = 1.0f;
+            inline float moonOrbitSpeed = 1.0f;
         }
     }
 
+    // Number of point lights that the render path shades; any lights beyond it are silently left out
+    inline size_t maxPointLights(RenderPath renderPath) {
+        if (renderPath == RenderPath::SinglePassForward)
+            return static_cast<size_t>(globals::shader_preprocessor_params::MAX_NUM_UBER_POINT_LIGHT);
+        return std::numeric_limits<size_t>::max();
+    }
+
     namespace math {
-        glm::vec2 getAttenuationCoefficient(float maxDistance) {
+        inline glm::vec2 getAttenuationCoefficient(float maxDistance) {
             if (maxDistance <= 7.0)
                 return { 0.7, 1.8 };
             else if (maxDistance <= 13)
@@ -113,7 +176,20 @@ namespace utils {
                 return { 0.0001 , 0.0000001 };
         };
 
-        glm::vec3 cubicBezier(float t, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3) {
+        // Distance at which the attenuation (1 + linear * d + quadratic * d^2)^-1 of a light with the given coefficients
+        // and brightest color channel maxIntensity falls below cutoff, i.e. beyond which the light can be ignored
+        inline float getAttenuationRadius(const glm::vec2& attenuationCoefficients, float maxIntensity, float cutoff = 5.0f / 256.0f) {
+            const float linear = attenuationCoefficients.x;
+            const float quadratic = attenuationCoefficients.y;
+            const float constant = 1.0f - maxIntensity / cutoff;
+            if (constant >= 0.0f)
+                return 0.0f;
+            if (quadratic <= 0.0f)
+                return -constant / linear;
+            return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * constant)) / (2.0f * quadratic);
+        }
+
+        inline glm::vec3 cubicBezier(float t, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3) {
             float it = 1.0f - t;
             return (it * it * it * p0) + (3 * t * it * it * p1) + (3 * t * t * it * p2) + (t * t * t * p3);
         }
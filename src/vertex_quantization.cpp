@@ -0,0 +1,106 @@
+#include "vertex_quantization.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/trigonometric.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cmath>
+
+static constexpr float UNORM16_MAX = 65535.0f;
+static constexpr float SNORM16_MAX = 32767.0f;
+
+VertexQuantization VertexQuantization::fromVertices(std::span<const Vertex> vertices)
+{
+    if (vertices.empty())
+        return {};
+
+    AxisAlignedBox bounds;
+    for (const Vertex& vertex : vertices) {
+        bounds.lower = glm::min(bounds.lower, vertex.position);
+        bounds.upper = glm::max(bounds.upper, vertex.position);
+    }
+    VertexQuantization quantization;
+    quantization.positionOffset = bounds.lower;
+    quantization.positionScale = bounds.upper - bounds.lower;
+    return quantization;
+}
+
+QuantizedVertex VertexQuantization::encode(const Vertex& vertex) const
+{
+    QuantizedVertex quantized {};
+    for (int axis = 0; axis < 3; axis++) {
+        // Flat meshes have a zero extent along one axis
+        const float normalized = positionScale[axis] > 0.0f ? (vertex.position[axis] - positionOffset[axis]) / positionScale[axis] : 0.0f;
+        quantized.position[axis] = static_cast<uint16_t>(std::lround(std::clamp(normalized, 0.0f, 1.0f) * UNORM16_MAX));
+    }
+
+    const glm::vec2 octahedral = encodeOctahedral(vertex.normal);
+    // Of the four neighbouring grid points, keep the one that decodes closest to the normal
+    const glm::vec2 lower = glm::floor(octahedral * SNORM16_MAX);
+    glm::vec2 best = lower;
+    float bestCosine = -2.0f;
+    for (int neighbour = 0; neighbour < 4; neighbour++) {
+        const glm::vec2 candidate = glm::clamp(lower + glm::vec2(neighbour & 1, neighbour >> 1), -SNORM16_MAX, SNORM16_MAX);
+        const float cosine = glm::dot(decodeOctahedral(candidate / SNORM16_MAX), glm::normalize(vertex.normal));
+        if (cosine > bestCosine) {
+            bestCosine = cosine;
+            best = candidate;
+        }
+    }
+    quantized.normal[0] = static_cast<int16_t>(best.x);
+    quantized.normal[1] = static_cast<int16_t>(best.y);
+
+    quantized.texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+    quantized.texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
+    return quantized;
+}
+
+Vertex VertexQuantization::decode(const QuantizedVertex& vertex) const
+{
+    Vertex decoded;
+    decoded.position = positionOffset + positionScale * glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]) / UNORM16_MAX;
+    decoded.normal = decodeOctahedral(glm::vec2(vertex.normal[0], vertex.normal[1]) / SNORM16_MAX);
+    decoded.texCoord = glm::vec2(glm::unpackHalf1x16(vertex.texCoord[0]), glm::unpackHalf1x16(vertex.texCoord[1]));
+    return decoded;
+}
+
+QuantizationError VertexQuantization::measureError(std::span<const Vertex> vertices) const
+{
+    QuantizationError error;
+    float minNormalCosine = 1.0f;
+    for (const Vertex& vertex : vertices) {
+        const Vertex decoded = decode(encode(vertex));
+        error.position = std::max(error.position, glm::length(decoded.position - vertex.position));
+        if (glm::length(vertex.normal) > 0.0f)
+            minNormalCosine = std::min(minNormalCosine, glm::dot(decoded.normal, glm::normalize(vertex.normal)));
+        error.texCoord = std::max({ error.texCoord, std::abs(decoded.texCoord.x - vertex.texCoord.x), std::abs(decoded.texCoord.y - vertex.texCoord.y) });
+    }
+    error.normalDegrees = glm::degrees(std::acos(std::clamp(minNormalCosine, -1.0f, 1.0f)));
+    return error;
+}
+
+glm::vec2 encodeOctahedral(const glm::vec3& normal)
+{
+    const float l1Norm = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (l1Norm == 0.0f)
+        return glm::vec2(0.0f);
+    const glm::vec3 projected = normal / l1Norm;
+    if (projected.z >= 0.0f)
+        return glm::vec2(projected);
+    // Fold the lower hemisphere over the diagonals
+    const glm::vec2 signs { projected.x >= 0.0f ? 1.0f : -1.0f, projected.y >= 0.0f ? 1.0f : -1.0f };
+    return (1.0f - glm::abs(glm::vec2(projected.y, projected.x))) * signs;
+}
+
+glm::vec3 decodeOctahedral(const glm::vec2& encoded)
+{
+    // Must match decodeOctahedral() in the vertex shaders
+    glm::vec3 normal { encoded, 1.0f - std::abs(encoded.x) - std::abs(encoded.y) };
+    const float fold = std::max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -fold : fold;
+    normal.y += normal.y >= 0.0f ? -fold : fold;
+    return glm::normalize(normal);
+}
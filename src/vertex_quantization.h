@@ -0,0 +1,50 @@
+#pragma once
+
+#include <framework/disable_all_warnings.h>
+#include <framework/mesh.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <cstdint>
+#include <span>
+
+// 16 byte vertex of VertexFormat::Quantized, see MeshArena::setupVertexArray() for the attribute formats.
+struct QuantizedVertex {
+    uint16_t position[3]; // Unsigned normalized within the bounds of the mesh
+    uint16_t padding;
+    int16_t normal[2]; // Octahedral encoding, scaled to [-32767, 32767]
+    uint16_t texCoord[2]; // Half floats, such that tiling coordinates outside of [0, 1] survive
+};
+
+// 8 byte vertex of the position stream of VertexFormat::Quantized.
+struct QuantizedPosition {
+    uint16_t position[3];
+    uint16_t padding;
+};
+
+// Largest difference between the original and the decoded attributes of a mesh.
+struct QuantizationError {
+    float position { 0.0f }; // Object space distance
+    float normalDegrees { 0.0f };
+    float texCoord { 0.0f };
+};
+
+// Maps object space positions of one mesh to 16 bit integers relative to its bounding box. Decoding is
+// positionOffset + positionScale * (encoded / 65535); the vertex shaders get the division for free from the normalized
+// attribute. The default maps positions to themselves, as used for VertexFormat::Float.
+struct VertexQuantization {
+    static VertexQuantization fromVertices(std::span<const Vertex> vertices);
+
+    QuantizedVertex encode(const Vertex& vertex) const;
+    Vertex decode(const QuantizedVertex& vertex) const;
+    QuantizationError measureError(std::span<const Vertex> vertices) const;
+
+    glm::vec3 positionOffset { 0.0f };
+    glm::vec3 positionScale { 1.0f };
+};
+
+// Octahedral normal encoding: the unit sphere is projected onto an octahedron, which is unfolded onto [-1, 1]^2.
+glm::vec2 encodeOctahedral(const glm::vec3& normal);
+glm::vec3 decodeOctahedral(const glm::vec2& encoded);
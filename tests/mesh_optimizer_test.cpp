@@ -0,0 +1,64 @@
+#include <framework/disable_all_warnings.h>
+#include <framework/mesh_optimizer.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <array>
+#include <random>
+#include <tuple>
+
+// A grid of size x size vertices in the XY plane, two triangles per cell.
+static Mesh makeGrid(unsigned size)
+{
+    Mesh mesh;
+    for (unsigned y = 0; y < size; y++) {
+        for (unsigned x = 0; x < size; x++)
+            mesh.vertices.push_back({ glm::vec3(x, y, 0), glm::vec3(0, 0, 1), glm::vec2(0) });
+    }
+    for (unsigned y = 0; y + 1 < size; y++) {
+        for (unsigned x = 0; x + 1 < size; x++) {
+            const unsigned corner = y * size + x;
+            mesh.triangles.push_back({ corner, corner + 1, corner + size });
+            mesh.triangles.push_back({ corner + 1, corner + size + 1, corner + size });
+        }
+    }
+    computeBounds(mesh);
+    return mesh;
+}
+
+// The triangles as vertex positions, each rotated to start at its smallest vertex (keeping the winding), sorted.
+static std::vector<std::array<glm::vec3, 3>> triangleSet(const Mesh& mesh)
+{
+    const auto less = [](const glm::vec3& lhs, const glm::vec3& rhs) { return std::tie(lhs.x, lhs.y, lhs.z) < std::tie(rhs.x, rhs.y, rhs.z); };
+    std::vector<std::array<glm::vec3, 3>> triangles;
+    for (const glm::uvec3& triangle : mesh.triangles) {
+        std::array<glm::vec3, 3> positions { mesh.vertices[triangle[0]].position, mesh.vertices[triangle[1]].position, mesh.vertices[triangle[2]].position };
+        std::rotate(std::begin(positions), std::min_element(std::begin(positions), std::end(positions), less), std::end(positions));
+        triangles.push_back(positions);
+    }
+    std::sort(std::begin(triangles), std::end(triangles), [&](const auto& lhs, const auto& rhs) {
+        return std::lexicographical_compare(std::begin(lhs), std::end(lhs), std::begin(rhs), std::end(rhs), less);
+    });
+    return triangles;
+}
+
+TEST_CASE("Optimizing a shuffled grid restores vertex cache locality")
+{
+    Mesh mesh = makeGrid(200);
+    std::mt19937 random { 3 };
+    std::shuffle(std::begin(mesh.triangles), std::end(mesh.triangles), random);
+    const auto trianglesBefore = triangleSet(mesh);
+
+    // Measured at 3.0 -> 0.61 ACMR and 5.9 -> 1.2 ATVR
+    const MeshOptimizationReport report = optimizeMesh(mesh);
+    CHECK(report.before.acmr() > 2.9f);
+    CHECK(report.after.acmr() < 0.65f);
+    CHECK(report.before.atvr() > 5.5f);
+    CHECK(report.after.atvr() < 1.3f);
+    CHECK(report.after.numTriangles == report.before.numTriangles);
+
+    // optimizeMesh() also measures the order it leaves behind
+    CHECK(analyzeVertexCache(mesh).numTransformedVertices == report.after.numTransformedVertices);
+    CHECK(triangleSet(mesh) == trianglesBefore);
+}
@@ -0,0 +1,90 @@
+#include <framework/disable_all_warnings.h>
+#include <framework/meshlet.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <tuple>
+
+// UV sphere of radius 1 with counter-clockwise (outward facing) triangles.
+static Mesh makeSphere(unsigned numSlices, unsigned numStacks)
+{
+    Mesh mesh;
+    for (unsigned stack = 0; stack <= numStacks; stack++) {
+        const float theta = glm::pi<float>() * float(stack) / float(numStacks);
+        for (unsigned slice = 0; slice <= numSlices; slice++) {
+            const float phi = 2.0f * glm::pi<float>() * float(slice) / float(numSlices);
+            const glm::vec3 position { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+            mesh.vertices.push_back({ position, position, glm::vec2(0) });
+        }
+    }
+    for (unsigned stack = 0; stack < numStacks; stack++) {
+        for (unsigned slice = 0; slice < numSlices; slice++) {
+            const unsigned corner = stack * (numSlices + 1) + slice, below = corner + numSlices + 1;
+            if (stack > 0)
+                mesh.triangles.push_back({ corner, corner + 1, below });
+            if (stack + 1 < numStacks)
+                mesh.triangles.push_back({ corner + 1, below + 1, below });
+        }
+    }
+    computeBounds(mesh);
+    return mesh;
+}
+
+static std::vector<glm::uvec3> sortedTriangles(std::vector<glm::uvec3> triangles)
+{
+    std::sort(std::begin(triangles), std::end(triangles), [](const glm::uvec3& lhs, const glm::uvec3& rhs) { return std::tie(lhs.x, lhs.y, lhs.z) < std::tie(rhs.x, rhs.y, rhs.z); });
+    return triangles;
+}
+
+TEST_CASE("Meshlets are contiguous and cover every triangle once")
+{
+    Mesh mesh = makeSphere(64, 32);
+    const std::vector<glm::uvec3> trianglesBefore = sortedTriangles(mesh.triangles);
+    const std::vector<Meshlet> meshlets = buildMeshlets(mesh);
+    REQUIRE(meshlets.size() > 1);
+
+    size_t nextTriangle = 0;
+    for (const Meshlet& meshlet : meshlets) {
+        CHECK(meshlet.firstTriangle == nextTriangle);
+        CHECK(meshlet.numTriangles > 0);
+        CHECK(meshlet.numTriangles <= MAX_MESHLET_TRIANGLES);
+        CHECK(meshlet.numVertices <= MAX_MESHLET_VERTICES);
+        nextTriangle = meshlet.firstTriangle + meshlet.numTriangles;
+    }
+    CHECK(nextTriangle == mesh.triangles.size());
+    // Reordered, but the triangles themselves (including their winding) are unchanged
+    CHECK(sortedTriangles(mesh.triangles) == trianglesBefore);
+}
+
+TEST_CASE("Cone culled meshlets contain no front-facing triangles")
+{
+    Mesh mesh = makeSphere(64, 32);
+    const std::vector<Meshlet> meshlets = buildMeshlets(mesh);
+
+    // Viewers far away, close to the surface and inside of the sphere
+    std::mt19937 random { 7 };
+    std::uniform_real_distribution<float> coordinate { -3.0f, 3.0f };
+    size_t numCulled = 0;
+    for (int viewer = 0; viewer < 500; viewer++) {
+        const glm::vec3 viewerPosition { coordinate(random), coordinate(random), coordinate(random) };
+        for (const Meshlet& meshlet : meshlets) {
+            if (glm::dot(glm::normalize(meshlet.coneApex - viewerPosition), meshlet.coneAxis) < meshlet.coneCutoff)
+                continue;
+            numCulled++;
+            for (uint32_t t = meshlet.firstTriangle; t < meshlet.firstTriangle + meshlet.numTriangles; t++) {
+                const glm::vec3 p0 = mesh.vertices[mesh.triangles[t][0]].position;
+                const glm::vec3 p1 = mesh.vertices[mesh.triangles[t][1]].position;
+                const glm::vec3 p2 = mesh.vertices[mesh.triangles[t][2]].position;
+                const glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+                REQUIRE(glm::dot(normal, viewerPosition - p0) <= 1e-5f);
+            }
+        }
+    }
+    // Otherwise the test above would pass trivially
+    CHECK(numCulled > 0);
+}
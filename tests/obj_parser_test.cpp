@@ -0,0 +1,155 @@
+#include <framework/disable_all_warnings.h>
+#include <framework/mesh.h>
+#include <framework/obj_parser.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+DISABLE_WARNINGS_POP()
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <system_error>
+
+static const std::filesystem::path dataDirectory = std::filesystem::path(RESOURCE_ROOT) / "tests" / "data";
+
+template <typename T>
+static bool sameBytes(const std::vector<T>& lhs, const std::vector<T>& rhs)
+{
+    return lhs.size() == rhs.size() && std::memcmp(lhs.data(), rhs.data(), lhs.size() * sizeof(T)) == 0;
+}
+
+static void requireSameMeshes(const std::filesystem::path& file)
+{
+    const std::vector<Mesh> expected = loadMesh(file, false, ObjParser::TinyObjLoader);
+    const std::vector<Mesh> actual = loadMesh(file, false, ObjParser::Parallel);
+    REQUIRE(actual.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        INFO("Sub-mesh " << i);
+        CHECK(sameBytes(actual[i].vertices, expected[i].vertices));
+        CHECK(sameBytes(actual[i].triangles, expected[i].triangles));
+        CHECK(actual[i].material.kd == expected[i].material.kd);
+        CHECK(actual[i].material.ks == expected[i].material.ks);
+        CHECK(actual[i].material.shininess == expected[i].material.shininess);
+        CHECK(actual[i].material.transparency == expected[i].material.transparency);
+        CHECK(actual[i].material.kdTexturePath == expected[i].material.kdTexturePath);
+    }
+}
+
+// Temporary directory of its own per run, such that concurrent runs do not share files; removed when it goes out of
+// scope, also when a test fails.
+struct TemporaryDirectory {
+    TemporaryDirectory()
+        : path(std::filesystem::temp_directory_path() / ("obj_parser_test_" + std::to_string(std::random_device {}())))
+    {
+        std::filesystem::create_directories(path);
+    }
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+    ~TemporaryDirectory()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(path, error);
+    }
+
+    std::filesystem::path path;
+};
+
+// Deterministic OBJ file of a few MiB, such that it is split into several chunks: random faces (triangles and quads,
+// with absolute and relative indices) between the vertices, with frequent group, object and material switches.
+static std::filesystem::path writeLargeObj(const std::filesystem::path& directory)
+{
+    std::filesystem::copy_file(dataDirectory / "materials.mtl", directory / "materials.mtl", std::filesystem::copy_options::overwrite_existing);
+
+    const std::filesystem::path file = directory / "large.obj";
+    std::ofstream stream { file, std::ios::binary };
+    stream << "mtllib materials.mtl\n";
+    std::mt19937 random { 42 };
+    std::uniform_real_distribution<float> coordinate { -100.0f, 100.0f };
+    const auto pick = [&](int count) { return std::uniform_int_distribution<int>(0, count - 1)(random); };
+    const char* materialNames[] { "red", "green", "blue", "unknown" };
+    int numPositions = 0, numTexCoords = 0, numNormals = 0;
+    for (int line = 0; stream.tellp() < 3 * 1024 * 1024; line++) {
+        const int kind = pick(100);
+        if (kind < 30 || numPositions < 4) {
+            stream << "v " << coordinate(random) << ' ' << coordinate(random) << ' ' << coordinate(random) << '\n';
+            numPositions++;
+        } else if (kind < 40) {
+            stream << "vt " << coordinate(random) / 100.0f << ' ' << coordinate(random) / 100.0f << '\n';
+            numTexCoords++;
+        } else if (kind < 50) {
+            stream << "vn " << coordinate(random) / 100.0f << ' ' << coordinate(random) / 100.0f << ' ' << coordinate(random) / 100.0f << '\n';
+            numNormals++;
+        } else if (kind < 52) {
+            stream << "usemtl " << materialNames[pick(4)] << '\n';
+        } else if (kind < 53) {
+            stream << "g group" << pick(8) << '\n';
+        } else if (kind < 54) {
+            stream << "o object" << pick(8) << '\n';
+        } else {
+            // Every face vertex has the same attributes, and relative indices count back from the latest definition
+            const bool relative = pick(2) == 0;
+            const bool withTexCoord = numTexCoords > 0 && pick(2) == 0;
+            const bool withNormal = numNormals > 0 && pick(2) == 0;
+            const auto index = [&](int count) { return relative ? -1 - pick(std::min(count, 16)) : count - pick(std::min(count, 16)); };
+            stream << 'f';
+            for (int vertex = 0, numVertices = 3 + pick(2); vertex < numVertices; vertex++) {
+                stream << ' ' << index(numPositions);
+                if (withTexCoord || withNormal)
+                    stream << '/';
+                if (withTexCoord)
+                    stream << index(numTexCoords);
+                if (withNormal)
+                    stream << '/' << index(numNormals);
+            }
+            stream << '\n';
+        }
+    }
+    return file;
+}
+
+TEST_CASE("Parallel OBJ parser matches tinyobjloader")
+{
+    const std::filesystem::path file = dataDirectory / GENERATE("triangles.obj", "quads.obj", "negative_indices.obj", "groups_materials.obj");
+    INFO(file);
+
+    // Not handed to the tinyobjloader fallback
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    REQUIRE(parseObjParallel(file, attrib, shapes, materials));
+
+    requireSameMeshes(file);
+}
+
+TEST_CASE("Parallel OBJ parser merges the chunks of a large file")
+{
+    const TemporaryDirectory directory;
+    const std::filesystem::path file = writeLargeObj(directory.path);
+    REQUIRE(std::filesystem::file_size(file) > 1024 * 1024);
+    requireSameMeshes(file);
+
+    // loadMesh() uses one chunk per hardware thread, so compare an explicit number of chunks against tinyobjloader too
+    tinyobj::attrib_t expectedAttrib;
+    std::vector<tinyobj::shape_t> expectedShapes;
+    std::vector<tinyobj::material_t> expectedMaterials;
+    std::string warning, error;
+    REQUIRE(tinyobj::LoadObj(&expectedAttrib, &expectedShapes, &expectedMaterials, &warning, &error, file.string().c_str(), (file.parent_path().string() + "/").c_str()));
+
+    const unsigned numThreads = GENERATE(1u, 2u, 3u, 8u);
+    INFO(numThreads << " threads");
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    REQUIRE(parseObjParallel(file, attrib, shapes, materials, numThreads));
+    CHECK(sameBytes(attrib.vertices, expectedAttrib.vertices));
+    CHECK(sameBytes(attrib.normals, expectedAttrib.normals));
+    CHECK(sameBytes(attrib.texcoords, expectedAttrib.texcoords));
+    CHECK(materials.size() == expectedMaterials.size());
+    REQUIRE(shapes.size() == expectedShapes.size());
+    for (size_t i = 0; i < shapes.size(); i++) {
+        INFO("Shape " << i);
+        CHECK(sameBytes(shapes[i].mesh.indices, expectedShapes[i].mesh.indices));
+        CHECK(shapes[i].mesh.material_ids == expectedShapes[i].mesh.material_ids);
+    }
+}
@@ -0,0 +1,98 @@
+#include "occlusion_culling.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+
+// Camera at the origin looking down -Z; the quad at z = -5 covers the center of the screen (NDC [-0.4, 0.4]).
+static const glm::mat4 viewProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+
+static Mesh makeMesh(std::vector<glm::vec3> positions, std::vector<glm::uvec3> triangles)
+{
+    Mesh mesh;
+    for (const glm::vec3& position : positions)
+        mesh.vertices.push_back({ position, glm::vec3(0, 0, 1), glm::vec2(0) });
+    mesh.triangles = std::move(triangles);
+    computeBounds(mesh);
+    return mesh;
+}
+
+static Mesh makeQuad(float halfSize, float z)
+{
+    return makeMesh({ { -halfSize, -halfSize, z }, { halfSize, -halfSize, z }, { halfSize, halfSize, z }, { -halfSize, halfSize, z } }, { { 0, 1, 2 }, { 0, 2, 3 } });
+}
+
+TEST_CASE("Quad occluder hides a box behind it")
+{
+    OcclusionCuller culler;
+    culler.addOccluder(OccluderMesh(makeQuad(2.0f, -5.0f)), viewProjection);
+    culler.rasterize();
+    REQUIRE(culler.numOccluderTriangles() == 2);
+
+    CHECK_FALSE(culler.isVisible(AxisAlignedBox { { -1, -1, -9 }, { 1, 1, -8 } }, viewProjection));
+}
+
+TEST_CASE("Boxes in front of or reaching past the occluder stay visible")
+{
+    OcclusionCuller culler;
+    culler.addOccluder(OccluderMesh(makeQuad(2.0f, -5.0f)), viewProjection);
+    culler.rasterize();
+
+    SECTION("In front")
+    {
+        CHECK(culler.isVisible(AxisAlignedBox { { -1, -1, -4 }, { 1, 1, -3 } }, viewProjection));
+    }
+    SECTION("Straddling the occluder")
+    {
+        CHECK(culler.isVisible(AxisAlignedBox { { -1, -1, -6 }, { 1, 1, -4 } }, viewProjection));
+    }
+    SECTION("Partially outside of the occluder")
+    {
+        CHECK(culler.isVisible(AxisAlignedBox { { 1, -1, -9 }, { 5, 1, -8 } }, viewProjection));
+    }
+    SECTION("Next to the occluder")
+    {
+        CHECK(culler.isVisible(AxisAlignedBox { { 4, -1, -9 }, { 6, 1, -8 } }, viewProjection));
+    }
+}
+
+TEST_CASE("Depth pyramid holds the maximum of its children")
+{
+    OcclusionCuller culler;
+    // A tilted quad and a small triangle, such that the depth varies within the coarser texels
+    culler.addOccluder(OccluderMesh(makeMesh({ { -3, -2, -4 }, { 3, -2, -8 }, { 3, 2, -8 }, { -3, 2, -4 } }, { { 0, 1, 2 }, { 0, 2, 3 } })), viewProjection);
+    culler.addOccluder(OccluderMesh(makeMesh({ { -0.5f, 0, -2 }, { 0.3f, 0.1f, -2 }, { 0, 0.7f, -2.5f } }, { { 0, 1, 2 } })), viewProjection);
+    culler.rasterize();
+
+    REQUIRE(culler.numPyramidLevels() == 9);
+    REQUIRE(std::equal(culler.depthBuffer().begin(), culler.depthBuffer().end(), culler.pyramidLevel(0).begin()));
+    REQUIRE(std::any_of(culler.depthBuffer().begin(), culler.depthBuffer().end(), [](float depth) { return depth < 1.0f; }));
+
+    for (size_t level = 1; level < culler.numPyramidLevels(); level++) {
+        const std::span<const float> finer = culler.pyramidLevel(level - 1);
+        const std::span<const float> coarser = culler.pyramidLevel(level);
+        const size_t width = OcclusionCuller::WIDTH >> level, height = OcclusionCuller::HEIGHT >> level;
+        REQUIRE(coarser.size() == width * height);
+        for (size_t y = 0; y < height; y++) {
+            for (size_t x = 0; x < width; x++) {
+                const size_t finerIdx = 2 * y * (2 * width) + 2 * x;
+                const float expected = std::max({ finer[finerIdx], finer[finerIdx + 1], finer[finerIdx + 2 * width], finer[finerIdx + 2 * width + 1] });
+                REQUIRE(coarser[y * width + x] == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("Occluder triangles crossing the eye plane are dropped")
+{
+    OcclusionCuller culler;
+    // One vertex behind the camera; the triangle would cover the whole screen if it were projected naively
+    culler.addOccluder(OccluderMesh(makeMesh({ { -5, -5, -5 }, { 5, -5, -5 }, { 0, 5, 1 } }, { { 0, 1, 2 } })), viewProjection);
+    culler.rasterize();
+
+    CHECK(culler.numOccluderTriangles() == 0);
+    CHECK(std::all_of(culler.depthBuffer().begin(), culler.depthBuffer().end(), [](float depth) { return depth == 1.0f; }));
+    CHECK(culler.isVisible(AxisAlignedBox { { -1, -1, -9 }, { 1, 1, -8 } }, viewProjection));
+}
@@ -0,0 +1,178 @@
+// Converts OBJ files into binary .mesh caches (see framework/mesh_cache.h), and measures how much faster loading a
+// cache is than loading and optimizing the OBJ file.
+//
+// Usage: MeshConverter <input.obj> [--output <file.mesh>] [--normalize] [--memory-budget <MiB>] [--benchmark <iterations>] [--verify]
+// Without --output the cache is written to the location where loadMeshCache() looks for it. --memory-budget streams the
+// input (see streamMeshCache()) for models that loadMesh() cannot hold in memory, and cannot be combined with
+// --normalize. --verify only checks that the parallel OBJ parser and tinyobjloader load identical meshes, and exits
+// with a non-zero code if they do not; the same check that tests/obj_parser_test.cpp runs on its fixtures, for any file.
+#include <framework/disable_all_warnings.h>
+#include <framework/mesh.h>
+#include <framework/mesh_cache.h>
+#include <framework/mesh_optimizer.h>
+DISABLE_WARNINGS_PUSH()
+#include <fmt/format.h>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+// Average wall clock time of a number of runs, in milliseconds.
+static double measureMilliseconds(int iterations, const std::function<void()>& function)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        function();
+    const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+    return duration.count() / iterations;
+}
+
+// Sum of the 64 bit words of the data, such that every page of a mapping is read.
+static uint64_t readAll(std::span<const std::byte> data)
+{
+    uint64_t sum = 0;
+    for (size_t offset = 0; offset + sizeof(uint64_t) <= data.size(); offset += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data.data() + offset, sizeof(word));
+        sum += word;
+    }
+    return sum;
+}
+
+static void runBenchmark(const std::filesystem::path& input, const std::filesystem::path& output, bool normalize, int iterations)
+{
+    const std::filesystem::path textureBaseDir = input.parent_path();
+    size_t numTriangles = 0;
+    const double objMs = measureMilliseconds(iterations, [&]() {
+        std::vector<Mesh> meshes = loadMesh(input, normalize);
+        for (Mesh& mesh : meshes)
+            optimizeMesh(mesh);
+    });
+    const double tinyObjMs = measureMilliseconds(iterations, [&]() { (void)loadMesh(input, normalize, ObjParser::TinyObjLoader); });
+    const double parallelMs = measureMilliseconds(iterations, [&]() { (void)loadMesh(input, normalize, ObjParser::Parallel); });
+    const double cacheMs = measureMilliseconds(iterations, [&]() {
+        // Includes hashing the source file, like loadMeshCache()
+        const std::optional<MeshCache> meshCache = MeshCache::open(output, meshCacheKey(input, normalize), textureBaseDir);
+        if (!meshCache)
+            throw std::runtime_error("Could not read back the cache");
+        numTriangles = 0;
+        for (const Mesh& mesh : meshCache->toMeshes())
+            numTriangles += mesh.triangles.size();
+    });
+    // Like the copy above, but reading the vertices and triangles from the mapping once, as uploading them does
+    volatile uint64_t checksum = 0;
+    const double mapMs = measureMilliseconds(iterations, [&]() {
+        const std::optional<MeshCache> meshCache = MeshCache::open(output, meshCacheKey(input, normalize), textureBaseDir);
+        if (!meshCache)
+            throw std::runtime_error("Could not read back the cache");
+        for (const MeshCache::SubMesh& subMesh : meshCache->subMeshes())
+            checksum = checksum + readAll(std::as_bytes(subMesh.vertices)) + readAll(std::as_bytes(subMesh.triangles));
+    });
+
+    std::cout << fmt::format("{} triangles, average of {} loads:\n", numTriangles, iterations);
+    std::cout << fmt::format("  OBJ, parsed and optimized:   {:9.3f} ms\n", objMs);
+    std::cout << fmt::format("  OBJ, parsed (tinyobjloader): {:9.3f} ms\n", tinyObjMs);
+    std::cout << fmt::format("  OBJ, parsed (parallel):      {:9.3f} ms ({:.1f}x faster)\n", parallelMs, tinyObjMs / parallelMs);
+    std::cout << fmt::format("  Cache, hashed and copied:    {:9.3f} ms ({:.1f}x faster)\n", cacheMs, objMs / cacheMs);
+    std::cout << fmt::format("  Cache, hashed and mapped:    {:9.3f} ms ({:.1f}x faster)\n", mapMs, objMs / mapMs);
+}
+
+// Compares the output of both OBJ parsers bit by bit, such that NaN normals of degenerate triangles compare equal.
+static bool verifyParsers(const std::filesystem::path& input, bool normalize)
+{
+    const std::vector<Mesh> expected = loadMesh(input, normalize, ObjParser::TinyObjLoader);
+    const std::vector<Mesh> actual = loadMesh(input, normalize, ObjParser::Parallel);
+    const auto sameBytes = [](const auto& lhs, const auto& rhs) {
+        return lhs.size() == rhs.size() && std::memcmp(lhs.data(), rhs.data(), lhs.size() * sizeof(lhs[0])) == 0;
+    };
+    const auto sameMaterial = [](const Material& lhs, const Material& rhs) {
+        return lhs.kd == rhs.kd && lhs.ks == rhs.ks && lhs.shininess == rhs.shininess && lhs.transparency == rhs.transparency && lhs.kdTexturePath == rhs.kdTexturePath;
+    };
+
+    if (actual.size() != expected.size()) {
+        std::cerr << fmt::format("Parallel parser loaded {} sub-meshes instead of {}", actual.size(), expected.size()) << std::endl;
+        return false;
+    }
+    size_t numTriangles = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (!sameBytes(actual[i].vertices, expected[i].vertices) || !sameBytes(actual[i].triangles, expected[i].triangles) || !sameMaterial(actual[i].material, expected[i].material)) {
+            std::cerr << fmt::format("Sub-mesh {} differs between the parallel parser and tinyobjloader", i) << std::endl;
+            return false;
+        }
+        numTriangles += expected[i].triangles.size();
+    }
+    std::cout << fmt::format("Parsers match ({} sub-meshes, {} triangles)\n", expected.size(), numTriangles);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    std::optional<std::filesystem::path> input, output;
+    bool normalize = false;
+    bool verify = false;
+    std::optional<size_t> memoryBudget;
+    int benchmarkIterations = 0;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view argument { argv[i] };
+        if (argument == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (argument == "--normalize") {
+            normalize = true;
+        } else if (argument == "--benchmark" && i + 1 < argc) {
+            benchmarkIterations = std::max(std::atoi(argv[++i]), 1);
+        } else if (argument == "--memory-budget" && i + 1 < argc) {
+            memoryBudget = size_t(std::max(std::atoi(argv[++i]), 1)) << 20;
+        } else if (argument == "--verify") {
+            verify = true;
+        } else if (!input && !argument.starts_with("--")) {
+            input = argv[i];
+        } else {
+            input.reset();
+            break;
+        }
+    }
+    if (!input || (memoryBudget && normalize)) {
+        std::cerr << "Usage: MeshConverter <input.obj> [--output <file.mesh>] [--normalize] [--memory-budget <MiB>] [--benchmark <iterations>] [--verify]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        if (verify)
+            return verifyParsers(*input, normalize) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+        const uint64_t key = meshCacheKey(*input, normalize);
+        if (!output)
+            output = defaultMeshCachePath(key);
+
+        size_t numSubMeshes = 0;
+        if (memoryBudget) {
+            numSubMeshes = streamMeshCache(*input, *output, key, *memoryBudget);
+        } else {
+            std::vector<Mesh> meshes = loadMesh(*input, normalize);
+            MeshOptimizationReport report;
+            for (Mesh& mesh : meshes)
+                report += optimizeMesh(mesh);
+            writeMeshCache(*output, key, meshes, report, input->parent_path());
+            numSubMeshes = meshes.size();
+        }
+        std::cout << fmt::format("Wrote {} ({} sub-meshes, {} bytes)\n", output->string(), numSubMeshes, std::filesystem::file_size(*output));
+
+        if (benchmarkIterations > 0)
+            runBenchmark(*input, *output, normalize, benchmarkIterations);
+    } catch (const std::exception& exception) {
+        std::cerr << fmt::format("Failed to convert {}: {}", input->string(), exception.what()) << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}